@@ -0,0 +1,123 @@
+// =================================================================================
+//	Wail.r							2003, Charles Lechasseur
+// =================================================================================
+//
+// resources that were added after Wail.rsrc. they're kept as Rez source so they
+// can be read and merged without ResEdit or Constructor.
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include "Types.r"
+
+
+// most of our resources are still edited in Wail.rsrc. its bundle is redefined below,
+// so that the finder knows about batch scripts.
+
+include "Wail.rsrc" not 'BNDL';
+
+
+// batch scripts are text files, so they get the document icon. see UWailBatch.
+
+resource 'FREF' (135, "Batch script") {
+	'WBat',
+	7,
+	""
+};
+
+resource 'BNDL' (128) {
+	'W4il',
+	0,
+	{
+		'FREF',
+		{
+			0, 128;
+			1, 129;
+			2, 130;
+			3, 131;
+			4, 132;
+			5, 133;
+			6, 134;
+			7, 135
+		},
+		'ICN#',
+		{
+			0, 128;
+			1, 129;
+			2, 129;
+			3, 129;
+			4, 129;
+			5, 129;
+			6, 0;
+			7, 129
+		}
+	}
+};
+
+
+// strings for the menu items we add at runtime. see CWailDocApp::Initialize.
+
+resource 'STR#' (203, "Menu strings") {
+	{
+		"Compact Sound File"
+	}
+};
+
+
+// shown after compacting a sound file. ^0 is the number of bytes saved.
+// see CWailDocument::CompactSoundFile.
+
+resource 'ALRT' (10002, "Sound file compacted alert") {
+	{40, 40, 133, 330},
+	10002,
+	{
+		OK, visible, sound1,
+		OK, visible, sound1,
+		OK, visible, sound1,
+		OK, visible, sound1
+	},
+	alertPositionParentWindowScreen
+};
+
+resource 'DITL' (10002, "Sound file compacted alert") {
+	{
+		{60, 219, 80, 277},
+		Button {
+			enabled,
+			"OK"
+		},
+		{10, 60, 45, 277},
+		StaticText {
+			disabled,
+			"The sound file was compacted. ^0 bytes were saved."
+		},
+		{10, 10, 42, 42},
+		Picture {
+			disabled,
+			128
+		}
+	}
+};
@@ -37,6 +37,7 @@
 const CommandT	cmd_MakeShuttleFromFile		= '+Shu';
 const CommandT	cmd_CompareWithFile			= '??Fi';
 const CommandT	cmd_CompareWithWindow		= '??Wi';
+const CommandT	cmd_CompactSoundFile		= 'Cmpc';
 
 // menu commands for the class list:
 
@@ -31,7 +31,64 @@
 
 #pragma once
 
+#include "CWailSoundStream.h"
 
-// shuttle data info.
+
+// shuttle data info. the resource contains the offset of the sound file data in the
+// shuttle's data fork, then the offset of the delta section relative to that data
+// (0 if there's none). older shuttles only have the first one.
 const	ResType		rShuttleData_Type				= 'ShuD';
-const	ResIDT		rShuttleData_ID					= 256;
\ No newline at end of file
+const	ResIDT		rShuttleData_ID					= 256;
+
+struct SShuttleDataInfo
+{
+	SInt32			mDataOffset;
+	SInt32			mDeltaOffset;
+};
+
+
+// shuttle trailer. the same info is also found in the last bytes of the data fork,
+// so that shuttle data can be found without a resource fork: this is all that
+// shuttle patch files (fileType_ShuttlePatch) have. the ident comes last, so that
+// it's the last thing in the file.
+const	OSType		shuttleTrailer_Ident			= 'shtr';
+const	SInt32		shuttleTrailer_Version			= 1;
+
+struct SShuttleTrailer
+{
+	SShuttleDataInfo	mInfo;
+	SInt32			mVersion;		// shuttleTrailer_Version.
+	OSType			mIdent;			// shuttleTrailer_Ident.
+};
+
+
+// delta section. a delta shuttle only contains the part of each changed sound that
+// isn't in the sound file it expects to be run on; the delta section tells the
+// shuttle how many bytes to take from the start and the end of the source's sound
+// around it. the section is made of a header followed by mNumEntries entries.
+const	OSType		shuttleDelta_Ident				= 'sdlt';
+const	SInt32		shuttleDelta_Version			= 1;
+
+#pragma options align=mac68k
+
+struct SShuttleDeltaHeader
+{
+	OSType			mIdent;			// shuttleDelta_Ident.
+	SInt32			mVersion;		// shuttleDelta_Version.
+	SSoundHash		mSourceHash;	// see CWailSoundFileData::HashFileTables.
+	SInt32			mNumEntries;
+};
+
+struct SShuttleDeltaEntry
+{
+	SInt16			mSet;			// 0 for 8-bit sounds, 1 for 16-bit sounds.
+	SInt16			mClass;			// 0-based, like the shuttle counts them.
+	SInt16			mSound;			// 0-based.
+	SInt16			mReserved;
+	SInt32			mSourceLength;	// length of the sound in the source.
+	SSoundHash		mSourceHash;	// hash of the sound in the source.
+	SInt32			mPrefixLength;	// bytes taken from the start of the source's sound.
+	SInt32			mSuffixLength;	// bytes taken from the end of the source's sound.
+};
+
+#pragma options align=reset
\ No newline at end of file
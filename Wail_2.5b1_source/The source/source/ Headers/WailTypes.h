@@ -43,6 +43,7 @@ const OSType	fileType_Text						= 'TEXT';
 // Wail types
 
 const OSType	fileCreator_Wail					= 'W2il';
+const OSType	fileType_ShuttlePatch				= 'sPch';	// shuttle data without the shuttle.
 
 // Marathon sound files
 
@@ -72,6 +72,7 @@
 #include "CWailSoundListBox.h"
 #include "CWailWindowChooserDialog.h"
 #include "UWailClassNames.h"
+#include "UWailBatch.h"
 
 // Useful classes headers:
 #include "CSingleColumnListBox.h"
@@ -107,8 +108,14 @@
 
 const	ResIDT	PPob_AboutBox		= 1001;
 
+const	ResIDT	MENU_File			= 129;
+const	SInt16	menuItem_SaveAs		= 6;	// we add Compact Sound File after this one.
+
 const	ResIDT	MENU_Window			= 133;
 
+const	ResIDT	STRx_MenuStrings		= 203;
+const	SInt16	str_CompactSoundFile	= 1;
+
 const	SInt32	memory_RamProtected	= 1024L * 1024L;	// we protect 1 Meg of RAM.
 
 
@@ -356,6 +363,14 @@ CWailDocApp::Initialize()
 	LAttachment* theWindowTracker = new CWindowTracker( MENU_Window );
 	ThrowIfNil_( theWindowTracker );
 	AddAttachment( theWindowTracker );
+	
+	// add the Compact Sound File command to the File menu, after Save As. it has
+	// no item in the menu resources.
+	LMenu* theFileMenu = LMenuBar::GetCurrentMenuBar()->FetchMenu( MENU_File );
+	ThrowIfNil_( theFileMenu );
+	theFileMenu->InsertCommand( LStr255( STRx_MenuStrings, str_CompactSoundFile ),
+								cmd_CompactSoundFile,
+								menuItem_SaveAs );
 
 	// initialize UJukebox.
 	UJukebox::Initialize( new CJukebox( 1 ) );	// we want a single channel.
@@ -413,6 +428,11 @@ CWailDocApp::OpenDocument(
 				theDoc = new CWailDocument(this, inMacFSSpec,
 											theFileInfo.fdType, theFileInfo.fdCreator);
 				break;
+				
+			case fileType_WailBatchScript:
+				// batch scripts are simply run, they don't open a document.
+				UWailBatch::RunScript( *inMacFSSpec );
+				break;
 		}
 	}
 }
@@ -62,7 +62,9 @@
 #include "UBroadcasting.h"
 #include "UMoreDrawingState.h"
 
+#include "CWailSoundHeader.h"
 #include "CWailSoundStream.h"
+#include "UWailSamples.h"
 
 #include "C_PatchFile.h"
 
@@ -259,6 +261,7 @@ CWailDocWindow::ListenToMessage(
 					// read class ID and set it.
 					LEditField* theEditField = (LEditField*) FindPaneByID( pane_ClassIDEditField );
 					theClass->mClassID = (SInt16) theEditField->GetValue();
+					theClass->mDirty = true;
 					SetDirty( true ); // we're dirty.
 				}
 				break;
@@ -280,6 +283,7 @@ CWailDocWindow::ListenToMessage(
 					
 					// set new value.
 					theClass->mChance = theNewValue;
+					theClass->mDirty = true;
 					
 					// we're dirty.
 					SetDirty( true );
@@ -297,6 +301,7 @@ CWailDocWindow::ListenToMessage(
 					// read low pitch and set it.
 					LEditField* theEditField = (LEditField*) FindPaneByID( pane_LowPitchEditField );
 					theClass->mLowPitch = (Fixed) theEditField->GetValue();
+					theClass->mDirty = true;
 					SetDirty( true ); // we're dirty.
 				}
 				break;
@@ -307,6 +312,7 @@ CWailDocWindow::ListenToMessage(
 					// read high pitch and set it.
 					LEditField* theEditField = (LEditField*) FindPaneByID( pane_HighPitchEditField );
 					theClass->mHighPitch = (Fixed) theEditField->GetValue();
+					theClass->mDirty = true;
 					SetDirty( true ); // we're dirty.
 				}
 				break;
@@ -594,9 +600,13 @@ CWailDocWindow::SelectClass(
 	}
 	mCurrentClass = inWhichClass;
 	
-	// now, if a new class is selected, fill panes.
+	// now, if a new class is selected, fill panes. our data might have been loaded
+	// lazily, so make sure the class's sounds are read first.
 	if (inWhichClass != -1)
+	{
+		mSoundFileData->PrefetchClasses( inWhichClass + 1, inWhichClass + 1 );
 		FillAllClassPanes();
+	}
 }
 
 
@@ -1341,6 +1351,7 @@ CWailDocWindow::HandleFlagChange(
 		if (theFlag != 0x0000)
 		{
 			inClass->mFlags = ::BitXor( inClass->mFlags, theFlag );
+			inClass->mDirty = true;
 			
 			// since we are surely changed, we are therefore dirty.
 			SetDirty( true );
@@ -1409,6 +1420,7 @@ CWailDocWindow::HandleVolumeChange(
 		{
 			SInt16 oldVolume = inClass->mVolume;	// save old volume.
 			inClass->mVolume = theVolume;		// set new volume.
+			inClass->mDirty = true;
 			
 			// since we are surely changed, we are therefore dirty.
 			SetDirty( true );
@@ -1648,14 +1660,10 @@ CWailDocWindow::CompareWithAnotherFile()
 		ThrowIfNil_( theFileStream );
 		theFileStream->OpenDataFork( fsRdPerm );
 		
-		// read its data.
-		CWailSoundFileData theSoundFileData( theFileStream, true );
-		
-		// close file.
-		theFileStream->CloseDataFork();
-		
-		// delete the stream.
-		delete theFileStream;
+		// read its data. the data object will own the stream and take care of
+		// closing and deleting it.
+		CWailSoundFileData theSoundFileData( theFileStream,
+			CWailSoundFileData::ChooseLoadMethod( theFileStream->GetLength() ) );
 		
 		// compare data with ours.
 		mSoundFileData->CompareAndKeepOnlyDiffs( theSoundFileData );
@@ -2344,10 +2352,19 @@ CWailDocWindow::ImportAiffSound( Boolean inIs8bit )
 		UInt32 dataOffset;
 		ThrowIfOSErr_( ::ParseAIFFHeader( theRefNum, &theSoundData, &numFrames, &dataOffset ) );
 		
+		// Marathon wants 8-bit samples in offset binary and 16-bit samples big-endian.
+		// AIFF files have them in two's complement, and some AIFF-C files little-endian.
+		// the samples are converted once read; the header must say what they'll be.
+		OSType theFileFormat = theSoundData.format;
+		if (theSoundData.sampleSize == 8)
+			theSoundData.format = kOffsetBinary;
+		else if (theFileFormat == k16BitLittleEndianFormat)
+			theSoundData.format = kTwosComplement;
+		
 		// calculate real length of the sampled data.
 		// there are numFrames per channel, and each frame is 8 or 16-bit long.
 		SInt32 dataLength = numFrames * theSoundData.numChannels
-							* (theSoundData.sampleSize / (inIs8bit ? 8 : 16));
+							* (theSoundData.sampleSize / 8);
 		
 		SInt16 headerLength;
 		{
@@ -2380,6 +2397,12 @@ CWailDocWindow::ImportAiffSound( Boolean inIs8bit )
 			// read sound from stream.
 			theFileStream.SetMarker( dataOffset, streamFrom_Start );
 			theFileStream.ReadBlock( soundInHandleP, dataLength );
+			
+			// convert samples, in place.
+			if ((theSoundData.sampleSize == 8) && (theFileFormat == kTwosComplement))
+				UWailSamples::FlipSign8( soundInHandleP, soundInHandleP, dataLength );
+			else if (theFileFormat == k16BitLittleEndianFormat)
+				UWailSamples::Swap16( soundInHandleP, soundInHandleP, dataLength / 2 );
 		}
 		
 		// setup sound header for real now.
@@ -2476,20 +2499,31 @@ CWailDocWindow::ExportAiffSound( Boolean inIs8bit )
 			theSoundStream->ReadBlock( *theMthonSoundH, theSoundStream->GetLength() );
 		}
 		
-		// turn that sound into a real Mac sound (since it's a Marathon sound).
-		Handle theMacSoundH = CWailSoundClass::TurnMthonSoundIntoMacSound( theMthonSoundH );
+		// get info about the sound. Marathon sounds start with their sound header, so
+		// we read it ourselves instead of making a Mac sound for the Sound Manager.
+		CWailSoundHeader theSoundHeader;
+		{
+			StHandleLocker theMthonSoundHLocker( theMthonSoundH );
+			if (!theSoundHeader.Parse( *theMthonSoundH, ::GetHandleSize( theMthonSoundH ) ))
+			{
+				::DisposeHandle( theMthonSoundH );
+				Throw_( badFormat );
+			}
+		}
 		
-		// dispose of the first handle. (it's no longer of use.)
-		::DisposeHandle( theMthonSoundH );
+		// length of the sampled data.
+		SInt32 dataLength = theSoundHeader.GetDataLength();
 		
-		// get info about the sound.
-		SoundComponentData theSoundData;
-		UInt32 numFrames;
-		UInt32 dataOffset;
-		ThrowIfOSErr_( ::ParseSndHeader( (SndListHandle) theMacSoundH,
-										 &theSoundData,
-										 &numFrames,
-										 &dataOffset ) );
+		// 8-bit samples are written in two's complement, like plain AIFF files have
+		// them. we own the sound, so they're converted in place.
+		OSType theFormat = theSoundHeader.GetFormat();
+		if (theFormat == kOffsetBinary)
+		{
+			StHandleLocker theHandleLocker( theMthonSoundH );
+			Ptr theSamples = (*theMthonSoundH) + theSoundHeader.GetDataOffset();
+			UWailSamples::FlipSign8( theSamples, theSamples, dataLength );
+			theFormat = kTwosComplement;
+		}
 		
 		// create a file to store the sound.
 		LFileStream theAiffFile( theFile );
@@ -2503,26 +2537,19 @@ CWailDocWindow::ExportAiffSound( Boolean inIs8bit )
 		
 		// setup basic AIFF header (no length yet).
 		ThrowIfOSErr_( ::SetupAIFFHeader( refNum,
-										  theSoundData.numChannels,
-										  theSoundData.sampleRate,
-										  theSoundData.sampleSize,
-										  theSoundData.format,
+										  theSoundHeader.GetNumChannels(),
+										  theSoundHeader.GetSampleRate(),
+										  theSoundHeader.GetSampleSize(),
+										  theFormat,
 										  0,	// this is only to set it up - no length yet.
-										  theSoundData.sampleCount ) );
+										  theSoundHeader.GetNumFrames() ) );
 										  
-		// calculate real length of the sampled data.
-		// there are numFrames per channel, and each frame is 8 or 16-bit long.
-		SInt32 dataLength = numFrames * theSoundData.numChannels
-							* (theSoundData.sampleSize / (inIs8bit ? 8 : 16));
-							
 		{
 			// lock the sound handle so we can use it as a buffer.
-			StHandleLocker theHandleLocker( theMacSoundH );
-			
-			
+			StHandleLocker theHandleLocker( theMthonSoundH );
 			
 			// write sampled data to the file.
-			theAiffFile.WriteBlock( (*theMacSoundH) + dataOffset, dataLength );
+			theAiffFile.WriteBlock( (*theMthonSoundH) + theSoundHeader.GetDataOffset(), dataLength );
 		}
 		
 		
@@ -2531,18 +2558,18 @@ CWailDocWindow::ExportAiffSound( Boolean inIs8bit )
 		
 		// re-setup the AIFF header, this time with length info.
 		ThrowIfOSErr_( ::SetupAIFFHeader( refNum,
-										  theSoundData.numChannels,
-										  theSoundData.sampleRate,
-										  theSoundData.sampleSize,
-										  theSoundData.format,
+										  theSoundHeader.GetNumChannels(),
+										  theSoundHeader.GetSampleRate(),
+										  theSoundHeader.GetSampleSize(),
+										  theFormat,
 										  dataLength,
-										  theSoundData.sampleCount ) );
+										  theSoundHeader.GetNumFrames() ) );
 										  
 		// close the file.
 		theAiffFile.CloseDataFork();
 		
-		// dispose of the mac sound.
-		::DisposeHandle( theMacSoundH );
+		// dispose of the sound.
+		::DisposeHandle( theMthonSoundH );
 	}
 	
 	return true;
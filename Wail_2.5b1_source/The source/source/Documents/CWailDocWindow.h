@@ -140,6 +140,7 @@ const	ResIDT		rPPob_WarnDeleteClassDialog		= 1009;
 
 // alert IDs
 const	ResIDT		rALRT_TooManyClassesAlert		= 10001;
+const	ResIDT		rALRT_SoundFileCompactedAlert	= 10002;
 
 // STR# IDs and indexes
 const	ResIDT		STRx_ShuttleStrings				= 201;
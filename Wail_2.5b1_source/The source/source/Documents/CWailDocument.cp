@@ -40,6 +40,7 @@
 #include <LWindow.h>
 #include <PP_Messages.h>
 #include <UMemoryMgr.h>
+#include <UModalDialogs.h>
 #include <UWindows.h>
 #include <UStandardDialogs.h>
 
@@ -50,6 +51,7 @@
 
 #include "CWailDocWindow.h"
 #include "CWailSoundFileData.h"
+#include "UWailBatch.h"
 
 #include "C_PatchFile.h"
 
@@ -173,9 +175,13 @@ CWailDocument::OpenFile(
 	theFileStream->OpenDataFork( fsRdWrPerm );
 	
 	// create a CWailSoundFileData object with the content of that file.
-	// make the data object uses mapped views of the file to read sounds.
-	// this means that the data object will own the stream.
-	CWailSoundFileData* theSoundFileData = new CWailSoundFileData( theFileStream, true );
+	// make the data object use views of the file: only the tables are read now, and
+	// each class's sounds are read when it's shown, so memory grows with what's
+	// viewed instead of with the file. this means that the data object will own
+	// the stream.
+	CWailSoundFileData* theSoundFileData = new CWailSoundFileData( theFileStream,
+		loadMethod_ViewFile,
+		true );	// only read sounds of a class when it's shown.
 			
 	// are we a shuttle?
 	mIsShuttle = false; // not yet supported.
@@ -236,8 +242,8 @@ CWailDocument::DoAESave(
 	// Make new file on disk.
 	mFile->CreateNewDataFile( mFileCreator, mFileType );
 	
-	// Write out the data.
-	DoSave();
+	// Write out the data. the new file is empty, so we must write everything.
+	SaveWholeFile();
 
 	// Change window title to reflect the new name.
 	mWindow->SetDescriptor( inFileSpec.name );
@@ -251,9 +257,54 @@ CWailDocument::DoAESave(
 //		 DoSave
 // ---------------------------------------------------------------------------------
 // perform a "Save" operation.
+//
+// if the layout of our file didn't change, we only write the classes that did.
+// otherwise, we must write the whole file.
 
 void
 CWailDocument::DoSave()
+{
+	CWailSoundFileData* theSoundFileData = ((CWailDocWindow*) mWindow)->GetSoundFileData();
+	
+	if (theSoundFileData->CanSaveInPlace())
+	{
+		// post a nil action first: undoable actions might keep sounds that point
+		// to places in the file we're about to overwrite. saving the whole file
+		// clears them too, so it's not a change for the user.
+		mWindow->PostAction( nil );
+		
+		// get our file's specifier and save.
+		FSSpec theSpecifier;
+		mFile->GetSpecifier( theSpecifier );
+		theSoundFileData->SaveInPlace( theSpecifier );
+		
+		// sounds of the classes we saved have changed, so refresh the current class.
+		SInt32 theCurrentClass = ((CWailDocWindow*) mWindow)->GetCurrentClass();
+		if (theCurrentClass != -1)
+			((CWailDocWindow*) mWindow)->SelectClass( theCurrentClass, true );
+		
+		// saving makes the doc un-dirty.
+		((CWailDocWindow*) mWindow)->SetDirty( false );
+	}
+	else
+	{
+		SaveWholeFile();
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 SaveWholeFile
+// ---------------------------------------------------------------------------------
+// writes all our data to our file. this also reclaims space lost by saving in place.
+//
+// if inDeduplicate is true, identical sound sets are only written once. if
+// outBytesSaved is not nil, it receives the number of bytes this saved.
+
+void
+CWailDocument::SaveWholeFile(
+	Boolean		inDeduplicate /*= false*/,
+	SInt32		*outBytesSaved /*= nil*/ )
 {
 	// get our file's specifier.
 	FSSpec theSpecifier;
@@ -290,7 +341,13 @@ CWailDocument::DoSave()
 	theTempFileStream->OpenDataFork( fsRdWrPerm );
 
 	// get the file data from our window and save it to the temp file.
-	(((CWailDocWindow*) mWindow)->GetSoundFileData())->SaveToFile( theTempFileStream );
+	// since the temp file is brand new, let the writes be queued asynchronously.
+	UInt32 theSaveFlags = saveFlag_AsyncWrites;
+	if (inDeduplicate)
+		theSaveFlags |= saveFlag_Deduplicate;
+	(((CWailDocWindow*) mWindow)->GetSoundFileData())->SaveToFile( theTempFileStream,
+																   theSaveFlags,
+																   outBytesSaved );
 	
 	// close the temp file's data fork.
 	theTempFileStream->CloseDataFork();
@@ -317,9 +374,13 @@ CWailDocument::DoSave()
 	theFileStream->OpenDataFork( fsRdWrPerm );
 	
 	// create a CWailSoundFileData object with the content of that file.
-	// make the data object uses mapped views of the file to read sounds.
-	// this means that the data object will own the stream.
-	CWailSoundFileData* theSoundFileData = new CWailSoundFileData( theFileStream, true );
+	// make the data object use views of the file: only the tables are read now, and
+	// each class's sounds are read when it's shown, so memory grows with what's
+	// viewed instead of with the file. this means that the data object will own
+	// the stream.
+	CWailSoundFileData* theSoundFileData = new CWailSoundFileData( theFileStream,
+		loadMethod_ViewFile,
+		true );	// only read sounds of a class when it's shown.
 	
 	// store this data in the window.
 	((CWailDocWindow*) mWindow)->SetSoundFileData( theSoundFileData );
@@ -351,9 +412,13 @@ CWailDocument::DoRevert()
 	theFileStream->OpenDataFork( fsRdWrPerm );
 	
 	// create a CWailSoundFileData object with the content of that file.
-	// make the data object uses mapped views of the file to read sounds.
-	// this means that the data object will own the stream.
-	CWailSoundFileData *theSoundFileData = new CWailSoundFileData( theFileStream, true );
+	// make the data object use views of the file: only the tables are read now, and
+	// each class's sounds are read when it's shown, so memory grows with what's
+	// viewed instead of with the file. this means that the data object will own
+	// the stream.
+	CWailSoundFileData *theSoundFileData = new CWailSoundFileData( theFileStream,
+		loadMethod_ViewFile,
+		true );	// only read sounds of a class when it's shown.
 	
 	// store this data in the window.
 	((CWailDocWindow*) mWindow)->SetSoundFileData( theSoundFileData );
@@ -394,6 +459,10 @@ CWailDocument::ObeyCommand(
 			cmdHandled = MakeShuttle();
 			break;
 			
+		case cmd_CompactSoundFile:
+			cmdHandled = CompactSoundFile();
+			break;
+			
 		default:
 			cmdHandled = LSingleDoc::ObeyCommand( inCommand, ioParam );
 			break;
@@ -422,6 +491,10 @@ CWailDocument::FindCommandStatus(
 			outEnabled = true;		// we can always create a shuttle from our file.
 			break;
 			
+		case cmd_CompactSoundFile:
+			outEnabled = mIsSpecified;	// we can only compact a file we have.
+			break;
+			
 		default:
 			LSingleDoc::FindCommandStatus( inCommand, outEnabled,
 										   outUsesMark, outMark, outName );
@@ -448,69 +521,30 @@ CWailDocument::MakeShuttle()
 												   isReplacing );
 	if (isGood)
 	{
-		// see if the file needs to be deleted.
-		if (isReplacing)
-		{
-			ThrowIfOSErr_( ::FSpDelete( &theFile ) );
-		}
-	
-		// create the base Shuttle content.
-		MakeFileFromMakeInfo( theFile );
-	
-		// save current resource fork for later.
-		StOldResFile oldResFile;
-	
-		// create a file stream from our file.
-		CInFileStream *theFileStream = new CInFileStream( theFile );
-		
-		// create an auto-deleter to be exception-safe.
-		// this will automatically delete the file stream at the end of this block.
-		StDeleter<CInFileStream> theFileStreamDeleter( theFileStream );
-
-		// open its data fork.
-		theFileStream->OpenDataFork( fsRdWrPerm );
-		
-		// get its length.
-		SInt32 theLength = theFileStream->GetLength();
-		
-		// move the inset of the InFileStream to make it look like
-		// it starts at the end of the file.
-		theFileStream->SetInset( theLength );
-		
-		// save our data to the file.
-		((CWailDocWindow*) mWindow)->GetSoundFileData()->SaveToFile( theFileStream );
-		
-		// close the data fork.
-		theFileStream->CloseDataFork();
-		
-		// open the resource fork.
-		theFileStream->OpenResourceFork( fsRdWrPerm );
-		
-		// we need to tell the shuttle where to start looking for its data in its own data fork.
-		// we will create a resource of 4 bytes with that information and add it to the
-		// shuttle as a resource.
-		{
-			StHandleBlock theLongHandle( 4 );
-			(**((SInt32**) ((Handle) theLongHandle))) = theLength;
-			
-			// add the resource to the shuttle.
-			::AddResource( theLongHandle,
-						   rShuttleData_Type,
-						   rShuttleData_ID,
-						   // resource name:
-						   	"\p" );
-			ThrowIfResError_();
-			
-			// release that new resource from memory.
-			::ReleaseResource( theLongHandle.Release() );
-			ThrowIfResError_();
-		}
-		
-		// close the resource fork.
-		theFileStream->CloseResourceFork();
-		
-		// the file stream is deleted here by the StDeleter created earlier.
+		// build the shuttle. this replaces the file if needed.
+		UWailBatch::MakeShuttle( *((CWailDocWindow*) mWindow)->GetSoundFileData(), theFile );
 	}
 	
 	return isGood;
-}
\ No newline at end of file
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CompactSoundFile
+// ---------------------------------------------------------------------------------
+// rewrites our whole file, storing identical sound sets only once. this also
+// reclaims space lost by saving in place. tells user how many bytes were saved.
+
+Boolean
+CWailDocument::CompactSoundFile()
+{
+	SInt32 theBytesSaved = 0;
+	SaveWholeFile( true, &theBytesSaved );
+	
+	// show the results.
+	LStr255 theBytesSavedString( theBytesSaved );
+	::ParamText( (ConstStringPtr) theBytesSavedString, "\p", "\p", "\p" );
+	UModalAlerts::Alert( rALRT_SoundFileCompactedAlert );
+	
+	return true;
+}
@@ -71,6 +71,13 @@ protected:
 	
 	Boolean				MakeShuttle();
 	
+	// saving
+	
+	void				SaveWholeFile(
+							Boolean			inDeduplicate = false,
+							SInt32			*outBytesSaved = nil );
+	Boolean				CompactSoundFile();
+	
 private:
 
 	// data members:
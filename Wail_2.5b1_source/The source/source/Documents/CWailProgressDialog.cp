@@ -43,6 +43,11 @@ const PaneIDT	pane_ProgressDlogProgressBar	= 'PBar';
 const ResIDT	STRL_WailProgressStrings		= 2000;
 
 
+// static members:
+
+Boolean			CWailProgressDialog::sQuiet		= false;
+
+
 // ---------------------------------------------------------------------------
 //	 CWailProgressDialog
 // ---------------------------------------------------------------------------
@@ -51,7 +56,13 @@ CWailProgressDialog::CWailProgressDialog(
 	SInt32		inProgressBarSize,
 	SInt32		inWindowTitleIndex,
 	LCommander*	inSuper)
+	: mWindow( nil ),
+	  mProgressBar( nil )
 {
+	// in quiet mode, we don't show anything, so we don't need a window.
+	if (sQuiet)
+		return;
+	
 	// get a new window.
 	mWindow = LWindow::CreateWindow( PPob_WailProgressDialog, inSuper );
 	
@@ -82,11 +93,14 @@ CWailProgressDialog::CWailProgressDialog(
 
 CWailProgressDialog::~CWailProgressDialog()
 {
-	// hide window.
-	mWindow->Hide();
-
-	// delete the window.
-	delete mWindow;
+	if (mWindow != nil)
+	{
+		// hide window.
+		mWindow->Hide();
+	
+		// delete the window.
+		delete mWindow;
+	}
 }
 
 
@@ -98,6 +112,9 @@ CWailProgressDialog::~CWailProgressDialog()
 SInt32
 CWailProgressDialog::GetProgressBarSize() const
 {
+	if (mProgressBar == nil)
+		return 0;
+	
 	return mProgressBar->GetMaxValue();
 }
 
@@ -111,7 +128,8 @@ void
 CWailProgressDialog::SetProgressBarSize(
 	SInt32	inProgressBarSize )
 {
-	mProgressBar->SetMaxValue( inProgressBarSize );
+	if (mProgressBar != nil)
+		mProgressBar->SetMaxValue( inProgressBarSize );
 }
 
 
@@ -124,7 +142,8 @@ void
 CWailProgressDialog::Increment(
 	SInt32 	inHowMuch )
 {
-	mProgressBar->IncrementValue( inHowMuch );
+	if (mProgressBar != nil)
+		mProgressBar->IncrementValue( inHowMuch );
 }
 
 
@@ -136,7 +155,8 @@ CWailProgressDialog::Increment(
 void
 CWailProgressDialog::Reset()
 {
-	mProgressBar->SetValue( 0 );
+	if (mProgressBar != nil)
+		mProgressBar->SetValue( 0 );
 }
 
 
@@ -148,7 +168,8 @@ CWailProgressDialog::Reset()
 void
 CWailProgressDialog::Show()
 {
-	mWindow->Show();
+	if (mWindow != nil)
+		mWindow->Show();
 }
 
 
@@ -160,5 +181,6 @@ CWailProgressDialog::Show()
 void
 CWailProgressDialog::Hide()
 {
-	mWindow->Hide();
+	if (mWindow != nil)
+		mWindow->Hide();
 }
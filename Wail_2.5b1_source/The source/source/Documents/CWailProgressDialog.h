@@ -73,11 +73,19 @@ class CWailProgressDialog
 		void				Show();
 		void				Hide();
 		
+		// quiet mode: progress dialogs created while it's on don't show anything.
+		
+		static Boolean		IsQuiet() { return sQuiet; }
+		static void			SetQuiet(
+								Boolean			inQuiet ) { sQuiet = inQuiet; }
+		
 	private:
 		// Member Variables
 
 		LWindow				*mWindow;		// progress bar window.
 		LControl			*mProgressBar;	// for speed, we keep it here.
+		
+		static Boolean		sQuiet;			// true if we must not show anything.
 	
 		// Defensive programming. No copy constructor nor operator=
 							CWailProgressDialog(const CWailProgressDialog&);
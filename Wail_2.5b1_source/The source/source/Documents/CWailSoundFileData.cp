@@ -57,6 +57,16 @@
 #include "UWailPreferences.h"
 
 #include "CWailSoundStream.h"
+#include "CMappedFileStream.h"
+#include "CInFileStream.h"
+#include "CAsyncFileWriter.h"
+
+
+// number of bytes we read at the beginning of a file when loading, hoping to get
+// the header and all class headers in one shot. 32K is enough for ~250 classes,
+// which is a lot more than any known sound file uses.
+
+const SInt32	classTables_PrefetchSize		= 32L * 1024L;
 
 
 #pragma mark -- CWailSoundClass --
@@ -86,6 +96,14 @@ CWailSoundClass::CWailSoundClass()
 	for (i = 0; i < 5; i++)
 		m16bitSounds[i] = nil;
 	mRemap8bit = false;
+	
+	// a new class isn't in any file yet, so it needs to be saved.
+	mDirty = true;
+	mDiskIndex = 0;
+	
+	// we have no sounds to read.
+	mDeferredSoundFile = nil;
+	mDeferredLoadMethod = loadMethod_ReadInRAM;
 }
 
 
@@ -150,6 +168,15 @@ CWailSoundClass::CWailSoundClass(
 					&& (in16bitClass.mClassID != classID_Unused));
 	if (mRemap8bit)
 		mNum16bitSounds = 0;
+	
+	// we're being loaded, so we're the same as what's in the file. whoever loads
+	// us must set mDiskIndex.
+	mDirty = false;
+	mDiskIndex = 0;
+	
+	// sounds are read by ReadSounds or DeferReadSounds.
+	mDeferredSoundFile = nil;
+	mDeferredLoadMethod = loadMethod_ReadInRAM;
 }
 
 
@@ -178,148 +205,197 @@ CWailSoundClass::~CWailSoundClass()
 //
 // call this after constructing the object with the same SMthonSoundClass parameters.
 //
-// if inMapViewOfFile is true, we'll create sound streams by mapping views of the
-// provided stream. this will save memory by making sounds be accessed directly from
-// within the file. ownership of the provided stream is not assumed in this case,
-// so if you use this method, the stream must be kept alive elsewhere.
+// if inLoadMethod is loadMethod_ViewFile, we'll create sound streams by mapping views
+// of the provided stream. this will save memory by making sounds be accessed directly from
+// within the file. if it is loadMethod_MapFile, the provided stream must be a
+// CMappedFileStream and our sounds will point directly inside its data. ownership of the
+// provided stream is not assumed in both cases, so if you use these methods, the stream
+// must be kept alive elsewhere.
 
 void
 CWailSoundClass::ReadSounds(
 	LStream					*inMthonSoundFile,
 	const SMthonSoundClass&	in8bitClass,
 	const SMthonSoundClass& in16bitClass,
-	bool					inMapViewOfFile /*= false*/ )
+	ESoundLoadMethod		inLoadMethod /*= loadMethod_ReadInRAM*/ )
 {
 	// see if the stream is valid.
 	ThrowIfNil_( inMthonSoundFile );
 	
-	int i = 0;
-	
-	// in a marathon sound file, sounds of the same class are always stored one after
-	// the other. this is very useful since it means we can position the marker of the stream
-	// and read all sounds. however we must figure out the sound sizes.
-	//
-	// strangely, the first sound's size is stored separately in mFirstSoundLength. other
-	// sizes must be calculated by substracting the offset of the sound to the offset of
-	// the next sound. one exception is of course the last sound, which has no next sound...
-	// so we substract its offset to the total size of all sounds, which is known in
-	// mTotalLength.
-	
 	// first we'll read 8-bit sounds if we have some.
 	if (mNum8bitSounds > 0)
+		ReadSoundSet( inMthonSoundFile, in8bitClass, inLoadMethod, m8bitSounds );
+	
+	// next, we'll read 16-bit sounds if we have some (and they're not remapped).
+	if ((mNum16bitSounds > 0) && (!mRemap8bit))
+		ReadSoundSet( inMthonSoundFile, in16bitClass, inLoadMethod, m16bitSounds );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 DeferReadSounds
+// ---------------------------------------------------------------------------------
+// same as ReadSounds, except that sounds are not read right away. instead, we
+// remember where they are and read them when ReadDeferredSounds is called. until
+// then, our sound counts are right but our sounds are nil.
+//
+// inLoadMethod can't be loadMethod_ReadInRAM, because the provided stream must stay
+// alive until sounds are read; whoever owns it must make sure of that.
+
+void
+CWailSoundClass::DeferReadSounds(
+	LStream					*inMthonSoundFile,
+	const SMthonSoundClass&	in8bitClass,
+	const SMthonSoundClass& in16bitClass,
+	ESoundLoadMethod		inLoadMethod )
+{
+	ThrowIfNil_( inMthonSoundFile );
+	SignalIf_( inLoadMethod == loadMethod_ReadInRAM );
+	
+	mDeferredSoundFile = inMthonSoundFile;
+	mDeferred8bitClass = in8bitClass;
+	mDeferred16bitClass = in16bitClass;
+	mDeferredLoadMethod = inLoadMethod;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ReadDeferredSounds
+// ---------------------------------------------------------------------------------
+// reads the sounds we were told about in DeferReadSounds, if we haven't done so yet.
+
+void
+CWailSoundClass::ReadDeferredSounds()
+{
+	if (mDeferredSoundFile != nil)
 	{
-		// position the marker.
-		inMthonSoundFile->SetMarker( in8bitClass.mFirstSoundOffset, streamFrom_Start );
+		ReadSounds( mDeferredSoundFile,
+					mDeferred8bitClass,
+					mDeferred16bitClass,
+					mDeferredLoadMethod );
 		
-		for (i = 1; i <= in8bitClass.mNumSounds; i++)
-		{
-			// determine sound length.
-			SInt32	soundLength;
-			
-			if (i == 1)	// first sound.
-				soundLength = in8bitClass.mFirstSoundLength;
-			else if (i == in8bitClass.mNumSounds) // last sound.
-				soundLength = in8bitClass.mTotalLength - in8bitClass.mSoundOffset[i - 1];
-			else		// another sound between the first and the last.
-				soundLength = in8bitClass.mSoundOffset[i] - in8bitClass.mSoundOffset[i - 1];
-				
-			// create the sound stream, depending on the way user wants it.
-			CWailSoundStream* theStream = nil;
-				
-			if (inMapViewOfFile)
-			{
-				// user wants to keep sound in file and access it from there using a stream view.
-				theStream = new CWailSoundStream( inMthonSoundFile,
-												  inMthonSoundFile->GetMarker(),
-												  soundLength );
-				// the stream moved the marker of the sound file stream so that it is
-				// positioned at the beginning of the sound. move it back to the end
-				// of the sound so that next sound is read properly.
-				inMthonSoundFile->SetMarker( soundLength, streamFrom_Marker );
-			}
-			else
-			{
-				// user wants to read sound from file and store it independently.
-				// create a handle to store the sound.
-				Handle theHandle = ::NewHandle( soundLength );
-				ThrowIfNil_( theHandle );
-				
-				{
-					// since we're reading this from a Handle, we must lock the handle.
-					StHandleLocker theHandleLocker( theHandle );
-					
-					// read the sound.
-					inMthonSoundFile->ReadBlock( *theHandle, soundLength );
-				}
-				
-				// store the handle in a stream.
-				theStream = new CWailSoundStream( theHandle );
-					// the stream now "owns" the handle and will dispose of it when destroyed.
-			}
-			
-			// store this stream in our member variable.
-			SignalIf_( theStream == nil );
-			m8bitSounds[i - 1] = theStream;
-		}
+		// we got them. don't read them again.
+		mDeferredSoundFile = nil;
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ReadSoundSet
+// ---------------------------------------------------------------------------------
+// reads all sounds described by the given SMthonSoundClass (8-bit or 16-bit) and
+// stores them in outSounds. see ReadSounds for the meaning of inLoadMethod.
+
+void
+CWailSoundClass::ReadSoundSet(
+	LStream					*inMthonSoundFile,
+	const SMthonSoundClass&	inClass,
+	ESoundLoadMethod		inLoadMethod,
+	LStream*				outSounds[5] )
+{
+	// if we must point inside a mapped file, make sure we have one.
+	const CMappedFileStream* theMappedFile = nil;
+	if (inLoadMethod == loadMethod_MapFile)
+	{
+		theMappedFile = dynamic_cast<const CMappedFileStream*>(inMthonSoundFile);
+		ThrowIfNil_( theMappedFile );
 	}
 	
-	// next, we'll read 16-bit sounds if we have some (and they're not remapped).
-	if ((mNum16bitSounds > 0) && (!mRemap8bit))
+	// we can't store more than 5 sounds per class.
+	ThrowIf_( (inClass.mNumSounds < 0) || (inClass.mNumSounds > 5) );
+	
+	// in a marathon sound file, sounds of the same class are always stored one after
+	// the other. this is very useful since it means we can read all sounds of the class
+	// at once. however we must figure out the sound sizes.
+	SInt32 theSoundLengths[5];
+	SInt32 theSetLength = GetSoundLengths( inClass, theSoundLengths );
+	SInt16 i;
+	
+	// if user wants sounds to be read and stored independently, read the whole
+	// set in one shot. we'll then slice each sound out of that buffer.
+	StPointerBlock theSetData( (inLoadMethod == loadMethod_ReadInRAM) ? theSetLength : 0 );
+	if (inLoadMethod == loadMethod_ReadInRAM)
 	{
-		// position the marker.
-		inMthonSoundFile->SetMarker( in16bitClass.mFirstSoundOffset, streamFrom_Start );
+		inMthonSoundFile->SetMarker( inClass.mFirstSoundOffset, streamFrom_Start );
+		inMthonSoundFile->ReadBlock( theSetData, theSetLength );
+	}
 	
-		for (i = 1; i <= in16bitClass.mNumSounds; i++)
+	// now create the sound streams, depending on the way user wants it.
+	SInt32 theSoundOffset = 0;
+	for (i = 0; i < inClass.mNumSounds; i++)
+	{
+		CWailSoundStream* theStream = nil;
+		
+		switch (inLoadMethod)
 		{
-			// determine sound length.
-			SInt32	soundLength;
-			
-			if (i == 1)	// first sound.
-				soundLength = in16bitClass.mFirstSoundLength;
-			else if (i == in16bitClass.mNumSounds) // last sound.
-				soundLength = in16bitClass.mTotalLength - in16bitClass.mSoundOffset[i - 1];
-			else		// another sound between the first and the last.
-				soundLength = in16bitClass.mSoundOffset[i] - in16bitClass.mSoundOffset[i - 1];
-				
-			// create the sound stream, depending on the way user wants it.
-			CWailSoundStream* theStream = nil;
+			case loadMethod_MapFile:
+				// user wants sound to point directly inside the mapped file.
+				theStream = new CWailSoundStream( theMappedFile,
+												  inClass.mFirstSoundOffset + theSoundOffset,
+												  theSoundLengths[i] );
+				break;
 				
-			if (inMapViewOfFile)
-			{
+			case loadMethod_ViewFile:
 				// user wants to keep sound in file and access it from there using a stream view.
 				theStream = new CWailSoundStream( inMthonSoundFile,
-												  inMthonSoundFile->GetMarker(),
-												  soundLength );
-				// the stream moved the marker of the sound file stream so that it is
-				// positioned at the beginning of the sound. move it back to the end
-				// of the sound so that next sound is read properly.
-				inMthonSoundFile->SetMarker( soundLength, streamFrom_Marker );
-			}
-			else
-			{
-				// user wants to read sound from file and store it independently.
-				// create a handle to store the sound.
-				Handle theHandle = ::NewHandle( soundLength );
-				ThrowIfNil_( theHandle );
+												  inClass.mFirstSoundOffset + theSoundOffset,
+												  theSoundLengths[i] );
+				break;
 				
-				{
-					// since we're reading this from a Handle, we must lock the handle.
-					StHandleLocker theHandleLocker( theHandle );
-					
-					// read the sound.
-					inMthonSoundFile->ReadBlock( *theHandle, soundLength );
-				}
-				
-				// store the handle in a stream.
-				theStream = new CWailSoundStream( theHandle );
-					// the stream now "owns" the handle and will dispose of it when destroyed.
-			}
-			
-			// store this stream in our member variable.
-			SignalIf_( theStream == nil );
-			m16bitSounds[i - 1] = theStream;
+			default:
+				// user wants to store the sound independently. copy it from the set's data.
+				theStream = new CWailSoundStream( ((Ptr) theSetData) + theSoundOffset,
+												  theSoundLengths[i] );
+				break;
 		}
+		
+		// store this stream in the caller's array.
+		SignalIf_( theStream == nil );
+		outSounds[i] = theStream;
+		
+		theSoundOffset += theSoundLengths[i];
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 GetSoundLengths									[static]
+// ---------------------------------------------------------------------------------
+// figures out the length of each sound described by the given SMthonSoundClass and
+// returns the length of the whole set. the sounds are stored one after the other,
+// starting at mFirstSoundOffset.
+//
+// strangely, the first sound's size is stored separately in mFirstSoundLength. other
+// sizes must be calculated by substracting the offset of the sound to the offset of
+// the next sound. one exception is of course the last sound, which has no next sound...
+// so we substract its offset to the total size of all sounds, which is known in
+// mTotalLength.
+
+SInt32
+CWailSoundClass::GetSoundLengths(
+	const SMthonSoundClass&	inClass,
+	SInt32					outLengths[5] )
+{
+	ThrowIf_( (inClass.mNumSounds < 0) || (inClass.mNumSounds > 5) );
+	
+	SInt32 theSetLength = 0;
+	SInt16 i;
+	for (i = 1; i <= inClass.mNumSounds; i++)
+	{
+		SInt32	soundLength;
+		
+		if (i == 1)	// first sound.
+			soundLength = inClass.mFirstSoundLength;
+		else if (i == inClass.mNumSounds) // last sound.
+			soundLength = inClass.mTotalLength - inClass.mSoundOffset[i - 1];
+		else		// another sound between the first and the last.
+			soundLength = inClass.mSoundOffset[i] - inClass.mSoundOffset[i - 1];
+		
+		outLengths[i - 1] = soundLength;
+		theSetLength += soundLength;
 	}
+	
+	return theSetLength;
 }
 
 
@@ -358,21 +434,8 @@ CWailSoundClass::Are8bitSoundsSame(
 	SInt16 i = 0;
 	while (isSame && (i < mNum8bitSounds))
 	{
-		// read both sounds.
-		SInt32 ourLength = m8bitSounds[i]->GetLength();
-		SInt32 theirLength = inClass.m8bitSounds[i]->GetLength();
-		
-		StPointerBlock ourSound( ourLength );
-		m8bitSounds[i]->SetMarker( 0, streamFrom_Start );
-		m8bitSounds[i]->ReadBlock( ourSound, ourLength );
-		
-		StPointerBlock theirSound( theirLength );
-		inClass.m8bitSounds[i]->SetMarker( 0, streamFrom_Start );
-		inClass.m8bitSounds[i]->ReadBlock( theirSound, theirLength );
-										   
-		// compare them
-		isSame = isSame &&
-				 (BlockCompare( ourSound, theirSound, ourLength, theirLength ) == 0);
+		// compare both sounds.
+		isSame = AreSoundsSame( m8bitSounds[i], inClass.m8bitSounds[i] );
 		
 		i++;
 	}
@@ -397,21 +460,8 @@ CWailSoundClass::Are16bitSoundsSame(
 	SInt16 i = 0;
 	while (isSame && (i < mNum16bitSounds))
 	{
-		// read both sounds.
-		SInt32 ourLength = m16bitSounds[i]->GetLength();
-		SInt32 theirLength = inClass.m16bitSounds[i]->GetLength();
-		
-		StPointerBlock ourSound( ourLength );
-		m16bitSounds[i]->SetMarker( 0, streamFrom_Start );
-		m16bitSounds[i]->ReadBlock( ourSound, ourLength );
-		
-		StPointerBlock theirSound( theirLength );
-		inClass.m16bitSounds[i]->SetMarker( 0, streamFrom_Start );
-		inClass.m16bitSounds[i]->ReadBlock( theirSound, theirLength );
-										   
-		// compare them
-		isSame = isSame &&
-				 (BlockCompare( ourSound, theirSound, ourLength, theirLength ) == 0);
+		// compare both sounds.
+		isSame = AreSoundsSame( m16bitSounds[i], inClass.m16bitSounds[i] );
 		
 		i++;
 	}
@@ -420,6 +470,72 @@ CWailSoundClass::Are16bitSoundsSame(
 }
 
 
+// ---------------------------------------------------------------------------------
+//		 AreSoundsSame										[static]
+// ---------------------------------------------------------------------------------
+// returns true if the two sounds are similar. sounds of different lengths are never
+// similar. then, if both sounds already know their content hash, different hashes
+// tell us the sounds differ without looking at the data.
+//
+// if both sounds can give us a pointer to their data (for instance when they're
+// mapped from a file), we compare the data directly; that's a single pass and it
+// stops at the first difference, so there's no point hashing first. otherwise we
+// hash the sounds (the hash is kept for next time) and only read them for a full
+// compare if hashes match. either way, sounds are compared a chunk at a time, so
+// they're never both loaded in memory.
+
+bool
+CWailSoundClass::AreSoundsSame(
+	LStream*	inSound1,
+	LStream*	inSound2 )
+{
+	SInt32 theLength1 = inSound1->GetLength();
+	SInt32 theLength2 = inSound2->GetLength();
+	
+	// no need to look at the data if lengths don't match.
+	if (theLength1 != theLength2)
+		return false;
+	
+	CWailSoundStream* theSound1 = dynamic_cast<CWailSoundStream*>(inSound1);
+	CWailSoundStream* theSound2 = dynamic_cast<CWailSoundStream*>(inSound2);
+	if ((theSound1 != nil) && (theSound2 != nil))
+	{
+		// try comparing the data in place.
+		if (theSound1->CanGetBuffer() && theSound2->CanGetBuffer())
+		{
+			if (theSound1->IsHashKnown() && theSound2->IsHashKnown() &&
+				!AreHashesSame( theSound1->GetContentHash(), theSound2->GetContentHash() ))
+			{
+				return false;
+			}
+			
+			return (CWailSoundStream::FindFirstDifference( *theSound1, *theSound2 ) < 0);
+		}
+		
+		// we'd have to read the data. compare hashes first.
+		if (!AreHashesSame( theSound1->GetContentHash(), theSound2->GetContentHash() ))
+			return false;
+	}
+	
+	// compare them one chunk at a time.
+	return (CWailSoundStream::FindFirstDifference( *inSound1, *inSound2 ) < 0);
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 AreHashesSame										[static]
+// ---------------------------------------------------------------------------------
+
+bool
+CWailSoundClass::AreHashesSame(
+	const SSoundHash&	inHash1,
+	const SSoundHash&	inHash2 )
+{
+	return ((inHash1.mHash1 == inHash2.mHash1) &&
+			(inHash1.mHash2 == inHash2.mHash2));
+}
+
+
 // ---------------------------------------------------------------------------------
 //		 operator ==
 // ---------------------------------------------------------------------------------
@@ -557,538 +673,1617 @@ CWailSoundClass::RoundChance(
 }
 
 
-#pragma mark -- CWailSoundFileData --
+#pragma mark -- CSoundRunWriter --
 
-// ---------------------------------------------------------------------------
-//	 CWailSoundFileData						Default Constructor
-// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------
+//  CSoundRunWriter declaration
+// ---------------------------------------------------------------------------------
+// small helper used when saving to write sounds one after the other in a stream.
+// sounds whose data can be accessed directly are written from there, and sounds
+// that are adjacent in memory (like the sounds of a mapped file that haven't been
+// touched) are gathered in a single write. other sounds are read in a transfer
+// buffer that is reused from one sound to the next.
+//
+// the data of the current run is only pointed to, so Flush is called before
+// anything that could move memory.
+//
+// if given a CAsyncFileWriter, sounds are written with positional asynchronous writes
+// instead. since those writes are still pending when we return, sounds we must read
+// get their own buffer, which the async writer disposes of when done.
 
-CWailSoundFileData::CWailSoundFileData()
-	: mSoundClasses(),
-	  mDemoLayout( FALSE ),
-	  mViewedStream( NULL )
+class CSoundRunWriter
 {
-	// do nothing, since we don't have any data.
-}
+	public:
+							CSoundRunWriter(
+								LStream&			inStream,
+								SInt32				inStartOffset,
+								CAsyncFileWriter*	inAsyncWriter = nil );
+							~CSoundRunWriter();
+		
+		void				WriteSound(
+								LStream*		inSound );
+		void				Flush();
+		
+	private:
+	
+		LStream&			mStream;			// where we write.
+		CAsyncFileWriter*	mAsyncWriter;		// how we write, if not through mStream.
+		SInt32				mOffset;			// where the next write goes in the stream.
+		const char*			mRunStart;			// start of the data waiting to be written.
+		SInt32				mRunLength;			// length of that data.
+		Ptr					mTransferBuffer;	// buffer used for sounds we must read.
+		SInt32				mTransferSize;		// size of that buffer.
+	
+		// Defensive programming. No copy constructor or operator=
+							CSoundRunWriter( const CSoundRunWriter& );
+		CSoundRunWriter&	operator=( const CSoundRunWriter& );
+};
 
 
-// ---------------------------------------------------------------------------
-//	 CWailSoundFileData						Stream Constructor
-// ---------------------------------------------------------------------------
-// in this case, the LStream object passed to this constructor must point to
-// a valid Marathon Sound File. most likely you will want to pass a LFileStream
-// object, but you might also read the entire file in a LHandleStream if you
-// have tons of RAM. (i don't, so you probably won't see it in this source :)
-//
-// if inMapViewOfFile is true, it means we must use stream views to load the
-// sounds directly from the provided stream. in this case, WE ASSUME OWNERSHIP
-// of the provided stream and use it to create stream views for our sounds.
+// ---------------------------------------------------------------------------------
+//		 CSoundRunWriter			Constructor
+// ---------------------------------------------------------------------------------
 
-CWailSoundFileData::CWailSoundFileData(
-	LStream		*inMthonSoundFile,
-	bool		inMapViewOfFile /*= false*/ )
-	: mSoundClasses(),
-	  mDemoLayout( FALSE ),
-	  mViewedStream( NULL )
+CSoundRunWriter::CSoundRunWriter(
+	LStream&			inStream,
+	SInt32				inStartOffset,
+	CAsyncFileWriter*	inAsyncWriter )
+	: mStream( inStream ),
+	  mAsyncWriter( inAsyncWriter ),
+	  mOffset( inStartOffset ),
+	  mRunStart( nil ),
+	  mRunLength( 0 ),
+	  mTransferBuffer( nil ),
+	  mTransferSize( 0 )
 {
-	ThrowIfNil_( inMthonSoundFile );
-
-	LoadFromFile( inMthonSoundFile, inMapViewOfFile );
 }
 
 
-// ---------------------------------------------------------------------------
-//	 ~CWailSoundFileData						Destructor
-// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------
+//		 ~CSoundRunWriter			Destructor
+// ---------------------------------------------------------------------------------
+// whatever is left in the current run is NOT written. call Flush for that.
 
-CWailSoundFileData::~CWailSoundFileData()
+CSoundRunWriter::~CSoundRunWriter()
 {
-	Clear();
-	
-	// delete viewed stream if we have one.
-	if (mViewedStream != NULL)
-	{
-		delete mViewedStream;
-		mViewedStream = NULL;
-	}
+	if (mTransferBuffer != nil)
+		::DisposePtr( mTransferBuffer );
 }
 
 
-// ---------------------------------------------------------------------------
-//		 LoadFromFile
-// ---------------------------------------------------------------------------
-// provided with a valid LStream object that contains an existing Marathon
-// Sounds file, this function will read its data and save it in this class.
-//
-// if inMapViewOfFile is true, it means we must use stream views to load the
-// sounds directly from the provided stream. in this case, WE ASSUME OWNERSHIP
-// of the provided stream and use it to create stream views for our sounds.
+// ---------------------------------------------------------------------------------
+//		 WriteSound
+// ---------------------------------------------------------------------------------
+// writes the given sound right after the previous one.
 
 void
-CWailSoundFileData::LoadFromFile(
-	LStream 	*inMthonSoundFile,
-	bool		inMapViewOfFile /*= false*/ )
+CSoundRunWriter::WriteSound(
+	LStream*	inSound )
 {
-	ThrowIfNil_( inMthonSoundFile );
-	
-	// if user told us to map views of the file, save stream to view.
-	if (inMapViewOfFile)
-		SetViewedStream( inMthonSoundFile );
-	
-	// clear any already-existing data.
-	Clear();
-
-	// now read the new data.
-	// we must first read the file header, to know exactly how many classes it contains.
-	SMthonSoundHeader theHeader;
-	inMthonSoundFile->SetMarker( 0, streamFrom_Start );
-	inMthonSoundFile->ReadBlock( &theHeader, sizeof(SMthonSoundHeader) );
-	
-	// patch: the M2 Demo Sounds file wasn't layed out exactly like we thought...
-	// it has mNumClasses set to 0, and mNumSets set to the number of sound classes.
-	// it doesn't seem to have 16-bit sounds either. so what we'll do is we'll switch
-	// it around here...
-	if ((theHeader.mNumClasses == 0) && (theHeader.mNumSets > 0))
-	{
-		SInt16 numClasses = theHeader.mNumSets;
-		theHeader.mNumSets = 1;
-		theHeader.mNumClasses = numClasses;
-		
-		// remember that this data uses the M2 Demo layout so that we can save using
-		// the same layout later on.
-		mDemoLayout = TRUE;
-	}
-	else
-	{
-		// we're not using the M2 Demo Sounds file layout.
-		mDemoLayout = FALSE;
-	}
+	SInt32 theLength = inSound->GetLength();
+	if (theLength <= 0)
+		return;
 	
-	// create a progress dialog.
-	CWailProgressDialog theProgressDialog( (SInt32) theHeader.mNumClasses,
-										   progressString_LoadingSoundData,
-										   nil );
-	
-	// now, read each class one by one and store it. in order to create a CWailSoundClass
-	// object, we must read two SMthonSoundClass objects from the file, one for 8-bit sounds
-	// and one for 16-bit sounds.
-	mSoundClasses.AdjustAllocation( theHeader.mNumClasses );
-	for (SInt16 i = 1; i <= theHeader.mNumClasses; i++)
+	// if we can get to the sound's data directly, add it to the current run.
+	CWailSoundStream* theSound = dynamic_cast<CWailSoundStream*>(inSound);
+	if ((theSound != nil) && theSound->CanGetBuffer())
 	{
-		SMthonSoundClass	the8bitClass,
-							the16bitClass;
-	
-		// only try to read 8-bit sounds if we have an 8-bit sound set.
-		if (theHeader.mNumSets >= 1)
+		const char* theData = (const char*) theSound->GetBuffer();
+		if ((mRunStart != nil) && (mRunStart + mRunLength == theData))
 		{
-			// position the marker for the 8-bit class.
-			inMthonSoundFile->SetMarker( sizeof(SMthonSoundHeader)				// we skip the header,
-										 + sizeof(SMthonSoundClass) * (i - 1),	// and all the 8-bit
-										 										// classes before
-										 										// this one.
-										 streamFrom_Start );
-			
-			// read the 8-bit class.
-			inMthonSoundFile->ReadBlock( &the8bitClass, sizeof(SMthonSoundClass) );
+			// the sound follows the current run in memory. simply extend it.
+			mRunLength += theLength;
 		}
 		else
 		{
-			// no 8-bit set (not very likely, but hey)
-			the8bitClass.mClassID = classID_Unused;
-			the8bitClass.mVolume = volume_Soft;
-			the8bitClass.mFlags = 0;
-			
-			the8bitClass.mNumSounds = 0;
-			
-			the8bitClass.mFirstSoundOffset = 0;
-			the8bitClass.mFirstSoundLength = 0;
-			the8bitClass.mTotalLength = 0;
-			
-			for (int j = 0; j < 5; ++j)
-				the8bitClass.mSoundOffset[j] = 0;
+			// start a new run.
+			Flush();
+			mRunStart = theData;
+			mRunLength = theLength;
 		}
+	}
+	else
+	{
+		// we'll have to read the sound. write the current run first, since
+		// reading might move memory.
+		Flush();
 		
-		// only try to read 16-bit sounds if we have a 16-bit sound set.
-		if (theHeader.mNumSets >= 2)
-		{
-			// position the marker for the 16-bit class.
-			inMthonSoundFile->SetMarker( sizeof(SMthonSoundHeader)				// we skip the header,
-										 + sizeof(SMthonSoundClass) * theHeader.mNumClasses
-																				// all 8-bit classes,
-										 + sizeof(SMthonSoundClass) * (i - 1),	// and all the 16-bit
-										 										// classes before
-										 										// this one.
-										 
-										 streamFrom_Start );
-			
-			// read the 16-bit class.
-			inMthonSoundFile->ReadBlock( &the16bitClass, sizeof(SMthonSoundClass) );
-		}
-		else
+		// if writing asynchronously, read the sound in its own buffer and let
+		// the async writer dispose of it when it's written.
+		if (mAsyncWriter != nil)
 		{
-			// no 16-bit set (true in the M2 Demo Sounds file, at least)
-			the16bitClass.mClassID = classID_Unused;
-			the16bitClass.mVolume = volume_Soft;
-			the16bitClass.mFlags = 0;
+			Ptr theBuffer = ::NewPtr( theLength );
+			ThrowIfNil_( theBuffer );
 			
-			the16bitClass.mNumSounds = 0;
+			try
+			{
+				inSound->SetMarker( 0, streamFrom_Start );
+				inSound->ReadBlock( theBuffer, theLength );
+			}
 			
-			the16bitClass.mFirstSoundOffset = 0;
-			the16bitClass.mFirstSoundLength = 0;
-			the16bitClass.mTotalLength = 0;
+			catch (...)
+			{
+				::DisposePtr( theBuffer );
+				throw;
+			}
 			
-			for (int j = 0; j < 5; ++j)
-				the16bitClass.mSoundOffset[j] = 0;
+			mAsyncWriter->WriteAt( mOffset, theBuffer, theLength, theBuffer );
+			mOffset += theLength;
+			return;
 		}
 		
-		// create a new CWailSoundClass object and read all its sounds.
-		CWailSoundClass *theSoundClass = new CWailSoundClass( the8bitClass, the16bitClass );
-		theSoundClass->ReadSounds( inMthonSoundFile,
-								   the8bitClass,
-								   the16bitClass,
-								   inMapViewOfFile );
-		
-		// store it in our array of classes.
-		mSoundClasses.AddItem( theSoundClass );
+		// make sure our transfer buffer is big enough.
+		if (theLength > mTransferSize)
+		{
+			if (mTransferBuffer != nil)
+				::DisposePtr( mTransferBuffer );
+			mTransferSize = 0;
+			
+			mTransferBuffer = ::NewPtr( theLength );
+			ThrowIfNil_( mTransferBuffer );
+			mTransferSize = theLength;
+		}
 		
-		// increment the progress bar.
-		theProgressDialog.Increment();
+		// read the sound and write it.
+		inSound->SetMarker( 0, streamFrom_Start );
+		inSound->ReadBlock( mTransferBuffer, theLength );
+		mStream.SetMarker( mOffset, streamFrom_Start );
+		mStream.WriteBlock( mTransferBuffer, theLength );
+		mOffset += theLength;
 	}
 }
 
 
 // ---------------------------------------------------------------------------------
-//		 SaveToFile
+//		 Flush
 // ---------------------------------------------------------------------------------
-// provided with a valid LStream object that points to a newly created file,
-// SaveToFile will save the content of the SoundFileData object to the file, in Marathon
-// format. this is what to call when the user selects "Save" or "Save As".
+// writes the current run, if any.
 
 void
-CWailSoundFileData::SaveToFile(
-	LStream		*inMthonSoundFile )
+CSoundRunWriter::Flush()
 {
-	ThrowIfNil_( inMthonSoundFile );
-	
-	// set the stream's marker to the beginning of the stream.
-	inMthonSoundFile->SetMarker( 0, streamFrom_Start );
-	
-	// ok. first, we have to write the sound file header.
-	SMthonSoundHeader theHeader;
-	if (mDemoLayout)
+	if (mRunStart != nil)
 	{
-		// we're using the M2 Demo Sounds file layout, which has mNumClasses set to 0
-		// and mNumSets set to the number of classes.
-		theHeader.mNumSets = mSoundClasses.GetCount();
-		theHeader.mNumClasses = 0;
+		if (mAsyncWriter != nil)
+		{
+			mAsyncWriter->WriteAt( mOffset, mRunStart, mRunLength );
+		}
+		else
+		{
+			mStream.SetMarker( mOffset, streamFrom_Start );
+			mStream.WriteBlock( mRunStart, mRunLength );
+		}
+		mOffset += mRunLength;
+		
+		mRunStart = nil;
+		mRunLength = 0;
 	}
-	else
+}
+
+
+#pragma mark -- CSoundSetIndex --
+
+// ---------------------------------------------------------------------------------
+//  CSoundSetIndex declaration
+// ---------------------------------------------------------------------------------
+// small helper used when saving to find sound sets that were already laid out with
+// the exact same sounds, so that their class headers can point to the same data.
+//
+// sets are first matched on their number of sounds and the length of each sound,
+// which is cheap. only sets that match that way are hashed, and only sets with the
+// same hash are compared byte for byte. hashes are computed once per set, when
+// first needed.
+//
+// the index only points to the sounds of the sets it knows, so they must not be
+// touched while it's alive.
+
+class CSoundSetIndex
+{
+	public:
+							CSoundSetIndex();
+		
+		Boolean				FindSameSet(
+								SInt16			inNumSounds,
+								LStream* const	inSounds[5],
+								SInt32&			outHeaderIndex,
+								SInt32			inExcludedOffset = 0 );
+		void				AddSet(
+								SInt16			inNumSounds,
+								LStream* const	inSounds[5],
+								SInt32			inHeaderIndex,
+								SInt32			inFirstSoundOffset );
+		
+	private:
+	
+		struct SSoundSetEntry
+		{
+			SInt16				mNumSounds;			// number of sounds in the set.
+			LStream* const*		mSounds;			// the sounds themselves.
+			SInt32				mLengths[5];		// length of each sound.
+			SSoundHash			mHash;				// hash of all sounds, if mHashed.
+			Boolean				mHashed;
+			SInt32				mHeaderIndex;		// where the set's class header is.
+			SInt32				mFirstSoundOffset;	// where the set's sounds are.
+		};
+		
+		static void			FillEntry(
+								SInt16			inNumSounds,
+								LStream* const	inSounds[5],
+								SSoundSetEntry&	outEntry );
+		static void			HashSoundSet(
+								const SSoundSetEntry&	inEntry,
+								SSoundHash&				outHash );
+	
+		TArray<SSoundSetEntry>	mEntries;
+	
+		// Defensive programming. No copy constructor or operator=
+							CSoundSetIndex( const CSoundSetIndex& );
+		CSoundSetIndex&		operator=( const CSoundSetIndex& );
+};
+
+
+// ---------------------------------------------------------------------------------
+//		 CSoundSetIndex			Constructor
+// ---------------------------------------------------------------------------------
+
+CSoundSetIndex::CSoundSetIndex()
+	: mEntries()
+{
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 FindSameSet
+// ---------------------------------------------------------------------------------
+// looks for a set we know with the exact same sounds as the given set. if we find
+// one, returns true and puts the index of its class header in outHeaderIndex.
+// sets whose sounds start at inExcludedOffset are skipped, unless it's 0.
+
+Boolean
+CSoundSetIndex::FindSameSet(
+	SInt16			inNumSounds,
+	LStream* const	inSounds[5],
+	SInt32&			outHeaderIndex,
+	SInt32			inExcludedOffset )
+{
+	// empty sets don't take any room, no need to share them.
+	if (inNumSounds <= 0)
+		return false;
+	
+	SSoundSetEntry theSet;
+	FillEntry( inNumSounds, inSounds, theSet );
+	
+	SInt32 theCount = mEntries.GetCount();
+	for (SInt32 i = 1; i <= theCount; i++)
+	{
+		SSoundSetEntry& theEntry = mEntries[i];
+		
+		if ((inExcludedOffset != 0) && (theEntry.mFirstSoundOffset == inExcludedOffset))
+			continue;
+		
+		// cheap test first: same sounds means same lengths.
+		if (theEntry.mNumSounds != theSet.mNumSounds)
+			continue;
+		SInt16 j;
+		for (j = 0; j < theSet.mNumSounds; j++)
+		{
+			if (theEntry.mLengths[j] != theSet.mLengths[j])
+				break;
+		}
+		if (j < theSet.mNumSounds)
+			continue;
+		
+		// lengths match. now compare hashes, computing them if needed.
+		if (!theSet.mHashed)
+		{
+			HashSoundSet( theSet, theSet.mHash );
+			theSet.mHashed = true;
+		}
+		if (!theEntry.mHashed)
+		{
+			HashSoundSet( theEntry, theEntry.mHash );
+			theEntry.mHashed = true;
+		}
+		if (!CWailSoundClass::AreHashesSame( theEntry.mHash, theSet.mHash ))
+			continue;
+		
+		// hashes match too. make sure sounds are really the same.
+		for (j = 0; j < theSet.mNumSounds; j++)
+		{
+			if (!CWailSoundClass::AreSoundsSame( theEntry.mSounds[j], theSet.mSounds[j] ))
+				break;
+		}
+		if (j == theSet.mNumSounds)
+		{
+			outHeaderIndex = theEntry.mHeaderIndex;
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 AddSet
+// ---------------------------------------------------------------------------------
+// remembers the given set, whose class header is at inHeaderIndex and whose sounds
+// start at inFirstSoundOffset.
+
+void
+CSoundSetIndex::AddSet(
+	SInt16			inNumSounds,
+	LStream* const	inSounds[5],
+	SInt32			inHeaderIndex,
+	SInt32			inFirstSoundOffset )
+{
+	if (inNumSounds <= 0)
+		return;
+	
+	SSoundSetEntry theEntry;
+	FillEntry( inNumSounds, inSounds, theEntry );
+	theEntry.mHeaderIndex = inHeaderIndex;
+	theEntry.mFirstSoundOffset = inFirstSoundOffset;
+	
+	mEntries.AddItem( theEntry );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 FillEntry											[static]
+// ---------------------------------------------------------------------------------
+// fills an entry for the given set. the set isn't hashed yet.
+
+void
+CSoundSetIndex::FillEntry(
+	SInt16			inNumSounds,
+	LStream* const	inSounds[5],
+	SSoundSetEntry&	outEntry )
+{
+	outEntry.mNumSounds = inNumSounds;
+	outEntry.mSounds = inSounds;
+	for (SInt16 j = 0; j < inNumSounds; j++)
+		outEntry.mLengths[j] = inSounds[j]->GetLength();
+	CWailSoundStream::InitHash( outEntry.mHash );
+	outEntry.mHashed = false;
+	outEntry.mHeaderIndex = 0;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 HashSoundSet										[static]
+// ---------------------------------------------------------------------------------
+// hashes the data of all sounds of the set, by combining the content hash of each
+// sound. sounds keep their own hash, so each one is only read once no matter how
+// many sets it's compared with.
+
+void
+CSoundSetIndex::HashSoundSet(
+	const SSoundSetEntry&	inEntry,
+	SSoundHash&				outHash )
+{
+	CWailSoundStream::InitHash( outHash );
+	
+	for (SInt16 j = 0; j < inEntry.mNumSounds; j++)
+	{
+		SSoundHash theSoundHash;
+		
+		CWailSoundStream* theWailSound = dynamic_cast<CWailSoundStream*>(inEntry.mSounds[j]);
+		if (theWailSound != nil)
+			theSoundHash = theWailSound->GetContentHash();
+		else
+			CWailSoundStream::HashStream( *inEntry.mSounds[j], theSoundHash );
+		
+		CWailSoundStream::HashBytes( &theSoundHash, sizeof(theSoundHash), outHash );
+	}
+}
+
+
+#pragma mark -- CWailSoundFileData --
+
+// ---------------------------------------------------------------------------
+//	 CWailSoundFileData						Default Constructor
+// ---------------------------------------------------------------------------
+
+CWailSoundFileData::CWailSoundFileData()
+	: mSoundClasses(),
+	  mDemoLayout( FALSE ),
+	  mViewedStream( NULL ),
+	  mDiskHeaders(),
+	  mDiskNumClasses( -1 ),
+	  mDiskNumSets( 0 ),
+	  mDiskDemoLayout( FALSE )
+{
+	// do nothing, since we don't have any data.
+}
+
+
+// ---------------------------------------------------------------------------
+//	 CWailSoundFileData						Stream Constructor
+// ---------------------------------------------------------------------------
+// in this case, the LStream object passed to this constructor must point to
+// a valid Marathon Sound File. most likely you will want to pass a LFileStream
+// object, but you might also read the entire file in a LHandleStream if you
+// have tons of RAM. (i don't, so you probably won't see it in this source :)
+//
+// if inLoadMethod is not loadMethod_ReadInRAM, it means we must use stream views
+// or a mapping to load the sounds directly from the provided stream. in this case,
+// WE ASSUME OWNERSHIP of the provided stream. see LoadFromFile.
+
+CWailSoundFileData::CWailSoundFileData(
+	LStream				*inMthonSoundFile,
+	ESoundLoadMethod	inLoadMethod /*= loadMethod_ReadInRAM*/,
+	Boolean				inReadSoundsLazily /*= false*/ )
+	: mSoundClasses(),
+	  mDemoLayout( FALSE ),
+	  mViewedStream( NULL ),
+	  mDiskHeaders(),
+	  mDiskNumClasses( -1 ),
+	  mDiskNumSets( 0 ),
+	  mDiskDemoLayout( FALSE )
+{
+	ThrowIfNil_( inMthonSoundFile );
+
+	LoadFromFile( inMthonSoundFile, inLoadMethod, inReadSoundsLazily );
+}
+
+
+// ---------------------------------------------------------------------------
+//	 ~CWailSoundFileData						Destructor
+// ---------------------------------------------------------------------------
+
+CWailSoundFileData::~CWailSoundFileData()
+{
+	Clear();
+	
+	// delete viewed stream if we have one.
+	if (mViewedStream != NULL)
+	{
+		delete mViewedStream;
+		mViewedStream = NULL;
+	}
+}
+
+
+// ---------------------------------------------------------------------------
+//		 LoadFromFile
+// ---------------------------------------------------------------------------
+// provided with a valid LStream object that contains an existing Marathon
+// Sounds file, this function will read its data and save it in this class.
+//
+// if inLoadMethod is loadMethod_ViewFile, it means we must use stream views to load
+// the sounds directly from the provided stream. in this case, WE ASSUME OWNERSHIP
+// of the provided stream and use it to create stream views for our sounds.
+//
+// if inLoadMethod is loadMethod_MapFile, the whole stream is read in memory at once
+// and our sounds point directly inside that mapping. in this case, WE ALSO ASSUME
+// OWNERSHIP of the provided stream, but we destroy it as soon as it's mapped.
+//
+// if inReadSoundsLazily is true, we only read the class headers; sounds of each class
+// are read the first time someone asks for the class with GetSoundClass (or when
+// classes are prefetched). this is only possible if we own the stream, so it's
+// ignored with loadMethod_ReadInRAM.
+
+void
+CWailSoundFileData::LoadFromFile(
+	LStream 			*inMthonSoundFile,
+	ESoundLoadMethod	inLoadMethod /*= loadMethod_ReadInRAM*/,
+	Boolean				inReadSoundsLazily /*= false*/ )
+{
+	ThrowIfNil_( inMthonSoundFile );
+	
+	// if user told us to map the file, do it now and get rid of the file stream.
+	// we'll read everything from the mapping afterwards.
+	if (inLoadMethod == loadMethod_MapFile)
+	{
+		CMappedFileStream* theMappedFile = nil;
+		try
+		{
+			theMappedFile = new CMappedFileStream( *inMthonSoundFile );
+		}
+		
+		catch (...)
+		{
+			// we own the stream, so we must get rid of it anyway.
+			delete inMthonSoundFile;
+			throw;
+		}
+		
+		delete inMthonSoundFile;
+		inMthonSoundFile = theMappedFile;
+	}
+	
+	// if user told us to map views of the file, save stream to view.
+	if (inLoadMethod != loadMethod_ReadInRAM)
+		SetViewedStream( inMthonSoundFile );
+	
+	// clear any already-existing data.
+	Clear();
+
+	// now read the new data. we must first read the file header and the class headers,
+	// to know exactly how many classes the file contains and where their sounds are.
+	SSoundFileTables theTables;
+	ReadFileTables( *inMthonSoundFile, theTables );
+	
+	// remember that this data uses the M2 Demo layout so that we can save using
+	// the same layout later on.
+	mDemoLayout = theTables.mDemoLayout;
+	
+	// remember what the class headers look like on disk, so that we can save in place.
+	mDiskHeaders.AdjustAllocation( theTables.mNumClasses * theTables.mNumSets );
+	if (theTables.mNumSets >= 1)
+		for (SInt32 k = 1; k <= theTables.mNumClasses; k++)
+			mDiskHeaders.AddItem( theTables.m8bitClasses[k] );
+	if (theTables.mNumSets >= 2)
+		for (SInt32 k = 1; k <= theTables.mNumClasses; k++)
+			mDiskHeaders.AddItem( theTables.m16bitClasses[k] );
+	
+	// create a progress dialog.
+	CWailProgressDialog theProgressDialog( theTables.mNumClasses,
+										   progressString_LoadingSoundData,
+										   nil );
+	
+	// now, create each class one by one and store it. a CWailSoundClass object is made
+	// of two SMthonSoundClass objects, one for 8-bit sounds and one for 16-bit sounds.
+	mSoundClasses.AdjustAllocation( theTables.mNumClasses );
+	for (SInt16 i = 1; i <= theTables.mNumClasses; i++)
+	{
+		// copied, since the arrays can move when we allocate the class.
+		SMthonSoundClass	the8bitClass = theTables.m8bitClasses[i],
+							the16bitClass = theTables.m16bitClasses[i];
+		
+		// create a new CWailSoundClass object and read all its sounds, unless
+		// they can be read later.
+		CWailSoundClass *theSoundClass = new CWailSoundClass( the8bitClass, the16bitClass );
+		if (inReadSoundsLazily && (inLoadMethod != loadMethod_ReadInRAM))
+			theSoundClass->DeferReadSounds( inMthonSoundFile,
+											the8bitClass,
+											the16bitClass,
+											inLoadMethod );
+		else
+			theSoundClass->ReadSounds( inMthonSoundFile,
+									   the8bitClass,
+									   the16bitClass,
+									   inLoadMethod );
+		theSoundClass->mDiskIndex = i;
+		
+		// store it in our array of classes.
+		mSoundClasses.AddItem( theSoundClass );
+		
+		// increment the progress bar.
+		theProgressDialog.Increment();
+	}
+	
+	// everything went fine, so we now know the layout of the file.
+	mDiskNumClasses = theTables.mNumClasses;
+	mDiskNumSets = theTables.mNumSets;
+	mDiskDemoLayout = mDemoLayout;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 SaveToFile
+// ---------------------------------------------------------------------------------
+// provided with a valid LStream object that points to a newly created file,
+// SaveToFile will save the content of the SoundFileData object to the file, in Marathon
+// format. this is what to call when the user selects "Save" or "Save As".
+//
+// the file header and all class headers are built in a single buffer and written
+// at once. sounds are then written with a CSoundRunWriter, which writes them straight
+// from their data when possible (for example when the file is mapped).
+//
+// inSaveFlags can contain the following:
+//
+//	saveFlag_AsyncWrites:		since we know where everything goes before writing
+//								anything, data is written with positional asynchronous
+//								writes, so that the File Manager can work while we read
+//								the next sounds. only used if the stream is a LFileStream.
+//	saveFlag_FlushAndVerify:	once written, the file is flushed to disk and read back
+//								to make sure it contains what we wanted.
+//	saveFlag_Deduplicate:		sound sets that contain exactly the same sounds as a set
+//								that was already laid out (in any class, 8-bit or 16-bit)
+//								are not written again; their class header points to the
+//								first set's sounds instead, like remapped 16-bit sounds do.
+//								this is done per set, because sounds of a set must be
+//								stored one after the other (see ReadSoundSet).
+//
+// except for saveFlag_Deduplicate, the resulting file is the same whatever the flags.
+//
+// if outBytesSaved is not nil, it receives the number of bytes we didn't have to write
+// thanks to saveFlag_Deduplicate.
+
+void
+CWailSoundFileData::SaveToFile(
+	LStream		*inMthonSoundFile,
+	UInt32		inSaveFlags /*= saveFlag_None*/,
+	SInt32		*outBytesSaved /*= nil*/ )
+{
+	ThrowIfNil_( inMthonSoundFile );
+	
+	// we'll need all our sounds.
+	PrefetchAllClasses();
+	
+	// ok. first, we have to make up the sound file header.
+	SMthonSoundHeader theHeader;
+	SInt16 theNumClasses = mSoundClasses.GetCount();
+	SInt16 theNumSets;
+	if (mDemoLayout)
+	{
+		// we're using the M2 Demo Sounds file layout, which has mNumClasses set to 0
+		// and mNumSets set to the number of classes. there's only one set.
+		theHeader.mNumSets = theNumClasses;
+		theHeader.mNumClasses = 0;
+		theNumSets = 1;
+	}
+	else
 	{
 		// we're using the standard layout, set number of classes in mNumClasses.
-		theHeader.mNumClasses = mSoundClasses.GetCount();
+		theHeader.mNumClasses = theNumClasses;
+		theNumSets = theHeader.mNumSets;
 	}
 		// everything else is set in SMthonSoundHeader's inlined constructor.
-	inMthonSoundFile->WriteBlock( &theHeader, sizeof(SMthonSoundHeader) );
 	
-	// now, switch header layout around if we set it up using the demo layout,
-	// so that the rest of this function is easier to write.
-	if (mDemoLayout)
+	// create a progress dialog. we count one step per class header, and one step
+	// per class for each set of sounds written (and verified).
+	SInt32 theNumSteps = theNumClasses * theNumSets * 2;
+	if ((inSaveFlags & saveFlag_FlushAndVerify) != 0)
+		theNumSteps += theNumClasses * theNumSets;
+	CWailProgressDialog theProgressDialog( theNumSteps,
+										   progressString_SavingSoundData,
+										   nil );
+	
+	// create a buffer to hold the file header and all class headers. they will
+	// be written in one shot once filled up.
+	SInt32 theTablesLength = sizeof(SMthonSoundHeader) +
+							 (sizeof(SMthonSoundClass) * theNumClasses * theNumSets);
+	StPointerBlock theTables( theTablesLength );
+	::BlockMoveData( &theHeader, theTables, sizeof(SMthonSoundHeader) );
+	SMthonSoundClass* theClassHeaders =
+		(SMthonSoundClass*) (((Ptr) theTables) + sizeof(SMthonSoundHeader));
+	
+	// ok. now we have to make up the class header list. this is more tricky since we need to figure
+	// out in advance the offset of the first sound of each class in the final file.
+	// we will use a variable called theCurrentOffset that will start right after the class header
+	// list and keep track of where sounds will be written in the final file. each time we fill
+	// a class header, we will add that class header's totalLength to theCurrentOffset.
+	SInt32 theCurrentOffset = theTablesLength;
+	
+	// if user wants to deduplicate sounds, we'll need to remember the sets we've laid out,
+	// and which sets share the sounds of another set (those sets must not be written).
+	Boolean isDeduplicating = ((inSaveFlags & saveFlag_Deduplicate) != 0);
+	CSoundSetIndex theSetIndex;
+	StPointerBlock theSharedSets( isDeduplicating ? (theNumClasses * theNumSets) : 0,
+								  true, true );
+	SInt32 theBytesSaved = 0;
+	
+	SInt16 i;
+	
+	// create 8-bit class headers.
+	for (i = 0; i < theNumClasses; i++)
+	{
+		// get the class info from our data.
+		const CWailSoundClass* theWailClass = mSoundClasses[i + 1];
+		
+		// start from a fresh class header.
+		SMthonSoundClass& theMthonClass = theClassHeaders[i];
+		theMthonClass = SMthonSoundClass();
+		
+		// copy trivial info.
+		theMthonClass.mClassID = theWailClass->mClassID;
+		theMthonClass.mVolume = theWailClass->mVolume;
+		theMthonClass.mFlags = theWailClass->mFlags;
+		
+		theMthonClass.mChance = theWailClass->mChance;
+		theMthonClass.mLowPitch = theWailClass->mLowPitch;
+		theMthonClass.mHighPitch = theWailClass->mHighPitch;
+		
+		// lay out the sounds, unless they're already somewhere in the file.
+		SInt32 theSameSet;
+		if (isDeduplicating && theSetIndex.FindSameSet( theWailClass->mNum8bitSounds,
+														 theWailClass->m8bitSounds,
+														 theSameSet ))
+		{
+			CopySoundSetLayout( theClassHeaders[theSameSet], theMthonClass );
+			theSharedSets[i] = true;
+			theBytesSaved += theMthonClass.mTotalLength;
+		}
+		else
+		{
+			LayOutSoundSet( theWailClass->mNum8bitSounds,
+							theWailClass->m8bitSounds,
+							theCurrentOffset,
+							theMthonClass );
+			if (isDeduplicating)
+				theSetIndex.AddSet( theWailClass->mNum8bitSounds,
+									theWailClass->m8bitSounds,
+									i,
+									theMthonClass.mFirstSoundOffset );
+		}
+		
+		// increment the progress bar.
+		theProgressDialog.Increment();
+	}
+	
+	// now, create 16-bit class headers.
+	if (theNumSets >= 2)
+	{
+		for (i = 0; i < theNumClasses; i++)
+		{
+			// get the class info from our data.
+			const CWailSoundClass* theWailClass = mSoundClasses[i + 1];
+			
+			// start from a fresh class header.
+			SMthonSoundClass& theMthonClass = theClassHeaders[theNumClasses + i];
+			theMthonClass = SMthonSoundClass();
+			
+			// copy trivial info.
+			theMthonClass.mClassID = theWailClass->mClassID;
+			theMthonClass.mVolume = theWailClass->mVolume;
+			theMthonClass.mFlags = theWailClass->mFlags;
+			
+			// here, it depends on whether the class is remapping 8-bit sounds or not.
+			SInt32 theSameSet;
+			if (theWailClass->mRemap8bit)
+			{
+				// the class is simply remapping 8-bit sounds, so we must copy
+				// the fields of the 8-bit class header.
+				CopySoundSetLayout( theClassHeaders[i], theMthonClass );
+				
+				// this class didn't add to the total length of the file, so don't touch the offset.
+			}
+			else if (isDeduplicating && theSetIndex.FindSameSet( theWailClass->mNum16bitSounds,
+																  theWailClass->m16bitSounds,
+																  theSameSet,
+																  theClassHeaders[i].mFirstSoundOffset ))
+			{
+				// those sounds are already in the file, point to them. the class's own
+				// 8-bit sounds are skipped: pointing to them would make the class look
+				// remapped when it's loaded.
+				CopySoundSetLayout( theClassHeaders[theSameSet], theMthonClass );
+				theSharedSets[theNumClasses + i] = true;
+				theBytesSaved += theMthonClass.mTotalLength;
+			}
+			else
+			{
+				// lay out the sounds.
+				LayOutSoundSet( theWailClass->mNum16bitSounds,
+								theWailClass->m16bitSounds,
+								theCurrentOffset,
+								theMthonClass );
+				if (isDeduplicating)
+					theSetIndex.AddSet( theWailClass->mNum16bitSounds,
+										theWailClass->m16bitSounds,
+										theNumClasses + i,
+										theMthonClass.mFirstSoundOffset );
+			}
+			
+			// increment the progress bar.
+			theProgressDialog.Increment();
+		}
+	}
+	
+	// see if we can write to a file directly.
+	LFileStream* theFileStream = dynamic_cast<LFileStream*>(inMthonSoundFile);
+	
+	// if user wants asynchronous writes, create an async writer for the file.
+	// if the stream is a CInFileStream, it doesn't start at the beginning of the file.
+	StDeleter<CAsyncFileWriter> theAsyncWriter;
+	if (((inSaveFlags & saveFlag_AsyncWrites) != 0) && (theFileStream != nil))
+	{
+		SInt32 theInset = 0;
+		CInFileStream* theInFileStream = dynamic_cast<CInFileStream*>(theFileStream);
+		if (theInFileStream != nil)
+			theInset = theInFileStream->GetInset();
+		
+		// positional writes can't start past the end of the file, so give it
+		// its final length now. theCurrentOffset is right after the last sound.
+		inMthonSoundFile->SetLength( theCurrentOffset );
+		
+		theAsyncWriter.Adopt( new CAsyncFileWriter( theFileStream->GetDataForkRefNum(),
+													theInset ) );
+	}
+	
+	// now that we have all the headers, we can write them to the file.
+	if (theAsyncWriter.Get() != nil)
+	{
+		theAsyncWriter->WriteAt( 0, theTables, theTablesLength );
+	}
+	else
+	{
+		inMthonSoundFile->SetMarker( 0, streamFrom_Start );
+		inMthonSoundFile->WriteBlock( theTables, theTablesLength );
+	}
+	
+	// now, all we must add are the sounds themselves.
+	CSoundRunWriter theWriter( *inMthonSoundFile, theTablesLength, theAsyncWriter.Get() );
+	
+	// start with 8-bit sounds.
+	for (i = 0; i < theNumClasses; i++)
+	{
+		// get the class from our data.
+		const CWailSoundClass* theWailClass = mSoundClasses[i + 1];
+		
+		// write all the sounds of that class, unless another class wrote them.
+		if (!isDeduplicating || !theSharedSets[i])
+		{
+			SInt16 j;
+			for (j = 0; j < theWailClass->mNum8bitSounds; ++j)
+				theWriter.WriteSound( theWailClass->m8bitSounds[j] );
+		}
+		
+		// increment the progress bar.
+		theProgressDialog.Increment();
+	}
+	
+	// now, 16-bit sounds.
+	if (theNumSets >= 2)
+	{
+		for (i = 0; i < theNumClasses; i++)
+		{
+			// get the class from our data.
+			const CWailSoundClass* theWailClass = mSoundClasses[i + 1];
+			
+			// we only write 16-bit sounds if they're not remapped or shared.
+			if (!theWailClass->mRemap8bit &&
+				(!isDeduplicating || !theSharedSets[theNumClasses + i]))
+			{
+				// write all the sounds of that class.
+				SInt16 j;
+				for (j = 0; j < theWailClass->mNum16bitSounds; j++)
+					theWriter.WriteSound( theWailClass->m16bitSounds[j] );
+			}
+			
+			// increment the progress bar.
+			theProgressDialog.Increment();
+		}
+	}
+	
+	// write whatever is left.
+	theWriter.Flush();
+	
+	// wait until everything is written, if needed.
+	if (theAsyncWriter.Get() != nil)
+		theAsyncWriter->WaitForAll();
+	
+	// if user wants to, flush the file and make sure it contains what we wanted.
+	if ((inSaveFlags & saveFlag_FlushAndVerify) != 0)
+	{
+		if (theFileStream != nil)
+			CAsyncFileWriter::FlushFile( theFileStream->GetDataForkRefNum() );
+		
+		// check the headers.
+		{
+			StPointerBlock theWrittenTables( theTablesLength );
+			inMthonSoundFile->SetMarker( 0, streamFrom_Start );
+			inMthonSoundFile->ReadBlock( theWrittenTables, theTablesLength );
+			if (BlockCompare( theWrittenTables, theTables,
+								theTablesLength, theTablesLength ) != 0)
+				Throw_( ioErr );
+		}
+		
+		// check the sounds.
+		for (i = 0; i < theNumClasses; i++)
+		{
+			const CWailSoundClass* theWailClass = mSoundClasses[i + 1];
+			
+			VerifySoundSet( inMthonSoundFile, theClassHeaders[i], theWailClass->m8bitSounds );
+			if ((theNumSets >= 2) && (!theWailClass->mRemap8bit))
+				VerifySoundSet( inMthonSoundFile, theClassHeaders[theNumClasses + i],
+								theWailClass->m16bitSounds );
+			
+			theProgressDialog.Increment( theNumSets );
+		}
+	}
+	
+	// hide progress dialog since we're done writing.
+	theProgressDialog.Hide();
+	
+	// tell user how much deduplicating helped.
+	if (outBytesSaved != nil)
+		*outBytesSaved = theBytesSaved;
+	
+	// we're done writing the data to the file.
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 LayOutSoundSet									[static]
+// ---------------------------------------------------------------------------------
+// fills the sound-related fields of the given class header, assuming its sounds
+// will be written at ioCurrentOffset in the file. ioCurrentOffset is then moved
+// past the sounds.
+
+void
+CWailSoundFileData::LayOutSoundSet(
+	SInt16				inNumSounds,
+	LStream* const		inSounds[5],
+	SInt32&				ioCurrentOffset,
+	SMthonSoundClass&	ioClassHeader )
+{
+	ioClassHeader.mNumSounds = inNumSounds;
+	
+	// set the first sound's offset to the current offset.
+	if (inNumSounds > 0)
+		ioClassHeader.mFirstSoundOffset = ioCurrentOffset;
+	else
+		ioClassHeader.mFirstSoundOffset = 0;
+		
+	ioClassHeader.mSoundOffset[0] = 0; // this one is always 0. (go figure. :)
+	
+	// set the first sound's length.
+	if (inNumSounds > 0)
+		ioClassHeader.mFirstSoundLength = inSounds[0]->GetLength();
+	else
+		ioClassHeader.mFirstSoundLength = 0;
+	
+	// create a temporary variable to calculate the total length taken by sounds of
+	// the class.
+	SInt32 theTotalLength = ioClassHeader.mFirstSoundLength;
+	
+	// calculate the relative offset of each sound, according to their
+	// length, and also calculate the total length.
+	SInt16 j;
+	for (j = 1; j < inNumSounds; j++)
+	{
+		// here's one damn easy way of calculating the offsets: the relative offset
+		// of a sound is always equal to theTotalLength :) [think about it.]
+		// we just need to set the sound's relative offset, then add the sound's size
+		// to theTotalLength.
+		ioClassHeader.mSoundOffset[j] = theTotalLength;
+		theTotalLength += inSounds[j]->GetLength();
+	}
+	
+	// fill up the array with 0, if there are slots left
+	for (; j < 5; j++)
+		ioClassHeader.mSoundOffset[j] = 0;
+	
+	// now that we know the total length of all sounds for sure, set it.
+	ioClassHeader.mTotalLength = theTotalLength;
+	
+	// add the total length to the current offset to work up the file.
+	ioCurrentOffset += theTotalLength;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CopySoundSetLayout								[static]
+// ---------------------------------------------------------------------------------
+// fills the sound-related fields of ioClassHeader so that it points to the same
+// sounds as inClassHeader.
+
+void
+CWailSoundFileData::CopySoundSetLayout(
+	const SMthonSoundClass&	inClassHeader,
+	SMthonSoundClass&		ioClassHeader )
+{
+	ioClassHeader.mNumSounds = inClassHeader.mNumSounds;
+	ioClassHeader.mFirstSoundOffset = inClassHeader.mFirstSoundOffset;
+	ioClassHeader.mFirstSoundLength = inClassHeader.mFirstSoundLength;
+	SInt16 j;
+	for (j = 0; j < 5; j++)
+	{
+		ioClassHeader.mSoundOffset[j] = inClassHeader.mSoundOffset[j];
+	}
+	
+	ioClassHeader.mTotalLength = inClassHeader.mTotalLength;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 VerifySoundSet									[static]
+// ---------------------------------------------------------------------------------
+// makes sure the sounds described by the given class header in the given file
+// are the same as the given sounds. throws if they're not.
+
+void
+CWailSoundFileData::VerifySoundSet(
+	LStream*				inMthonSoundFile,
+	const SMthonSoundClass&	inClassHeader,
+	LStream* const			inSounds[5] )
+{
+	SInt16 j;
+	for (j = 0; j < inClassHeader.mNumSounds; j++)
+	{
+		// look at the sound in the file through a stream view.
+		SInt32 theLength = inSounds[j]->GetLength();
+		CWailSoundStream theWrittenSound( inMthonSoundFile,
+										  inClassHeader.mFirstSoundOffset +
+										  	inClassHeader.mSoundOffset[j],
+										  theLength );
+		
+		if (!CWailSoundClass::AreSoundsSame( &theWrittenSound, inSounds[j] ))
+			Throw_( ioErr );
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 GetSoundClass
+// ---------------------------------------------------------------------------------
+// returns the class at the given index in mSoundClasses (1-based), after making sure
+// its sounds are read. use this instead of looking in mSoundClasses directly if you
+// need the class's sounds and we might have been loaded lazily.
+
+CWailSoundClass*
+CWailSoundFileData::GetSoundClass(
+	SInt32	inIndex )
+{
+	CWailSoundClass* theClass = nil;
+	ThrowIf_( !mSoundClasses.FetchItemAt( inIndex, theClass ) );
+	
+	theClass->ReadDeferredSounds();
+	
+	return theClass;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 PrefetchClasses
+// ---------------------------------------------------------------------------------
+// makes sure sounds of classes inFirstIndex to inLastIndex (1-based, inclusive) are
+// read. indexes out of range are ignored. useful to read a bunch of classes at once
+// before going through them.
+
+void
+CWailSoundFileData::PrefetchClasses(
+	SInt32	inFirstIndex,
+	SInt32	inLastIndex )
+{
+	if (inFirstIndex < 1)
+		inFirstIndex = 1;
+	if (inLastIndex > mSoundClasses.GetCount())
+		inLastIndex = mSoundClasses.GetCount();
+	
+	for (SInt32 i = inFirstIndex; i <= inLastIndex; i++)
+		mSoundClasses[i]->ReadDeferredSounds();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 PrefetchAllClasses
+// ---------------------------------------------------------------------------------
+// makes sure sounds of all our classes are read.
+
+void
+CWailSoundFileData::PrefetchAllClasses()
+{
+	PrefetchClasses( 1, mSoundClasses.GetCount() );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CanSaveInPlace
+// ---------------------------------------------------------------------------------
+// returns true if SaveInPlace can be used to save our data to the file it was
+// loaded from. this is the case as long as the file's layout didn't change, i.e.
+// we still have the same number of classes and sound sets.
+
+Boolean
+CWailSoundFileData::CanSaveInPlace() const
+{
+	return ((mDiskNumClasses >= 0) &&
+			(mDiskNumClasses == mSoundClasses.GetCount()) &&
+			(mDiskDemoLayout == mDemoLayout) &&
+			(mDiskNumSets == (mDemoLayout ? 1 : 2)));
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 SaveInPlace
+// ---------------------------------------------------------------------------------
+// saves our data to the file it was loaded from, by only writing what changed.
+// classes that didn't change (see CWailSoundClass::mDirty) are left alone. for
+// classes that did, sounds are written where no class header on disk points to:
+// in a gap left by a previous save if one is big enough, or at the end of the file.
+// the sounds are flushed before the class headers are rewritten, so if we crash
+// before that, the file still holds its old sounds and headers. the places of the
+// old sounds can only be reused by the next save. space lost this way can be
+// reclaimed by saving the whole file with SaveToFile.
+//
+// call CanSaveInPlace first. inFileSpec must be the file we were loaded from.
+//
+// sounds of changed classes are replaced, so whoever holds pointers to them
+// (undoable actions, for instance) must let go of them first.
+
+void
+CWailSoundFileData::SaveInPlace(
+	FSSpec&	inFileSpec )
+{
+	ThrowIf_( !CanSaveInPlace() );
+	
+	// we need the file opened with write permission. if we're viewing it, it's already
+	// open that way; otherwise (e.g. if it was mapped), open it now.
+	LFileStream* theFileStream = dynamic_cast<LFileStream*>(mViewedStream);
+	StDeleter<LFileStream> theOwnedFileStream;
+	if (theFileStream == nil)
 	{
-		theHeader.mNumClasses = theHeader.mNumSets;
-		theHeader.mNumSets = 1;
+		theOwnedFileStream.Adopt( new LFileStream( inFileSpec ) );
+		theOwnedFileStream->OpenDataFork( fsRdWrPerm );
+		theFileStream = theOwnedFileStream.Get();
 	}
 	
-	// create a progress dialog.
-	CWailProgressDialog theProgressDialog( theHeader.mNumClasses * 6,
+	SInt16 theNumClasses = mSoundClasses.GetCount();
+	SInt16 theNumSets = mDiskNumSets;
+	SInt32 theEndOfFile = theFileStream->GetLength();
+	
+	// find out which parts of the file are used by the sounds on disk. we can't
+	// write there until the new class headers are safely written.
+	TArray<SFileRegion> theRegions;
+	GetDiskRegions( theRegions );
+	
+	// start from the class headers that are on disk. we'll only change those of
+	// classes that changed.
+	SInt32 theNumHeaders = theNumClasses * theNumSets;
+	StPointerBlock theTables( sizeof(SMthonSoundClass) * theNumHeaders );
+	SMthonSoundClass* theClassHeaders = (SMthonSoundClass*) (Ptr) theTables;
+	SInt32 k;
+	for (k = 0; k < theNumHeaders; k++)
+		theClassHeaders[k] = mDiskHeaders[k + 1];
+	
+	// this will hold the data of each sound set we need to write.
+	StPointerBlock theSetDataBlock( sizeof(Ptr) * theNumHeaders, true, true );
+	Ptr* theSetData = (Ptr*) (Ptr) theSetDataBlock;
+	
+	CWailProgressDialog theProgressDialog( theNumClasses * 2,
 										   progressString_SavingSoundData,
 										   nil );
 	
-	// ok. now we have to make up the class header list. this is more tricky since we need to figure
-	// out in advance the offset of the first sound of each class in the final file.
-	// we will create an array of SMthonSoundClass objects and figure out each offset one by one.
-	// figuring relative offsets is easy, but we need to start counting the first sound offsets.
-	// we will create a variable called theCurrentOffset that will start right after the class header
-	// list and keep track of where sounds will be written in the final file. this variable will
-	// start right after the sound file header and class header list. each time we create a new
-	// class header, we will add that class header's totalLength to theCurrentOffset.
-	SInt32 theCurrentOffset = (
-		/* skip sound file header: */ sizeof(SMthonSoundHeader) +
-		/* skip class headers: */ ( sizeof(SMthonSoundClass) * theHeader.mNumClasses * theHeader.mNumSets )
-							 );
-	
-	TArray<SMthonSoundClass*> theClassHeaderArray;	// we define our array. it's currently empty.
-	
 	SInt16 i;
-	
-	// create 8-bit class headers.
-	if (theHeader.mNumSets >= 1)
+	try
 	{
-		theClassHeaderArray.AdjustAllocation( theHeader.mNumClasses );
-		for (i = 0; i < theHeader.mNumClasses; i++)
+		// first, read the sounds of every class that changed. we must do this before
+		// writing anything, since these sounds might come from places we'll overwrite.
+		for (i = 0; i < theNumClasses; i++)
 		{
-			// get the class info from our data.
-			CWailSoundClass *theWailClass;
-			mSoundClasses.FetchItemAt( i + 1, theWailClass );
-			
-			// create a new SMthonSoundClass struct.
-			SMthonSoundClass *theMthonClass = new SMthonSoundClass;
-			
-			// copy trivial info.
-			theMthonClass->mClassID = theWailClass->mClassID;
-			theMthonClass->mVolume = theWailClass->mVolume;
-			theMthonClass->mFlags = theWailClass->mFlags;
-			
-			theMthonClass->mChance = theWailClass->mChance;
-			theMthonClass->mLowPitch = theWailClass->mLowPitch;
-			theMthonClass->mHighPitch = theWailClass->mHighPitch;
-			
-			theMthonClass->mNumSounds = theWailClass->mNum8bitSounds;
-			
-			// set the first sound's offset to the current offset.
-			if (theMthonClass->mNumSounds > 0)
-				theMthonClass->mFirstSoundOffset = theCurrentOffset;
-			else
-				theMthonClass->mFirstSoundOffset = 0;
-				
-			theMthonClass->mSoundOffset[0] = 0; // this one is always 0. (go figure. :)
-			
-			// set the first sound's length.
-			if (theMthonClass->mNumSounds > 0)
-				theMthonClass->mFirstSoundLength = theWailClass->m8bitSounds[0]->GetLength();
-			else
-				theMthonClass->mFirstSoundLength = 0;
-			
-			// create a temporary variable to calculate the total length taken by sounds of
-			// the class.
-			SInt32 theTotalLength = theMthonClass->mFirstSoundLength;
-			
-			// calculate the relative offset of each sound, according to their
-			// length, and also calculate the total length.
-			SInt16 j;
-			for (j = 1; j < theMthonClass->mNumSounds; j++)
+			CWailSoundClass* theWailClass = mSoundClasses[i + 1];
+			if (theWailClass->mDirty || (theWailClass->mDiskIndex != i + 1))
 			{
-				// here's one damn easy way of calculating the offsets: the relative offset
-				// of a sound is always equal to theTotalLength :) [think about it.]
-				// we just need to set the sound's relative offset, then add the sound's size
-				// to theTotalLength.
-				theMthonClass->mSoundOffset[j] = theTotalLength;
-				theTotalLength += theWailClass->m8bitSounds[j]->GetLength();
+				// a class that only moved might not have read its sounds yet.
+				theWailClass->ReadDeferredSounds();
+				
+				theSetData[i] = ReadSoundSetData( theWailClass->mNum8bitSounds,
+												  theWailClass->m8bitSounds );
+				if ((theNumSets >= 2) && (!theWailClass->mRemap8bit))
+					theSetData[theNumClasses + i] =
+						ReadSoundSetData( theWailClass->mNum16bitSounds,
+										  theWailClass->m16bitSounds );
 			}
 			
-			// fill up the array with 0, if there are slots left
-			for (; j < 5; j++)
-				theMthonClass->mSoundOffset[j] = 0;
-			
-			// now that we know the total length of all sounds for sure, set it.
-			theMthonClass->mTotalLength = theTotalLength;
-			
-			// we now have the complete SMthonSoundClass struct filled up.
-			// add it to our array.
-			theClassHeaderArray.AddItem( theMthonClass );
-			
-			// add the total length to the current offset to work up the file.
-			theCurrentOffset += theTotalLength;
-			
-			// increment the progress bar.
 			theProgressDialog.Increment();
 		}
-	}
-	
-	// now, create 16-bit class headers.
-	if (theHeader.mNumSets >= 2)
-	{
-		theClassHeaderArray.AdjustAllocation( theHeader.mNumClasses );
-		for (i = 0; i < theHeader.mNumClasses; i++)
+		
+		// now, find a place for each of these sets, fill the class headers and write
+		// the sounds.
+		for (i = 0; i < theNumClasses; i++)
 		{
-			// get the class info from our data.
-			CWailSoundClass *theWailClass;
-			mSoundClasses.FetchItemAt( i + 1, theWailClass );
-			
-			// create a new SMthonSoundClass struct.
-			SMthonSoundClass *theMthonClass = new SMthonSoundClass;
-			
-			// copy trivial info.
-			theMthonClass->mClassID = theWailClass->mClassID;
-			theMthonClass->mVolume = theWailClass->mVolume;
-			theMthonClass->mFlags = theWailClass->mFlags;
-			
-			// here, it depends on whether the class is remapping 8-bit sounds or not.
-			SInt32 theTotalLength;
-			if (!theWailClass->mRemap8bit)
+			CWailSoundClass* theWailClass = mSoundClasses[i + 1];
+			if (theWailClass->mDirty || (theWailClass->mDiskIndex != i + 1))
 			{
-				theMthonClass->mNumSounds = theWailClass->mNum16bitSounds;
+				// 8-bit class header. see SaveToFile.
+				SMthonSoundClass& the8bitClass = theClassHeaders[i];
+				the8bitClass = SMthonSoundClass();
 				
-				// set the first sound's offset to the current offset.
-				if (theMthonClass->mNumSounds > 0)
-					theMthonClass->mFirstSoundOffset = theCurrentOffset;
-				else
-					theMthonClass->mFirstSoundOffset = 0;
-					
-				theMthonClass->mSoundOffset[0] = 0; // this one is always 0. (go figure. :)
+				the8bitClass.mClassID = theWailClass->mClassID;
+				the8bitClass.mVolume = theWailClass->mVolume;
+				the8bitClass.mFlags = theWailClass->mFlags;
 				
-				// set the first sound's length.
-				if (theMthonClass->mNumSounds > 0)
-					theMthonClass->mFirstSoundLength = theWailClass->m16bitSounds[0]->GetLength();
-				else
-					theMthonClass->mFirstSoundLength = 0;
+				the8bitClass.mChance = theWailClass->mChance;
+				the8bitClass.mLowPitch = theWailClass->mLowPitch;
+				the8bitClass.mHighPitch = theWailClass->mHighPitch;
 				
-				// create a temporary variable to calculate the total length taken by sounds of
-				// the class.
-				theTotalLength = theMthonClass->mFirstSoundLength;
+				SInt32 theLength = (theSetData[i] != nil) ? ::GetPtrSize( theSetData[i] ) : 0;
+				SInt32 theOffset = FindRoomForSoundSet( theLength, theRegions, theEndOfFile );
+				LayOutSoundSet( theWailClass->mNum8bitSounds,
+								theWailClass->m8bitSounds,
+								theOffset,
+								the8bitClass );
 				
-				// calculate the relative offset of each sound, according to their
-				// length, and also calculate the total length.
-				SInt16 j;
-				for (j = 1; j < theMthonClass->mNumSounds; j++)
+				if (theLength > 0)
 				{
-					// here's one damn easy way of calculating the offsets: the relative offset
-					// of a sound is always equal to theTotalLength :) [think about it.]
-					// we just need to set the sound's relative offset, then add the sound's size
-					// to theTotalLength.
-					theMthonClass->mSoundOffset[j] = theTotalLength;
-					theTotalLength += theWailClass->m16bitSounds[j]->GetLength();
+					theFileStream->SetMarker( the8bitClass.mFirstSoundOffset, streamFrom_Start );
+					theFileStream->WriteBlock( theSetData[i], theLength );
 				}
 				
-				// fill up the array with 0, if there are slots left
-				for (; j < 5; j++)
-					theMthonClass->mSoundOffset[j] = 0;
-				
-				// now that we know the total length of all sounds for sure, set it.
-				theMthonClass->mTotalLength = theTotalLength;
-				
-				// we now have the complete SMthonSoundClass struct filled up.
-				// add it to our array.
-				theClassHeaderArray.AddItem( theMthonClass );
-				
-				// add the total length to the current offset to work up the file.
-				theCurrentOffset += theTotalLength;
+				// 16-bit class header.
+				if (theNumSets >= 2)
+				{
+					SMthonSoundClass& the16bitClass = theClassHeaders[theNumClasses + i];
+					the16bitClass = SMthonSoundClass();
+					
+					the16bitClass.mClassID = theWailClass->mClassID;
+					the16bitClass.mVolume = theWailClass->mVolume;
+					the16bitClass.mFlags = theWailClass->mFlags;
+					
+					if (!theWailClass->mRemap8bit)
+					{
+						theLength = (theSetData[theNumClasses + i] != nil)
+										? ::GetPtrSize( theSetData[theNumClasses + i] ) : 0;
+						theOffset = FindRoomForSoundSet( theLength, theRegions, theEndOfFile );
+						LayOutSoundSet( theWailClass->mNum16bitSounds,
+										theWailClass->m16bitSounds,
+										theOffset,
+										the16bitClass );
+						
+						if (theLength > 0)
+						{
+							theFileStream->SetMarker( the16bitClass.mFirstSoundOffset,
+													  streamFrom_Start );
+							theFileStream->WriteBlock( theSetData[theNumClasses + i], theLength );
+						}
+					}
+					else
+					{
+						// remapped: point to the 8-bit sounds.
+						the16bitClass.mNumSounds = the8bitClass.mNumSounds;
+						the16bitClass.mFirstSoundOffset = the8bitClass.mFirstSoundOffset;
+						the16bitClass.mFirstSoundLength = the8bitClass.mFirstSoundLength;
+						for (SInt16 j = 0; j < 5; j++)
+							the16bitClass.mSoundOffset[j] = the8bitClass.mSoundOffset[j];
+						the16bitClass.mTotalLength = the8bitClass.mTotalLength;
+					}
+				}
 			}
-			else
-			{
-				// the class is simply remapping 8-bit sounds, so we must fetch the
-				// 8-bit class and copy its fields.
-				SMthonSoundClass* the8bitClass;
-				ThrowIf_( !theClassHeaderArray.FetchItemAt( i + 1, the8bitClass ) );
-					// we won't need to free up this, since it's in the array already.
 			
-				theMthonClass->mNumSounds = the8bitClass->mNumSounds;
-				theMthonClass->mFirstSoundOffset = the8bitClass->mFirstSoundOffset;
-				theMthonClass->mFirstSoundLength = the8bitClass->mFirstSoundLength;
-				SInt16 j;
-				for (j = 0; j < 5; j++)
+			theProgressDialog.Increment();
+		}
+		
+		// make sure the sounds are on disk before the class headers point to them.
+		CAsyncFileWriter::FlushFile( theFileStream->GetDataForkRefNum() );
+		
+		// write the class headers, right after the file header (which didn't change).
+		theFileStream->SetMarker( sizeof(SMthonSoundHeader), streamFrom_Start );
+		theFileStream->WriteBlock( theTables, sizeof(SMthonSoundClass) * theNumHeaders );
+		CAsyncFileWriter::FlushFile( theFileStream->GetDataForkRefNum() );
+		
+		// the file now matches our data. remember its new layout, and replace the sounds
+		// of classes we wrote, since their old sounds might point to places we overwrote.
+		// if we're viewing the file, view the new sounds; otherwise, keep them in RAM.
+		for (k = 0; k < theNumHeaders; k++)
+			mDiskHeaders[k + 1] = theClassHeaders[k];
+		
+		for (i = 0; i < theNumClasses; i++)
+		{
+			CWailSoundClass* theWailClass = mSoundClasses[i + 1];
+			if (theWailClass->mDirty || (theWailClass->mDiskIndex != i + 1))
+			{
+				for (SInt16 theSet = 0; theSet < theNumSets; theSet++)
 				{
-					theMthonClass->mSoundOffset[j] = the8bitClass->mSoundOffset[j];
+					Ptr theData = theSetData[(theSet * theNumClasses) + i];
+					if (theData == nil)
+						continue;
+					
+					const SMthonSoundClass& theHeader = theClassHeaders[(theSet * theNumClasses) + i];
+					LStream** theSounds = (theSet == 0) ? theWailClass->m8bitSounds
+														: theWailClass->m16bitSounds;
+					
+					SInt32 theSoundOffset = 0;
+					for (SInt16 j = 0; j < theHeader.mNumSounds; j++)
+					{
+						SInt32 theSoundLength = theSounds[j]->GetLength();
+						
+						CWailSoundStream* theNewSound = nil;
+						if (theFileStream == mViewedStream)
+							theNewSound = new CWailSoundStream( mViewedStream,
+																theHeader.mFirstSoundOffset +
+																	theSoundOffset,
+																theSoundLength );
+						else
+							theNewSound = new CWailSoundStream( theData + theSoundOffset,
+																theSoundLength );
+						
+						delete theSounds[j];
+						theSounds[j] = theNewSound;
+						
+						theSoundOffset += theSoundLength;
+					}
 				}
 				
-				theMthonClass->mTotalLength = the8bitClass->mTotalLength;
-				
-				// we now have the complete SMthonSoundClass struct filled up.
-				// add it to our array.
-				theClassHeaderArray.AddItem( theMthonClass );
-				
-				// this class didn't add to the total length of the file, so don't touch the offset.
+				theWailClass->mDirty = false;
+				theWailClass->mDiskIndex = i + 1;
 			}
-			
-			// increment the progress bar.
-			theProgressDialog.Increment();
 		}
 	}
 	
-	// now that we have all the class headers, we can write them to the file.
-	for (i = 1; i <= theClassHeaderArray.GetCount(); ++i)
+	catch (...)
+	{
+		for (k = 0; k < theNumHeaders; k++)
+			if (theSetData[k] != nil)
+				::DisposePtr( theSetData[k] );
+		
+		throw;
+	}
+	
+	// get rid of the data we've written.
+	for (k = 0; k < theNumHeaders; k++)
+		if (theSetData[k] != nil)
+			::DisposePtr( theSetData[k] );
+	
+	theProgressDialog.Hide();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 GetDiskRegions
+// ---------------------------------------------------------------------------------
+// fills outRegions with the parts of the file used by the sounds of our class
+// headers on disk, sorted by offset. regions can overlap, e.g. when 8-bit sounds
+// are remapped.
+
+void
+CWailSoundFileData::GetDiskRegions(
+	TArray<SFileRegion>&	outRegions ) const
+{
+	outRegions.RemoveItemsAt( 0x7FFFFFFF, LArray::index_First );
+	
+	SInt32 theNumHeaders = mDiskHeaders.GetCount();
+	for (SInt32 k = 0; k < theNumHeaders; k++)
 	{
-		// get the class header from the array.
-		SMthonSoundClass *theClassHeader;
-		theClassHeaderArray.FetchItemAt( i, theClassHeader );
+		const SMthonSoundClass& theHeader = mDiskHeaders[k + 1];
+		if ((theHeader.mNumSounds > 0) && (theHeader.mFirstSoundOffset > 0))
+			AddDiskRegion( theHeader.mFirstSoundOffset, theHeader.mTotalLength, outRegions );
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 AddDiskRegion										[static]
+// ---------------------------------------------------------------------------------
+// adds the given part of the file to ioRegions, keeping them sorted by offset.
+
+void
+CWailSoundFileData::AddDiskRegion(
+	SInt32					inStart,
+	SInt32					inLength,
+	TArray<SFileRegion>&	ioRegions )
+{
+	SFileRegion theRegion;
+	theRegion.mStart = inStart;
+	theRegion.mEnd = inStart + inLength;
+	
+	ArrayIndexT theIndex = 1;
+	SInt32 theCount = ioRegions.GetCount();
+	while ((theIndex <= theCount) && (ioRegions[theIndex].mStart <= inStart))
+		theIndex++;
+	
+	ioRegions.InsertItemsAt( 1, theIndex, theRegion );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 FindRoomForSoundSet
+// ---------------------------------------------------------------------------------
+// returns the offset where a sound set of the given length should be written when
+// saving in place. we only use space that's in none of ioRegions: the first gap
+// that's big enough, or else the end of the file, in which case ioEndOfFile moves.
+// the space we return is added to ioRegions so the next set doesn't get it too.
+
+SInt32
+CWailSoundFileData::FindRoomForSoundSet(
+	SInt32					inLength,
+	TArray<SFileRegion>&	ioRegions,
+	SInt32&					ioEndOfFile ) const
+{
+	if (inLength <= 0)
+		return 0;
+	
+	// sounds can't go before the end of the class headers.
+	SInt32 theGapStart = sizeof(SMthonSoundHeader) +
+						 (sizeof(SMthonSoundClass) * mDiskHeaders.GetCount());
+	SInt32 theOffset = -1;
 	
-		// write the class header to the stream.
-		inMthonSoundFile->WriteBlock( theClassHeader, sizeof(SMthonSoundClass) );
+	SInt32 theCount = ioRegions.GetCount();
+	for (ArrayIndexT k = 1; k <= theCount; k++)
+	{
+		const SFileRegion& theRegion = ioRegions[k];
+		if (theRegion.mStart - theGapStart >= inLength)
+		{
+			theOffset = theGapStart;
+			break;
+		}
 		
-		// increment the progress bar.
-		theProgressDialog.Increment();
+		if (theRegion.mEnd > theGapStart)
+			theGapStart = theRegion.mEnd;
 	}
 	
-	// now, all we must add are the sounds themselves.
-	// start with 8-bit sounds.
-	if (theHeader.mNumSets >= 1)
+	// no gap between regions is big enough. try what's left after the last one,
+	// then the end of the file.
+	if (theOffset == -1)
 	{
-		for (i = 0; i < theHeader.mNumClasses; i++)
+		if (ioEndOfFile - theGapStart >= inLength)
+			theOffset = theGapStart;
+		else
 		{
-			// get the class from our data.
-			CWailSoundClass *theWailClass;
-			mSoundClasses.FetchItemAt( i + 1, theWailClass );
-			
-			// write all the sounds of that class.
-			SInt16 j;
-			for (j = 0; j < theWailClass->mNum8bitSounds; ++j)
-			{
-				// get the sound from the class data.
-				Ptr theSoundP = ::NewPtr( theWailClass->m8bitSounds[j]->GetLength() );
-				ThrowIfNil_( theSoundP );
-				theWailClass->m8bitSounds[j]->SetMarker( 0, streamFrom_Start );
-				theWailClass->m8bitSounds[j]->ReadBlock( theSoundP,
-														 theWailClass->m8bitSounds[j]->GetLength() );
-				
-				// write it to the file.
-				inMthonSoundFile->WriteBlock( theSoundP,
-											  theWailClass->m8bitSounds[j]->GetLength() );
-											  
-				// dispose of the buffer.
-				::DisposePtr( theSoundP );
-			}
-			
-			// increment the progress bar.
-			theProgressDialog.Increment();
+			theOffset = (theGapStart > ioEndOfFile) ? theGapStart : ioEndOfFile;
+			ioEndOfFile = theOffset + inLength;
 		}
 	}
 	
-	// now, 16-bit sounds.
-	for (i = 0; i < theHeader.mNumClasses; i++)
+	AddDiskRegion( theOffset, inLength, ioRegions );
+	return theOffset;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ReadSoundSetData									[static]
+// ---------------------------------------------------------------------------------
+// reads the given sounds one after the other in a new pointer, which the caller
+// must dispose of. returns nil if there are no sounds.
+
+Ptr
+CWailSoundFileData::ReadSoundSetData(
+	SInt16			inNumSounds,
+	LStream* const	inSounds[5] )
+{
+	SInt32 theLength = 0;
+	SInt16 j;
+	for (j = 0; j < inNumSounds; j++)
+		theLength += inSounds[j]->GetLength();
+	
+	if (theLength == 0)
+		return nil;
+	
+	Ptr theData = ::NewPtr( theLength );
+	ThrowIfNil_( theData );
+	
+	try
 	{
-		// get the class from our data.
-		CWailSoundClass *theWailClass;
-		mSoundClasses.FetchItemAt( i + 1, theWailClass );
-		
-		// we only write 16-bit sounds if they're not remapped.
-		if (!theWailClass->mRemap8bit)
+		SInt32 theOffset = 0;
+		for (j = 0; j < inNumSounds; j++)
 		{
-			// write all the sounds of that class.
-			SInt16 j;
-			for (j = 0; j < theWailClass->mNum16bitSounds; j++)
-			{
-				// get the sound from the class data.
-				Ptr theSoundP = ::NewPtr( theWailClass->m16bitSounds[j]->GetLength() );
-				ThrowIfNil_( theSoundP );
-				theWailClass->m16bitSounds[j]->SetMarker( 0, streamFrom_Start );
-				theWailClass->m16bitSounds[j]->ReadBlock( theSoundP,
-														 theWailClass->m16bitSounds[j]->GetLength() );
-				// write it to the file.
-				inMthonSoundFile->WriteBlock( theSoundP,
-											  theWailClass->m16bitSounds[j]->GetLength() );
-											  
-				// dispose of the buffer.
-				::DisposePtr( theSoundP );	
-			}
+			SInt32 theSoundLength = inSounds[j]->GetLength();
+			inSounds[j]->SetMarker( 0, streamFrom_Start );
+			inSounds[j]->ReadBlock( theData + theOffset, theSoundLength );
+			theOffset += theSoundLength;
 		}
-		
-		// increment the progress bar.
-		theProgressDialog.Increment();
 	}
 	
-	// clear the class header array.
+	catch (...)
 	{
-		TArrayIterator<SMthonSoundClass*> theIterator( theClassHeaderArray );
-		SMthonSoundClass* theMthonClass = nil;
-		while (theIterator.Next( theMthonClass ))
-			delete theMthonClass;
-			
-		theClassHeaderArray.RemoveItemsAt( 0x7FFFFFFF, LArray::index_First );
+		::DisposePtr( theData );
+		throw;
 	}
 	
-	// hide progress dialog since we're done writing.
-	theProgressDialog.Hide();
+	return theData;
+}
+
+
+// ---------------------------------------------------------------------------
+//		 ChooseLoadMethod									[static]
+// ---------------------------------------------------------------------------
+// returns the fastest method that can be used to load a sound file of the given
+// length. if there's enough memory to map the whole file without touching the
+// RAM the user wants to protect, we map it. otherwise, we use stream views.
+
+ESoundLoadMethod
+CWailSoundFileData::ChooseLoadMethod(
+	SInt32	inFileLength )
+{
+	if (CMappedFileStream::CanMap( inFileLength, UWailPreferences::RAMToProtect() ))
+		return loadMethod_MapFile;
+	else
+		return loadMethod_ViewFile;
+}
+
+
+// ---------------------------------------------------------------------------
+//		 ReadFileTables									[static]
+// ---------------------------------------------------------------------------
+// reads the header and all class headers of a sound file, without reading any
+// sound. the tables are all at the beginning of the file, so we read a big chunk
+// at once and decode everything from there.
+//
+// patch: the M2 Demo Sounds file wasn't layed out exactly like we thought...
+// it has mNumClasses set to 0, and mNumSets set to the number of sound classes.
+// it doesn't seem to have 16-bit sounds either. so we switch it around here, and
+// fill missing sets with unused classes.
+
+void
+CWailSoundFileData::ReadFileTables(
+	LStream&			inMthonSoundFile,
+	SSoundFileTables&	outTables )
+{
+	SInt32 theTablesLength = inMthonSoundFile.GetLength();
+	if (theTablesLength > classTables_PrefetchSize)
+		theTablesLength = classTables_PrefetchSize;
 	
-	// we're done writing the data to the file.
+	// if the file is too small to contain a header, this will throw.
+	ThrowIf_( theTablesLength < (SInt32) sizeof(SMthonSoundHeader) );
+	StHandleBlock theTablesH( theTablesLength );
+	::HLock( theTablesH );
+	inMthonSoundFile.SetMarker( 0, streamFrom_Start );
+	inMthonSoundFile.ReadBlock( *theTablesH.Get(), theTablesLength );
+	
+	SMthonSoundHeader theHeader;
+	::BlockMoveData( *theTablesH.Get(), &theHeader, sizeof(SMthonSoundHeader) );
+	
+	outTables.mDemoLayout = ((theHeader.mNumClasses == 0) && (theHeader.mNumSets > 0));
+	if (outTables.mDemoLayout)
+	{
+		theHeader.mNumClasses = theHeader.mNumSets;
+		theHeader.mNumSets = 1;
+	}
+	
+	ThrowIf_( theHeader.mNumClasses < 0 );
+	outTables.mNumClasses = theHeader.mNumClasses;
+	outTables.mNumSets = (theHeader.mNumSets > 2) ? 2 : theHeader.mNumSets;
+	if (outTables.mNumSets < 0)
+		outTables.mNumSets = 0;
+	outTables.mLength = sizeof(SMthonSoundHeader) +
+						(sizeof(SMthonSoundClass) * outTables.mNumClasses * outTables.mNumSets);
+	
+	// make sure we have all class headers. if the file has more than what we've read,
+	// read the rest now. if it's too small, reading will throw for us.
+	if (outTables.mLength > theTablesLength)
+	{
+		::HUnlock( theTablesH );
+		::SetHandleSize( theTablesH, outTables.mLength );
+		ThrowIfMemError_();
+		::HLock( theTablesH );
+		
+		inMthonSoundFile.ReadBlock( (*theTablesH.Get()) + theTablesLength,
+									outTables.mLength - theTablesLength );
+	}
+	
+	// an unused class, for missing sets.
+	SMthonSoundClass theUnusedClass;
+	theUnusedClass.mClassID = classID_Unused;
+	theUnusedClass.mVolume = volume_Soft;
+	theUnusedClass.mFlags = 0;
+	theUnusedClass.mNumSounds = 0;
+	theUnusedClass.mFirstSoundOffset = 0;
+	theUnusedClass.mFirstSoundLength = 0;
+	theUnusedClass.mTotalLength = 0;
+	for (SInt16 j = 0; j < 5; j++)
+		theUnusedClass.mSoundOffset[j] = 0;
+	
+	outTables.m8bitClasses.RemoveItemsAt( 0x7FFFFFFF, LArray::index_First );
+	outTables.m16bitClasses.RemoveItemsAt( 0x7FFFFFFF, LArray::index_First );
+	outTables.m8bitClasses.AdjustAllocation( outTables.mNumClasses );
+	outTables.m16bitClasses.AdjustAllocation( outTables.mNumClasses );
+	
+	// 8-bit classes come first, then 16-bit classes.
+	for (SInt32 i = 0; i < outTables.mNumClasses; i++)
+	{
+		SMthonSoundClass theClass;
+		
+		if (outTables.mNumSets >= 1)
+			::BlockMoveData( *theTablesH.Get() + sizeof(SMthonSoundHeader) +
+							 (sizeof(SMthonSoundClass) * i),
+							 &theClass,
+							 sizeof(SMthonSoundClass) );
+		else
+			theClass = theUnusedClass;
+		outTables.m8bitClasses.AddItem( theClass );
+	
+		if (outTables.mNumSets >= 2)
+			::BlockMoveData( *theTablesH.Get() + sizeof(SMthonSoundHeader) +
+							 (sizeof(SMthonSoundClass) * (outTables.mNumClasses + i)),
+							 &theClass,
+							 sizeof(SMthonSoundClass) );
+		else
+			theClass = theUnusedClass;
+		outTables.m16bitClasses.AddItem( theClass );
+	}
+}
+
+
+// ---------------------------------------------------------------------------
+//		 HashFileTables									[static]
+// ---------------------------------------------------------------------------
+// hashes the header and the class headers of a sound file, without looking at
+// any sound. two files with the same hash have their sounds at the same places.
+// the tables are found with ReadFileTables, like the shuttle reads files.
+
+void
+CWailSoundFileData::HashFileTables(
+	LStream&		inMthonSoundFile,
+	SSoundHash&		outHash )
+{
+	SSoundFileTables theTables;
+	ReadFileTables( inMthonSoundFile, theTables );
+	
+	CWailSoundStream theTablesView( &inMthonSoundFile, 0, theTables.mLength );
+	outHash = theTablesView.GetContentHash();
 }
 
 
@@ -1108,6 +2303,10 @@ CWailSoundFileData::Clear()
 		
 	// clear the array.
 	mSoundClasses.RemoveItemsAt( 0x7FFFFFFF, LArray::index_First );
+	
+	// we no longer match any file.
+	mDiskHeaders.RemoveItemsAt( 0x7FFFFFFF, LArray::index_First );
+	mDiskNumClasses = -1;
 }
 
 
@@ -1140,68 +2339,77 @@ CWailSoundFileData::ClearViewedStream()
 // is similar to the given class of the other data, and replaces it with
 // an empty class.
 //
-// branches to the two protected functions to do the job, according to prefs.
+// according to prefs, classes are compared either as a whole, or by checking
+// 8-bit and 16-bit sounds separately (see ComputeCompareVerdict).
+//
+// this is done in two passes: first, all classes are compared without changing
+// anything, and the verdict for each class is noted. then verdicts are applied.
+// this way, what's removed doesn't depend on the order classes are compared in.
 
 void
 CWailSoundFileData::CompareAndKeepOnlyDiffs(
 	const CWailSoundFileData& inData )
 {
+	// we'll need all sounds of both datas. reading the sounds of the other data
+	// doesn't change what it contains, so it's ok to do it even if it's const.
+	PrefetchAllClasses();
+	const_cast<CWailSoundFileData&> (inData).PrefetchAllClasses();
+	
+	Boolean separately = false;
 	switch (UWailPreferences::CompareSettings())
 	{
 		case compareSetting_Together:
-			CompareAndKeepOnlyDiffsTogether( inData );
+			separately = false;
 			break;
 			
 		case compareSetting_Separately:
-			CompareAndKeepOnlyDiffsSeparately( inData );
+			separately = true;
 			break;
 			
 		default:	// programmer error or corruption?
 			SignalStringLiteral_( "Invalid compare setting value" );
-			break;
+			return;
 	}
+	
+	TArray<UInt8> theVerdicts;
+	ComputeCompareVerdicts( inData, separately, theVerdicts );
+	ApplyCompareVerdicts( theVerdicts, separately );
 }
 
 
 // ---------------------------------------------------------------------------------
-//		 CompareAndKeepOnlyDiffsTogether
+//		 ComputeCompareVerdicts
 // ---------------------------------------------------------------------------------
-// compares our data with the given data. remove from our data any class that
-// is similar to the given class of the other data, and replaces it with
-// an empty class.
+// compares each of our classes with the matching class of the given data, and
+// puts the verdict for each class in outVerdicts. nothing is changed.
 //
-// classes are compared as a whole, not 8-bit and 16-bit sounds independently.
+// if we don't have the same number of classes, compare up to the max number
+// of classes of the smallest data.
 
 void
-CWailSoundFileData::CompareAndKeepOnlyDiffsTogether(
-	const CWailSoundFileData& inData )
+CWailSoundFileData::ComputeCompareVerdicts(
+	const CWailSoundFileData&	inData,
+	Boolean						inSeparately,
+	TArray<UInt8>&				outVerdicts ) const
 {
-	// if we don't have the same number of classes, compare up to the max number
-	// of classes of the smallest data.
 	SInt32 numClasses = inData.mSoundClasses.GetCount();
 	if (mSoundClasses.GetCount() < numClasses)
 		numClasses = mSoundClasses.GetCount();
+	
+	outVerdicts.AdjustAllocation( numClasses );
 		
 	// create a progress dialog.
 	CWailProgressDialog theProgressDialog( numClasses,
 										   progressString_ComparingSoundData,
 										   nil );
-		
-	// big compare and eliminate thingy.
+	
 	SInt32 i;
 	for (i = 1; i <= numClasses; i++)
 	{
-		// fetch both classes.
-		CWailSoundClass* ourClass = mSoundClasses[i];
-		const CWailSoundClass* theirClass = inData.mSoundClasses[i];
-	
-		// are they the same?
-		if (*ourClass == *theirClass)
-		{
-			// yes. delete ours and replace it with a blank one.
-			delete ourClass;
-			mSoundClasses[i] = new CWailSoundClass();
-		}
+		UInt8 theVerdict = ComputeCompareVerdict( *mSoundClasses[i],
+												  *inData.mSoundClasses[i],
+												  inSeparately );
+		outVerdicts.AddItem( theVerdict );
 	
 		// increment progress dialog.
 		theProgressDialog.Increment();
@@ -1210,78 +2418,91 @@ CWailSoundFileData::CompareAndKeepOnlyDiffsTogether(
 
 
 // ---------------------------------------------------------------------------------
-//		 CompareAndKeepOnlyDiffsSeparately
+//		 ComputeCompareVerdict								[static]
 // ---------------------------------------------------------------------------------
-// compares our data with the given data. remove from our data any class that
-// is similar to the given class of the other data, and replaces it with
-// an empty class.
+// compares two classes and returns what's the same in them, as compareVerdict_
+// flags. we compare everything but sounds first (called "attributes"). if they're
+// the same, we go deeper and compare sounds.
 //
-// classes are compared this way: first, we compare everything for sounds (called "attributes").
-// if they're the same, we go deeper and compare 8-bit and 16-bit sounds separately.
-// if they end up being both the same, the whole class is dropped.
-
-void
-CWailSoundFileData::CompareAndKeepOnlyDiffsSeparately(
-	const CWailSoundFileData& inData )
+// when comparing classes as a whole, we stop as soon as something differs. when
+// comparing separately, both 8-bit and 16-bit sounds are compared, since either
+// one can be dropped on its own.
+
+UInt8
+CWailSoundFileData::ComputeCompareVerdict(
+	const CWailSoundClass&	inOurClass,
+	const CWailSoundClass&	inTheirClass,
+	Boolean					inSeparately )
 {
-	// if we don't have the same number of classes, compare up to the max number
-	// of classes of the smallest data.
-	SInt32 numClasses = inData.mSoundClasses.GetCount();
-	if (mSoundClasses.GetCount() < numClasses)
-		numClasses = mSoundClasses.GetCount();
+	UInt8 theVerdict = compareVerdict_None;
+	
+	if (inOurClass.AreAttributesSame( inTheirClass ))
+	{
+		theVerdict |= compareVerdict_SameAttributes;
 		
-	// create a progress dialog.
-	CWailProgressDialog theProgressDialog( numClasses,
-										   progressString_ComparingSoundData,
-										   nil );
+		if (inOurClass.Are8bitSoundsSame( inTheirClass ))
+			theVerdict |= compareVerdict_Same8bitSounds;
 		
-	// big compare and eliminate thingy.
+		if ((inSeparately || ((theVerdict & compareVerdict_Same8bitSounds) != 0)) &&
+			inOurClass.Are16bitSoundsSame( inTheirClass ))
+		{
+			theVerdict |= compareVerdict_Same16bitSounds;
+		}
+	}
+	
+	return theVerdict;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ApplyCompareVerdicts
+// ---------------------------------------------------------------------------------
+// removes what the verdicts found to be the same from our classes. classes that
+// are the same are replaced with blank ones. when comparing separately, classes
+// with the same attributes also lose their 8-bit or 16-bit sounds if those are
+// the same.
+
+void
+CWailSoundFileData::ApplyCompareVerdicts(
+	const TArray<UInt8>&	inVerdicts,
+	Boolean					inSeparately )
+{
+	SInt32 numClasses = inVerdicts.GetCount();
+	
 	SInt32 i;
 	for (i = 1; i <= numClasses; i++)
 	{
-		// fetch both classes.
+		UInt8 theVerdict = inVerdicts[i];
 		CWailSoundClass* ourClass = mSoundClasses[i];
-		const CWailSoundClass* theirClass = inData.mSoundClasses[i];
-	
-		// check attributes first.
-		if (ourClass->AreAttributesSame( *theirClass ))
+		
+		if (theVerdict == compareVerdict_SameClass)
+		{
+			// delete our class and replace it with a blank one.
+			delete ourClass;
+			mSoundClasses[i] = new CWailSoundClass();
+		}
+		else if (inSeparately && ((theVerdict & compareVerdict_SameAttributes) != 0))
 		{
-			SInt16 numDifferences = 0;
+			SInt16 j;
 			
-			// check 8-bit sounds.
-			if (ourClass->Are8bitSoundsSame( *theirClass ))
+			if ((theVerdict & compareVerdict_Same8bitSounds) != 0)
 			{
 				// we must delete 8-bit sounds from our class.
-				SInt16 i;
-				for (i = 0; i < ourClass->mNum8bitSounds; i++)
-					delete ourClass->m8bitSounds[i];
+				for (j = 0; j < ourClass->mNum8bitSounds; j++)
+					delete ourClass->m8bitSounds[j];
 				ourClass->mNum8bitSounds = 0;
-				
-				numDifferences++;
+				ourClass->mDirty = true;
 			}
 			
-			// check 16-bit sounds.
-			if (ourClass->Are16bitSoundsSame( *theirClass ))
+			if ((theVerdict & compareVerdict_Same16bitSounds) != 0)
 			{
 				// we must delete 16-bit sounds from our class.
-				SInt16 i;
-				for (i = 0; i < ourClass->mNum16bitSounds; i++)
-					delete ourClass->m16bitSounds[i];
+				for (j = 0; j < ourClass->mNum16bitSounds; j++)
+					delete ourClass->m16bitSounds[j];
 				ourClass->mNum16bitSounds = 0;
-				
-				numDifferences++;
-			}
-			
-			// if both are same, then delete the class altogether and replace it with a blank one.
-			if (numDifferences == 2)
-			{
-				delete ourClass;
-				mSoundClasses[i] = new CWailSoundClass();
+				ourClass->mDirty = true;
 			}
 		}
-	
-		// increment progress dialog.
-		theProgressDialog.Increment();
 	}
 }
 
@@ -190,10 +190,58 @@ SMthonSoundClass::SMthonSoundClass()
 // sounds, one for 16-bit sounds). you can then call ReadSounds, passing a valid
 // LStream pointing to a Marathon sound file, to read in all the sounds.
 
+// methods that can be used to read sounds from a Marathon sound file:
+
+enum ESoundLoadMethod
+{
+	loadMethod_ReadInRAM = 0,	// each sound is read and stored independently.
+	loadMethod_ViewFile,		// each sound is a stream view of the file.
+	loadMethod_MapFile			// the whole file is read at once and sounds point inside it.
+};
+
+// flags that can be passed to CWailSoundFileData::SaveToFile:
+
+const UInt32 saveFlag_None				= 0x00000000;
+const UInt32 saveFlag_AsyncWrites		= 0x00000001;	// queue positional writes asynchronously.
+const UInt32 saveFlag_FlushAndVerify	= 0x00000002;	// flush the file and read it back to check it.
+const UInt32 saveFlag_Deduplicate		= 0x00000004;	// store identical sound sets only once.
+
+// what CWailSoundFileData::CompareAndKeepOnlyDiffs found to be the same in a class:
+
+const UInt8 compareVerdict_None				= 0x00;
+const UInt8 compareVerdict_SameAttributes	= 0x01;	// everything but sounds.
+const UInt8 compareVerdict_Same8bitSounds	= 0x02;
+const UInt8 compareVerdict_Same16bitSounds	= 0x04;
+const UInt8 compareVerdict_SameClass		= 0x07;	// all of the above.
+
 // constant representing the header of a mac sound:
 
 const SInt32 macSound_Header[5] = {0x00010001,0x00050000,0x00A00001,0x80510000,0x00000014};
 
+struct SSoundHash;
+
+// a part of a sound file used by a sound set. used to find room for sound sets
+// when saving in place.
+
+struct SFileRegion
+{
+	SInt32	mStart;
+	SInt32	mEnd;
+};
+
+// the header and class headers of a sound file, as read by ReadFileTables. the M2 Demo
+// layout is already switched around, and missing sets are filled with unused classes.
+
+struct SSoundFileTables
+{
+	SInt32						mNumClasses;
+	SInt32						mNumSets;		// sets on disk, from 0 to 2.
+	Boolean						mDemoLayout;
+	SInt32						mLength;		// bytes taken by the tables on disk.
+	TArray<SMthonSoundClass>	m8bitClasses;
+	TArray<SMthonSoundClass>	m16bitClasses;
+};
+
 class CWailSoundClass
 {
 	public:
@@ -214,6 +262,11 @@ class CWailSoundClass
 		LStream		*m16bitSounds[5];	// 16-bit sounds.
 		Boolean		mRemap8bit;			// 8-bit remapping support.
 										// if true, mNum16bitSounds MUST be 0.
+		
+		Boolean		mDirty;				// true if the class changed since it was
+										// loaded or saved. set this when modifying it!
+		SInt32		mDiskIndex;			// index of the class in the file it was
+										// loaded from (1-based), or 0 if none.
 	
 	// Public Functions
 		//Default Constructor
@@ -231,7 +284,17 @@ class CWailSoundClass
 								LStream					*inMthonSoundFile,
 								const SMthonSoundClass&	in8bitClass,
 								const SMthonSoundClass& in16bitClass,
-								bool					inMapViewOfFile = false );
+								ESoundLoadMethod		inLoadMethod = loadMethod_ReadInRAM );
+		
+		// reading sounds only when needed
+		
+		void				DeferReadSounds(
+								LStream					*inMthonSoundFile,
+								const SMthonSoundClass&	in8bitClass,
+								const SMthonSoundClass& in16bitClass,
+								ESoundLoadMethod		inLoadMethod );
+		Boolean				AreSoundsRead() const { return (mDeferredSoundFile == nil); }
+		void				ReadDeferredSounds();
 									
 		// comparing classes
 		
@@ -256,6 +319,31 @@ class CWailSoundClass
 								
 		static SInt16		RoundChance(
 								SInt16					inChance );
+		static SInt32		GetSoundLengths(
+								const SMthonSoundClass&	inClass,
+								SInt32					outLengths[5] );
+		
+		static bool			AreSoundsSame(
+								LStream*				inSound1,
+								LStream*				inSound2 );
+		static bool			AreHashesSame(
+								const SSoundHash&		inHash1,
+								const SSoundHash&		inHash2 );
+		
+	protected:
+	
+		void				ReadSoundSet(
+								LStream					*inMthonSoundFile,
+								const SMthonSoundClass&	inClass,
+								ESoundLoadMethod		inLoadMethod,
+								LStream*				outSounds[5] );
+		
+	// where to read our sounds from, if it was deferred (see DeferReadSounds).
+	
+		LStream*			mDeferredSoundFile;
+		SMthonSoundClass	mDeferred8bitClass;
+		SMthonSoundClass	mDeferred16bitClass;
+		ESoundLoadMethod	mDeferredLoadMethod;
 		
 	private:
 		// Defensive programming. No copy constructor or operator=
@@ -277,8 +365,9 @@ class CWailSoundFileData
 							
 		//Stream Constructor
 								CWailSoundFileData(
-									LStream *inMthonSoundFile,
-									bool	inMapViewOfFile = false );
+									LStream				*inMthonSoundFile,
+									ESoundLoadMethod	inLoadMethod = loadMethod_ReadInRAM,
+									Boolean				inReadSoundsLazily = false );
 		
 		//Destructor
 		virtual					~CWailSoundFileData();
@@ -286,16 +375,48 @@ class CWailSoundFileData
 		// loading/saving
 		
 		void					LoadFromFile(
-									LStream *inMthonSoundFile,
-									bool	inMapViewOfFile = false );
+									LStream				*inMthonSoundFile,
+									ESoundLoadMethod	inLoadMethod = loadMethod_ReadInRAM,
+									Boolean				inReadSoundsLazily = false );
 		void					SaveToFile(
-									LStream	*inMthonSoundFile );
+									LStream	*inMthonSoundFile,
+									UInt32	inSaveFlags = saveFlag_None,
+									SInt32	*outBytesSaved = nil );
+		
+		// reading sounds of lazily-loaded classes
+		
+		CWailSoundClass*		GetSoundClass(
+									SInt32		inIndex );
+		void					PrefetchClasses(
+									SInt32		inFirstIndex,
+									SInt32		inLastIndex );
+		void					PrefetchAllClasses();
+		
+		// incremental saving
+		
+		Boolean					CanSaveInPlace() const;
+		void					SaveInPlace(
+									FSSpec&	inFileSpec );
 									
 		// Clearing
 									
 		void					Clear();
 		void					ClearViewedStream();
 									
+		// choosing a load method
+		
+		static ESoundLoadMethod	ChooseLoadMethod(
+									SInt32		inFileLength );
+									
+		// reading a file's layout
+		
+		static void				ReadFileTables(
+									LStream&			inMthonSoundFile,
+									SSoundFileTables&	outTables );
+		static void				HashFileTables(
+									LStream&		inMthonSoundFile,
+									SSoundHash&		outHash );
+									
 		// compare files feature:
 		
 		void					CompareAndKeepOnlyDiffs(
@@ -310,12 +431,47 @@ class CWailSoundFileData
 		
 	protected:
 	
+		// internal handling of the save routine
+		
+		static void				LayOutSoundSet(
+									SInt16				inNumSounds,
+									LStream* const		inSounds[5],
+									SInt32&				ioCurrentOffset,
+									SMthonSoundClass&	ioClassHeader );
+		static void				CopySoundSetLayout(
+									const SMthonSoundClass&	inClassHeader,
+									SMthonSoundClass&		ioClassHeader );
+		void					GetDiskRegions(
+									TArray<SFileRegion>& outRegions ) const;
+		static void				AddDiskRegion(
+									SInt32				inStart,
+									SInt32				inLength,
+									TArray<SFileRegion>& ioRegions );
+		SInt32					FindRoomForSoundSet(
+									SInt32				inLength,
+									TArray<SFileRegion>& ioRegions,
+									SInt32&				ioEndOfFile ) const;
+		static Ptr				ReadSoundSetData(
+									SInt16				inNumSounds,
+									LStream* const		inSounds[5] );
+		static void				VerifySoundSet(
+									LStream*				inMthonSoundFile,
+									const SMthonSoundClass&	inClassHeader,
+									LStream* const			inSounds[5] );
+	
 		// internal handling of the compare routine
 		
-		void					CompareAndKeepOnlyDiffsTogether(
-									const CWailSoundFileData& inData );
-		void					CompareAndKeepOnlyDiffsSeparately(
-									const CWailSoundFileData& inData );
+		void					ComputeCompareVerdicts(
+									const CWailSoundFileData& inData,
+									Boolean				inSeparately,
+									TArray<UInt8>&		outVerdicts ) const;
+		static UInt8			ComputeCompareVerdict(
+									const CWailSoundClass& inOurClass,
+									const CWailSoundClass& inTheirClass,
+									Boolean				inSeparately );
+		void					ApplyCompareVerdicts(
+									const TArray<UInt8>& inVerdicts,
+									Boolean				inSeparately );
 									
 		// Getting/setting the viewed stream
 		
@@ -328,6 +484,14 @@ class CWailSoundFileData
 	// Private member variables.
 	
 		LStream*				mViewedStream;
+		
+		// what the class headers look like in the file we were loaded from.
+		// used to save in place. mDiskNumClasses is -1 if we weren't loaded from a file.
+		
+		TArray<SMthonSoundClass>	mDiskHeaders;		// 8-bit headers, then 16-bit headers.
+		SInt16						mDiskNumClasses;
+		SInt16						mDiskNumSets;
+		Boolean						mDiskDemoLayout;
 	
 		// Defensive programming. No copy constructor or operator=
 								CWailSoundFileData( const CWailSoundFileData& );
@@ -0,0 +1,350 @@
+// =================================================================================
+//	CWailSoundFileDiff.cp					2003, Charles Lechasseur
+// =================================================================================
+//
+// CWailSoundFileDiff finds what changed between two Marathon sound files without
+// loading them as CWailSoundFileData. only the class headers of both files are
+// kept in memory; classes are walked side by side and their attributes compared
+// from the headers. sounds are compared straight from the files, one chunk at a
+// time, and only when their class exists in both files.
+//
+// the result is a list of SSoundFileChange, in class order, which can be written
+// as a tab-separated report with WriteReport.
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include "CWailSoundFileDiff.h"
+
+#include <UMemoryMgr.h>
+
+#include "CWailProgressDialog.h"
+#include "CWailSoundStream.h"
+
+
+// ---------------------------------------------------------------------------------
+//		 CWailSoundFileDiff			Constructor
+// ---------------------------------------------------------------------------------
+// reads the class headers of both files. the streams must stay alive while we are,
+// since sounds are read from them by Compare.
+
+CWailSoundFileDiff::CWailSoundFileDiff(
+	LStream&	inOldFile,
+	LStream&	inNewFile )
+	: mOldFile( inOldFile ),
+	  mNewFile( inNewFile )
+{
+	CWailSoundFileData::ReadFileTables( mOldFile, mOldTables );
+	CWailSoundFileData::ReadFileTables( mNewFile, mNewTables );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ~CWailSoundFileDiff			Destructor
+// ---------------------------------------------------------------------------------
+
+CWailSoundFileDiff::~CWailSoundFileDiff()
+{
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Compare
+// ---------------------------------------------------------------------------------
+// compares all classes of both files and notes what changed. classes that only
+// exist in one of the files are compared with an empty class.
+
+void
+CWailSoundFileDiff::Compare()
+{
+	mChanges.RemoveItemsAt( mChanges.GetCount(), LArray::index_First );
+	
+	SInt32 numClasses = mOldTables.mNumClasses;
+	if (mNewTables.mNumClasses > numClasses)
+		numClasses = mNewTables.mNumClasses;
+	
+	// create a progress dialog.
+	CWailProgressDialog theProgressDialog( numClasses,
+										   progressString_ComparingSoundData,
+										   nil );
+	
+	for (SInt32 i = 1; i <= numClasses; i++)
+	{
+		CompareClass( i );
+	
+		// increment progress dialog.
+		theProgressDialog.Increment();
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CountChangedClasses
+// ---------------------------------------------------------------------------------
+// returns the number of classes with at least one change. changes are stored in
+// class order, so we only need to count when the class index changes.
+
+SInt32
+CWailSoundFileDiff::CountChangedClasses() const
+{
+	SInt32 theCount = 0;
+	SInt32 theLastClass = 0;
+	
+	SInt32 numChanges = mChanges.GetCount();
+	for (SInt32 i = 1; i <= numChanges; i++)
+	{
+		if (mChanges[i].mClassIndex != theLastClass)
+		{
+			theLastClass = mChanges[i].mClassIndex;
+			theCount++;
+		}
+	}
+	
+	return theCount;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 WriteReport
+// ---------------------------------------------------------------------------------
+// writes one line per change in the given stream. each line contains, separated by
+// tabs: the class index, the kind of change, the sound index (1-based, empty if the
+// change isn't about a sound), the old value and the new value.
+
+void
+CWailSoundFileDiff::WriteReport(
+	LStream&	inReport ) const
+{
+	SInt32 numChanges = mChanges.GetCount();
+	for (SInt32 i = 1; i <= numChanges; i++)
+	{
+		const SSoundFileChange& theChange = mChanges[i];
+	
+		LStr255 theLine( theChange.mClassIndex );
+		theLine += "\p\t";
+		theLine += GetChangeName( theChange.mKind );
+		theLine += "\p\t";
+		if (theChange.mSoundIndex >= 0)
+			theLine += (SInt32) (theChange.mSoundIndex + 1);
+		theLine += "\p\t";
+		theLine += theChange.mOldValue;
+		theLine += "\p\t";
+		theLine += theChange.mNewValue;
+		theLine += "\p\r";
+	
+		inReport.WriteBlock( theLine.TextPtr(), theLine.Length() );
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CompareClass
+// ---------------------------------------------------------------------------------
+// compares the class at the given index in both files. we let CWailSoundClass
+// figure out what the headers mean (without reading any sound), so that we see
+// classes exactly like the rest of Wail does.
+
+void
+CWailSoundFileDiff::CompareClass(
+	SInt32	inClassIndex )
+{
+	// a class that's not in a file is the same as an empty class.
+	CWailSoundClass theEmptyClass;
+	StDeleter<CWailSoundClass> theOldClass;
+	StDeleter<CWailSoundClass> theNewClass;
+	if (inClassIndex <= mOldTables.mNumClasses)
+		theOldClass.Adopt( new CWailSoundClass( mOldTables.m8bitClasses[inClassIndex],
+												mOldTables.m16bitClasses[inClassIndex] ) );
+	if (inClassIndex <= mNewTables.mNumClasses)
+		theNewClass.Adopt( new CWailSoundClass( mNewTables.m8bitClasses[inClassIndex],
+												mNewTables.m16bitClasses[inClassIndex] ) );
+	const CWailSoundClass& theOld = (theOldClass.Get() != nil) ? *theOldClass.Get() : theEmptyClass;
+	const CWailSoundClass& theNew = (theNewClass.Get() != nil) ? *theNewClass.Get() : theEmptyClass;
+	
+	Boolean isOldEmpty = IsClassEmpty( theOld );
+	Boolean isNewEmpty = IsClassEmpty( theNew );
+	if (isOldEmpty && isNewEmpty)
+		return;
+	if (isOldEmpty)
+	{
+		AddChange( inClassIndex, fileChange_ClassAdded, -1, 0, theNew.mClassID );
+		return;
+	}
+	if (isNewEmpty)
+	{
+		AddChange( inClassIndex, fileChange_ClassRemoved, -1, theOld.mClassID, 0 );
+		return;
+	}
+	
+	// attributes.
+	if (theOld.mClassID != theNew.mClassID)
+		AddChange( inClassIndex, fileChange_ClassID, -1, theOld.mClassID, theNew.mClassID );
+	if (theOld.mVolume != theNew.mVolume)
+		AddChange( inClassIndex, fileChange_Volume, -1, theOld.mVolume, theNew.mVolume );
+	if (theOld.mFlags != theNew.mFlags)
+		AddChange( inClassIndex, fileChange_Flags, -1, theOld.mFlags, theNew.mFlags );
+	if (theOld.mChance != theNew.mChance)
+		AddChange( inClassIndex, fileChange_Chance, -1, theOld.mChance, theNew.mChance );
+	if (theOld.mLowPitch != theNew.mLowPitch)
+		AddChange( inClassIndex, fileChange_LowPitch, -1, theOld.mLowPitch, theNew.mLowPitch );
+	if (theOld.mHighPitch != theNew.mHighPitch)
+		AddChange( inClassIndex, fileChange_HighPitch, -1, theOld.mHighPitch, theNew.mHighPitch );
+	if (theOld.mRemap8bit != theNew.mRemap8bit)
+		AddChange( inClassIndex, fileChange_Remap8bit, -1, theOld.mRemap8bit, theNew.mRemap8bit );
+	
+	// sounds. remapped classes have no 16-bit sounds of their own.
+	CompareSoundSet( inClassIndex, true,
+					 theOld.mNum8bitSounds, mOldTables.m8bitClasses[inClassIndex],
+					 theNew.mNum8bitSounds, mNewTables.m8bitClasses[inClassIndex] );
+	CompareSoundSet( inClassIndex, false,
+					 theOld.mNum16bitSounds, mOldTables.m16bitClasses[inClassIndex],
+					 theNew.mNum16bitSounds, mNewTables.m16bitClasses[inClassIndex] );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CompareSoundSet
+// ---------------------------------------------------------------------------------
+// compares the sounds of a set in both files. sounds present in both are compared
+// straight from the files; the others are noted as added or removed.
+
+void
+CWailSoundFileDiff::CompareSoundSet(
+	SInt32					inClassIndex,
+	Boolean					in8bit,
+	SInt16					inOldNumSounds,
+	const SMthonSoundClass&	inOldClass,
+	SInt16					inNewNumSounds,
+	const SMthonSoundClass&	inNewClass )
+{
+	SInt32 theOldLengths[5], theNewLengths[5];
+	if (inOldNumSounds > 0)
+		CWailSoundClass::GetSoundLengths( inOldClass, theOldLengths );
+	if (inNewNumSounds > 0)
+		CWailSoundClass::GetSoundLengths( inNewClass, theNewLengths );
+	
+	SInt16 theNumCommon = (inOldNumSounds < inNewNumSounds) ? inOldNumSounds : inNewNumSounds;
+	SInt32 theOldOffset = inOldClass.mFirstSoundOffset;
+	SInt32 theNewOffset = inNewClass.mFirstSoundOffset;
+	SInt16 j;
+	for (j = 0; j < theNumCommon; j++)
+	{
+		CWailSoundStream theOldSound( &mOldFile, theOldOffset, theOldLengths[j] );
+		CWailSoundStream theNewSound( &mNewFile, theNewOffset, theNewLengths[j] );
+	
+		SInt32 theDifference = CWailSoundStream::FindFirstDifference( theOldSound, theNewSound );
+		if (theDifference >= 0)
+			AddChange( inClassIndex,
+					   in8bit ? fileChange_8bitSoundModified : fileChange_16bitSoundModified,
+					   j, theOldLengths[j], theNewLengths[j] );
+	
+		theOldOffset += theOldLengths[j];
+		theNewOffset += theNewLengths[j];
+	}
+	
+	for (j = theNumCommon; j < inOldNumSounds; j++)
+		AddChange( inClassIndex,
+				   in8bit ? fileChange_8bitSoundRemoved : fileChange_16bitSoundRemoved,
+				   j, theOldLengths[j], 0 );
+	
+	for (j = theNumCommon; j < inNewNumSounds; j++)
+		AddChange( inClassIndex,
+				   in8bit ? fileChange_8bitSoundAdded : fileChange_16bitSoundAdded,
+				   j, 0, theNewLengths[j] );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 AddChange
+// ---------------------------------------------------------------------------------
+
+void
+CWailSoundFileDiff::AddChange(
+	SInt32	inClassIndex,
+	SInt16	inKind,
+	SInt16	inSoundIndex,
+	SInt32	inOldValue,
+	SInt32	inNewValue )
+{
+	SSoundFileChange theChange;
+	theChange.mClassIndex = inClassIndex;
+	theChange.mKind = inKind;
+	theChange.mSoundIndex = inSoundIndex;
+	theChange.mOldValue = inOldValue;
+	theChange.mNewValue = inNewValue;
+	
+	mChanges.AddItem( theChange );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 IsClassEmpty										[static]
+// ---------------------------------------------------------------------------------
+// returns true if the class is unused and has no sounds.
+
+Boolean
+CWailSoundFileDiff::IsClassEmpty(
+	const CWailSoundClass&	inClass )
+{
+	return ((inClass.mClassID == classID_Unused) &&
+			(inClass.mNum8bitSounds == 0) &&
+			(inClass.mNum16bitSounds == 0) &&
+			!inClass.mRemap8bit);
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 GetChangeName										[static]
+// ---------------------------------------------------------------------------------
+// returns the name of a kind of change, as written in reports.
+
+ConstStringPtr
+CWailSoundFileDiff::GetChangeName(
+	SInt16	inKind )
+{
+	switch (inKind)
+	{
+		case fileChange_ClassAdded:				return "\pclassadded";
+		case fileChange_ClassRemoved:			return "\pclassremoved";
+		case fileChange_ClassID:				return "\pid";
+		case fileChange_Volume:					return "\pvolume";
+		case fileChange_Flags:					return "\pflags";
+		case fileChange_Chance:					return "\pchance";
+		case fileChange_LowPitch:				return "\plowpitch";
+		case fileChange_HighPitch:				return "\phighpitch";
+		case fileChange_Remap8bit:				return "\premap";
+		case fileChange_8bitSoundAdded:			return "\p8bitadded";
+		case fileChange_8bitSoundRemoved:		return "\p8bitremoved";
+		case fileChange_8bitSoundModified:		return "\p8bitmodified";
+		case fileChange_16bitSoundAdded:		return "\p16bitadded";
+		case fileChange_16bitSoundRemoved:		return "\p16bitremoved";
+		case fileChange_16bitSoundModified:		return "\p16bitmodified";
+	
+		default:	// programmer error or corruption?
+			SignalStringLiteral_( "Invalid file change kind" );
+			return "\p?";
+	}
+}
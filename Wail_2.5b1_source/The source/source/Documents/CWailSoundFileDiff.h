@@ -0,0 +1,122 @@
+// =================================================================================
+//	CWailSoundFileDiff.h					2003, Charles Lechasseur
+// =================================================================================
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <TArray.h>
+
+#include "CWailSoundFileData.h"
+
+
+// kinds of changes found by CWailSoundFileDiff:
+
+const SInt16	fileChange_ClassAdded			= 1;	// class is empty in the old file.
+const SInt16	fileChange_ClassRemoved			= 2;	// class is empty in the new file.
+const SInt16	fileChange_ClassID				= 3;	// attribute changes. old and new
+const SInt16	fileChange_Volume				= 4;	// values are given.
+const SInt16	fileChange_Flags				= 5;
+const SInt16	fileChange_Chance				= 6;
+const SInt16	fileChange_LowPitch				= 7;
+const SInt16	fileChange_HighPitch			= 8;
+const SInt16	fileChange_Remap8bit			= 9;
+const SInt16	fileChange_8bitSoundAdded		= 10;	// sound changes. the sound index
+const SInt16	fileChange_8bitSoundRemoved		= 11;	// is given, with the old and
+const SInt16	fileChange_8bitSoundModified	= 12;	// new lengths of the sound (0
+const SInt16	fileChange_16bitSoundAdded		= 13;	// if it's not there).
+const SInt16	fileChange_16bitSoundRemoved	= 14;
+const SInt16	fileChange_16bitSoundModified	= 15;
+
+struct SSoundFileChange
+{
+	SInt32		mClassIndex;	// 1-based index of the class that changed.
+	SInt16		mKind;			// see fileChange_ constants above.
+	SInt16		mSoundIndex;	// 0-based index of the sound, for sound changes.
+	SInt32		mOldValue;
+	SInt32		mNewValue;
+};
+
+
+// CWailSoundFileDiff class
+
+class CWailSoundFileDiff
+{
+	public:
+	
+							CWailSoundFileDiff(
+								LStream&			inOldFile,
+								LStream&			inNewFile );
+		virtual				~CWailSoundFileDiff();
+	
+		void				Compare();
+	
+		SInt32				CountChanges() const { return mChanges.GetCount(); }
+		const TArray<SSoundFileChange>&	GetChanges() const { return mChanges; }
+		SInt32				CountChangedClasses() const;
+	
+		void				WriteReport(
+								LStream&			inReport ) const;
+	
+		// looking at classes
+	
+		static Boolean		IsClassEmpty(
+								const CWailSoundClass& inClass );
+	
+	protected:
+	
+		void				CompareClass(
+								SInt32				inClassIndex );
+		void				CompareSoundSet(
+								SInt32				inClassIndex,
+								Boolean				in8bit,
+								SInt16				inOldNumSounds,
+								const SMthonSoundClass& inOldClass,
+								SInt16				inNewNumSounds,
+								const SMthonSoundClass& inNewClass );
+		void				AddChange(
+								SInt32				inClassIndex,
+								SInt16				inKind,
+								SInt16				inSoundIndex,
+								SInt32				inOldValue,
+								SInt32				inNewValue );
+	
+		static ConstStringPtr GetChangeName(
+								SInt16				inKind );
+	
+		LStream&					mOldFile;
+		LStream&					mNewFile;
+		SSoundFileTables			mOldTables;
+		SSoundFileTables			mNewTables;
+		TArray<SSoundFileChange>	mChanges;
+	
+	private:
+		// Defensive programming. No copy constructor or operator=
+							CWailSoundFileDiff( const CWailSoundFileDiff& );
+		CWailSoundFileDiff&	operator=( const CWailSoundFileDiff& );
+};
@@ -0,0 +1,320 @@
+// =================================================================================
+//	CWailSoundFileMatrix.cp					2003, Charles Lechasseur
+// =================================================================================
+//
+// CWailSoundFileMatrix tells which of a bunch of sound files have the same content
+// for each class. each file is looked at only once, when added: we read its class
+// headers and hash every class (attributes and sounds) straight from the file. the
+// file isn't needed afterwards; only the class hashes are kept.
+//
+// then, for each class, files are put in groups: files in the same group have the
+// same hash for that class. groups are numbered from 1 in the order files were
+// added; 0 means the file doesn't have the class (or it's empty).
+//
+// since we only compare hashes, two different classes could in theory end up in
+// the same group. with two 32-bit hashes, it's not something we worry about.
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include "CWailSoundFileMatrix.h"
+
+#include "CWailProgressDialog.h"
+#include "CWailSoundFileDiff.h"
+
+
+// ---------------------------------------------------------------------------------
+//		 CWailSoundFileMatrix			Constructor
+// ---------------------------------------------------------------------------------
+
+CWailSoundFileMatrix::CWailSoundFileMatrix()
+{
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ~CWailSoundFileMatrix			Destructor
+// ---------------------------------------------------------------------------------
+
+CWailSoundFileMatrix::~CWailSoundFileMatrix()
+{
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 AddFile
+// ---------------------------------------------------------------------------------
+// hashes all classes of the given sound file and adds it to the matrix. the stream
+// isn't kept.
+
+void
+CWailSoundFileMatrix::AddFile(
+	LStream&	inFile )
+{
+	SSoundFileTables theTables;
+	CWailSoundFileData::ReadFileTables( inFile, theTables );
+	
+	// create a progress dialog.
+	CWailProgressDialog theProgressDialog( theTables.mNumClasses,
+										   progressString_ComparingSoundData,
+										   nil );
+	
+	SInt32 theStart = mHashes.GetCount() + 1;
+	mHashes.AdjustAllocation( theTables.mNumClasses );
+	for (SInt32 i = 1; i <= theTables.mNumClasses; i++)
+	{
+		SClassHash theHash;
+		HashClass( inFile, theTables.m8bitClasses[i], theTables.m16bitClasses[i], theHash );
+		mHashes.AddItem( theHash );
+	
+		// increment progress dialog.
+		theProgressDialog.Increment();
+	}
+	
+	mFileStarts.AddItem( theStart );
+	mFileClasses.AddItem( theTables.mNumClasses );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CountClasses
+// ---------------------------------------------------------------------------------
+// returns the number of classes of the file that has the most.
+
+SInt32
+CWailSoundFileMatrix::CountClasses() const
+{
+	SInt32 theCount = 0;
+	
+	SInt32 numFiles = mFileClasses.GetCount();
+	for (SInt32 i = 1; i <= numFiles; i++)
+	{
+		if (mFileClasses[i] > theCount)
+			theCount = mFileClasses[i];
+	}
+	
+	return theCount;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 GetGroup
+// ---------------------------------------------------------------------------------
+// returns the group of the given file for the given class (both 1-based), or 0 if
+// the file doesn't have the class. a file is in the same group as the first file
+// with the same class; otherwise it starts a new group.
+
+SInt32
+CWailSoundFileMatrix::GetGroup(
+	SInt32	inClassIndex,
+	SInt32	inFileIndex ) const
+{
+	const SClassHash* theHash = GetClassHash( inClassIndex, inFileIndex );
+	if (theHash == nil)
+		return 0;
+	
+	// walk files up to ours, numbering groups as they start. the first file with our
+	// hash starts our group.
+	SInt32 theNumGroups = 0;
+	for (SInt32 i = 1; i <= inFileIndex; i++)
+	{
+		const SClassHash* theOtherHash = GetClassHash( inClassIndex, i );
+		if (theOtherHash == nil)
+			continue;
+		
+		Boolean isNewGroup = true;
+		for (SInt32 j = 1; isNewGroup && (j < i); j++)
+		{
+			const SClassHash* thePreviousHash = GetClassHash( inClassIndex, j );
+			if ((thePreviousHash != nil) &&
+				CWailSoundClass::AreHashesSame( thePreviousHash->mHash, theOtherHash->mHash ))
+			{
+				isNewGroup = false;
+			}
+		}
+		
+		if (isNewGroup)
+		{
+			theNumGroups++;
+			if (CWailSoundClass::AreHashesSame( theOtherHash->mHash, theHash->mHash ))
+				return theNumGroups;
+		}
+	}
+	
+	// can't get here: at worst, our file starts a new group.
+	SignalStringLiteral_( "Programmer error: no group found" );
+	return theNumGroups;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CountDifferentClasses
+// ---------------------------------------------------------------------------------
+// returns the number of classes that are not the same in all files.
+
+SInt32
+CWailSoundFileMatrix::CountDifferentClasses() const
+{
+	SInt32 theCount = 0;
+	SInt32 numClasses = CountClasses();
+	SInt32 numFiles = CountFiles();
+	
+	for (SInt32 i = 1; i <= numClasses; i++)
+	{
+		SInt32 theFirstGroup = GetGroup( i, 1 );
+		for (SInt32 j = 2; j <= numFiles; j++)
+		{
+			if (GetGroup( i, j ) != theFirstGroup)
+			{
+				theCount++;
+				break;
+			}
+		}
+	}
+	
+	return theCount;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 WriteReport
+// ---------------------------------------------------------------------------------
+// writes one line per class that at least one file has. each line contains,
+// separated by tabs: the class index, then the group of each file for that class.
+
+void
+CWailSoundFileMatrix::WriteReport(
+	LStream&	inReport ) const
+{
+	SInt32 numClasses = CountClasses();
+	SInt32 numFiles = CountFiles();
+	
+	for (SInt32 i = 1; i <= numClasses; i++)
+	{
+		LStr255 theLine( i );
+		Boolean isUsed = false;
+	
+		for (SInt32 j = 1; j <= numFiles; j++)
+		{
+			SInt32 theGroup = GetGroup( i, j );
+			if (theGroup != 0)
+				isUsed = true;
+	
+			theLine += "\p\t";
+			theLine += theGroup;
+		}
+		theLine += "\p\r";
+	
+		if (isUsed)
+			inReport.WriteBlock( theLine.TextPtr(), theLine.Length() );
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 HashClass											[static]
+// ---------------------------------------------------------------------------------
+// hashes everything in a class: its attributes and all of its sounds. we let
+// CWailSoundClass figure out what the headers mean (without reading any sound),
+// so that classes are seen like the rest of Wail does.
+
+void
+CWailSoundFileMatrix::HashClass(
+	LStream&				inFile,
+	const SMthonSoundClass&	in8bitClass,
+	const SMthonSoundClass&	in16bitClass,
+	SClassHash&				outHash )
+{
+	CWailSoundClass theClass( in8bitClass, in16bitClass );
+	
+	CWailSoundStream::InitHash( outHash.mHash );
+	outHash.mEmpty = CWailSoundFileDiff::IsClassEmpty( theClass );
+	if (outHash.mEmpty)
+		return;
+	
+	// attributes. they're hashed one by one, since the class has other stuff in it.
+	CWailSoundStream::HashBytes( &theClass.mClassID, sizeof(theClass.mClassID), outHash.mHash );
+	CWailSoundStream::HashBytes( &theClass.mVolume, sizeof(theClass.mVolume), outHash.mHash );
+	CWailSoundStream::HashBytes( &theClass.mFlags, sizeof(theClass.mFlags), outHash.mHash );
+	CWailSoundStream::HashBytes( &theClass.mChance, sizeof(theClass.mChance), outHash.mHash );
+	CWailSoundStream::HashBytes( &theClass.mLowPitch, sizeof(theClass.mLowPitch), outHash.mHash );
+	CWailSoundStream::HashBytes( &theClass.mHighPitch, sizeof(theClass.mHighPitch), outHash.mHash );
+	CWailSoundStream::HashBytes( &theClass.mRemap8bit, sizeof(theClass.mRemap8bit), outHash.mHash );
+	
+	// sounds. remapped classes have no 16-bit sounds of their own.
+	HashSoundSet( inFile, theClass.mNum8bitSounds, in8bitClass, outHash.mHash );
+	HashSoundSet( inFile, theClass.mNum16bitSounds, in16bitClass, outHash.mHash );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 HashSoundSet										[static]
+// ---------------------------------------------------------------------------------
+// adds the number of sounds of a set and the hash of each sound to the given hash.
+// sounds are read straight from the file.
+
+void
+CWailSoundFileMatrix::HashSoundSet(
+	LStream&				inFile,
+	SInt16					inNumSounds,
+	const SMthonSoundClass&	inClass,
+	SSoundHash&				ioHash )
+{
+	CWailSoundStream::HashBytes( &inNumSounds, sizeof(inNumSounds), ioHash );
+	if (inNumSounds <= 0)
+		return;
+	
+	SInt32 theLengths[5];
+	CWailSoundClass::GetSoundLengths( inClass, theLengths );
+	
+	SInt32 theOffset = inClass.mFirstSoundOffset;
+	for (SInt16 j = 0; j < inNumSounds; j++)
+	{
+		CWailSoundStream theSound( &inFile, theOffset, theLengths[j] );
+		CWailSoundStream::HashBytes( &theSound.GetContentHash(), sizeof(SSoundHash), ioHash );
+	
+		theOffset += theLengths[j];
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 GetClassHash
+// ---------------------------------------------------------------------------------
+// returns the hash of a class of a file, or nil if the file doesn't have the class
+// or if it's empty.
+
+const CWailSoundFileMatrix::SClassHash*
+CWailSoundFileMatrix::GetClassHash(
+	SInt32	inClassIndex,
+	SInt32	inFileIndex ) const
+{
+	if (inClassIndex > mFileClasses[inFileIndex])
+		return nil;
+	
+	const SClassHash& theHash = mHashes[mFileStarts[inFileIndex] + inClassIndex - 1];
+	return (theHash.mEmpty ? nil : &theHash);
+}
@@ -0,0 +1,92 @@
+// =================================================================================
+//	CWailSoundFileMatrix.h					2003, Charles Lechasseur
+// =================================================================================
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <TArray.h>
+
+#include "CWailSoundFileData.h"
+#include "CWailSoundStream.h"
+
+
+// CWailSoundFileMatrix class
+
+class CWailSoundFileMatrix
+{
+	public:
+	
+							CWailSoundFileMatrix();
+		virtual				~CWailSoundFileMatrix();
+	
+		void				AddFile(
+								LStream&			inFile );
+	
+		SInt32				CountFiles() const { return mFileStarts.GetCount(); }
+		SInt32				CountClasses() const;
+		SInt32				GetGroup(
+								SInt32				inClassIndex,
+								SInt32				inFileIndex ) const;
+		SInt32				CountDifferentClasses() const;
+	
+		void				WriteReport(
+								LStream&			inReport ) const;
+	
+	protected:
+	
+		struct SClassHash
+		{
+			SSoundHash		mHash;		// hash of the whole class, if not mEmpty.
+			Boolean			mEmpty;
+		};
+	
+		static void			HashClass(
+								LStream&				inFile,
+								const SMthonSoundClass&	in8bitClass,
+								const SMthonSoundClass&	in16bitClass,
+								SClassHash&				outHash );
+		static void			HashSoundSet(
+								LStream&				inFile,
+								SInt16					inNumSounds,
+								const SMthonSoundClass&	inClass,
+								SSoundHash&				ioHash );
+	
+		const SClassHash*	GetClassHash(
+								SInt32				inClassIndex,
+								SInt32				inFileIndex ) const;
+	
+		TArray<SClassHash>	mHashes;		// hashes of all classes of all files.
+		TArray<SInt32>		mFileStarts;	// index of each file's first hash.
+		TArray<SInt32>		mFileClasses;	// number of classes in each file.
+	
+	private:
+		// Defensive programming. No copy constructor or operator=
+							CWailSoundFileMatrix( const CWailSoundFileMatrix& );
+		CWailSoundFileMatrix&	operator=( const CWailSoundFileMatrix& );
+};
@@ -0,0 +1,385 @@
+// =================================================================================
+//	CWailSoundFileMerge.cp					2003, Charles Lechasseur
+// =================================================================================
+//
+// CWailSoundFileMerge merges the changes made to the same sound file (the base) in
+// two different copies (ours and theirs). for each class, attributes are merged as
+// a whole and sounds are merged one slot at a time: if only one side changed
+// something compared to the base, that side wins; if both made the same change,
+// it's kept. if both changed the same thing differently, that's a conflict: ours
+// wins, and the conflict is noted so that someone can look at it.
+//
+// merged sounds are views of the sounds of the three datas, so nothing is copied
+// until the merged data is saved. for that to work with big files, the datas should
+// be loaded with loadMethod_ViewFile (and lazily); they must stay alive as long as
+// the merged data is.
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include "CWailSoundFileMerge.h"
+
+#include "CWailProgressDialog.h"
+#include "CWailSoundStream.h"
+
+
+// ---------------------------------------------------------------------------------
+//		 CWailSoundFileMerge			Constructor
+// ---------------------------------------------------------------------------------
+
+CWailSoundFileMerge::CWailSoundFileMerge(
+	CWailSoundFileData&	inBase,
+	CWailSoundFileData&	inOurs,
+	CWailSoundFileData&	inTheirs )
+	: mBase( inBase ),
+	  mOurs( inOurs ),
+	  mTheirs( inTheirs )
+{
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ~CWailSoundFileMerge			Destructor
+// ---------------------------------------------------------------------------------
+
+CWailSoundFileMerge::~CWailSoundFileMerge()
+{
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Merge
+// ---------------------------------------------------------------------------------
+// merges all classes and returns the merged data. the caller owns it. conflicts
+// found along the way can be obtained with GetConflicts afterwards.
+
+CWailSoundFileData*
+CWailSoundFileMerge::Merge()
+{
+	mConflicts.RemoveItemsAt( mConflicts.GetCount(), LArray::index_First );
+	
+	SInt32 numClasses = mBase.mSoundClasses.GetCount();
+	if (mOurs.mSoundClasses.GetCount() > numClasses)
+		numClasses = mOurs.mSoundClasses.GetCount();
+	if (mTheirs.mSoundClasses.GetCount() > numClasses)
+		numClasses = mTheirs.mSoundClasses.GetCount();
+	
+	StDeleter<CWailSoundFileData> theMergedData( new CWailSoundFileData() );
+	theMergedData->mDemoLayout = mOurs.mDemoLayout;
+	theMergedData->mSoundClasses.AdjustAllocation( numClasses );
+	
+	// create a progress dialog.
+	CWailProgressDialog theProgressDialog( numClasses,
+										   progressString_ComparingSoundData,
+										   nil );
+	
+	for (SInt32 i = 1; i <= numClasses; i++)
+	{
+		theMergedData->mSoundClasses.AddItem( MergeClass( i ) );
+	
+		// increment progress dialog.
+		theProgressDialog.Increment();
+	}
+	
+	return theMergedData.Release();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 WriteReport
+// ---------------------------------------------------------------------------------
+// writes one line per conflict in the given stream. each line contains, separated
+// by tabs: the class index, the kind of conflict and the sound index (1-based, empty
+// if the conflict isn't about a single sound).
+
+void
+CWailSoundFileMerge::WriteReport(
+	LStream&	inReport ) const
+{
+	SInt32 numConflicts = mConflicts.GetCount();
+	for (SInt32 i = 1; i <= numConflicts; i++)
+	{
+		const SMergeConflict& theConflict = mConflicts[i];
+	
+		LStr255 theLine( theConflict.mClassIndex );
+		theLine += "\p\t";
+		theLine += GetConflictName( theConflict.mKind );
+		theLine += "\p\t";
+		if (theConflict.mSoundIndex >= 0)
+			theLine += (SInt32) (theConflict.mSoundIndex + 1);
+		theLine += "\p\r";
+	
+		inReport.WriteBlock( theLine.TextPtr(), theLine.Length() );
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MergeClass
+// ---------------------------------------------------------------------------------
+// merges the class at the given index and returns a new class. a class that's not
+// in a data is the same as an empty class.
+
+CWailSoundClass*
+CWailSoundFileMerge::MergeClass(
+	SInt32	inClassIndex )
+{
+	CWailSoundClass theEmptyClass;
+	const CWailSoundClass* theBase = &theEmptyClass;
+	const CWailSoundClass* theOurs = &theEmptyClass;
+	const CWailSoundClass* theTheirs = &theEmptyClass;
+	if (inClassIndex <= mBase.mSoundClasses.GetCount())
+		theBase = mBase.GetSoundClass( inClassIndex );
+	if (inClassIndex <= mOurs.mSoundClasses.GetCount())
+		theOurs = mOurs.GetSoundClass( inClassIndex );
+	if (inClassIndex <= mTheirs.mSoundClasses.GetCount())
+		theTheirs = mTheirs.GetSoundClass( inClassIndex );
+	
+	StDeleter<CWailSoundClass> theClass( new CWailSoundClass() );
+	
+	MergeAttributes( inClassIndex, *theBase, *theOurs, *theTheirs, *theClass );
+	
+	MergeSoundSet( inClassIndex, true,
+				   theBase->mNum8bitSounds, theBase->m8bitSounds,
+				   theOurs->mNum8bitSounds, theOurs->m8bitSounds,
+				   theTheirs->mNum8bitSounds, theTheirs->m8bitSounds,
+				   theClass->mNum8bitSounds, theClass->m8bitSounds );
+	
+	// 16-bit sounds go with remapping, since remapped classes have none. if only one
+	// side changed remapping, it gets its 16-bit sounds too.
+	Boolean ourRemapChanged = (theOurs->mRemap8bit != theBase->mRemap8bit);
+	Boolean theirRemapChanged = (theTheirs->mRemap8bit != theBase->mRemap8bit);
+	if (ourRemapChanged == theirRemapChanged)
+	{
+		// nobody changed it, or both did the same way.
+		theClass->mRemap8bit = theOurs->mRemap8bit;
+		MergeSoundSet( inClassIndex, false,
+					   theBase->mNum16bitSounds, theBase->m16bitSounds,
+					   theOurs->mNum16bitSounds, theOurs->m16bitSounds,
+					   theTheirs->mNum16bitSounds, theTheirs->m16bitSounds,
+					   theClass->mNum16bitSounds, theClass->m16bitSounds );
+	}
+	else
+	{
+		const CWailSoundClass* theWinner = ourRemapChanged ? theOurs : theTheirs;
+		const CWailSoundClass* theLoser = ourRemapChanged ? theTheirs : theOurs;
+	
+		// if the other side changed its 16-bit sounds, we're losing that.
+		Boolean isLoserChanged = (theLoser->mNum16bitSounds != theBase->mNum16bitSounds);
+		for (SInt16 j = 0; !isLoserChanged && (j < theBase->mNum16bitSounds); j++)
+			isLoserChanged = !AreSlotsSame( theLoser->m16bitSounds[j], theBase->m16bitSounds[j] );
+		if (isLoserChanged)
+			AddConflict( inClassIndex, mergeConflict_Remap8bit, -1 );
+	
+		theClass->mRemap8bit = theWinner->mRemap8bit;
+		theClass->mNum16bitSounds = theWinner->mNum16bitSounds;
+		for (SInt16 k = 0; k < theWinner->mNum16bitSounds; k++)
+			theClass->m16bitSounds[k] = MakeSoundView( theWinner->m16bitSounds[k] );
+	}
+	
+	return theClass.Release();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MergeAttributes
+// ---------------------------------------------------------------------------------
+// merges everything but sounds. attributes are taken as a whole from one side.
+
+void
+CWailSoundFileMerge::MergeAttributes(
+	SInt32					inClassIndex,
+	const CWailSoundClass&	inBase,
+	const CWailSoundClass&	inOurs,
+	const CWailSoundClass&	inTheirs,
+	CWailSoundClass&		outClass )
+{
+	const CWailSoundClass* theWinner = &inOurs;
+	if (inOurs.AreAttributesSame( inBase ))
+		theWinner = &inTheirs;		// only theirs might have changed.
+	else if (!inTheirs.AreAttributesSame( inBase ) &&
+			 !inTheirs.AreAttributesSame( inOurs ))
+		AddConflict( inClassIndex, mergeConflict_Attributes, -1 );
+	
+	outClass.mClassID = theWinner->mClassID;
+	outClass.mVolume = theWinner->mVolume;
+	outClass.mFlags = theWinner->mFlags;
+	outClass.mChance = theWinner->mChance;
+	outClass.mLowPitch = theWinner->mLowPitch;
+	outClass.mHighPitch = theWinner->mHighPitch;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MergeSoundSet
+// ---------------------------------------------------------------------------------
+// merges a set of sounds one slot at a time. sounds of a set can't have holes, so
+// if merging slots would leave one (for example if one side removed the last sound
+// and the other added one after it), we take our whole set instead.
+
+void
+CWailSoundFileMerge::MergeSoundSet(
+	SInt32			inClassIndex,
+	Boolean			in8bit,
+	SInt16			inNumBase,
+	LStream* const	inBase[5],
+	SInt16			inNumOurs,
+	LStream* const	inOurs[5],
+	SInt16			inNumTheirs,
+	LStream* const	inTheirs[5],
+	SInt16&			outNumSounds,
+	LStream*		outSounds[5] )
+{
+	SInt16 theNumSlots = inNumBase;
+	if (inNumOurs > theNumSlots)
+		theNumSlots = inNumOurs;
+	if (inNumTheirs > theNumSlots)
+		theNumSlots = inNumTheirs;
+	
+	// pick a sound for each slot. nil means there's no sound.
+	LStream* thePicks[5];
+	SInt32 theNumConflicts = mConflicts.GetCount();
+	SInt16 j;
+	for (j = 0; j < theNumSlots; j++)
+	{
+		LStream* theBase = (j < inNumBase) ? inBase[j] : nil;
+		LStream* theOurs = (j < inNumOurs) ? inOurs[j] : nil;
+		LStream* theTheirs = (j < inNumTheirs) ? inTheirs[j] : nil;
+	
+		thePicks[j] = theOurs;
+		if (AreSlotsSame( theOurs, theBase ))
+			thePicks[j] = theTheirs;		// only theirs might have changed.
+		else if (!AreSlotsSame( theTheirs, theBase ) &&
+				 !AreSlotsSame( theTheirs, theOurs ))
+			AddConflict( inClassIndex,
+						 in8bit ? mergeConflict_8bitSound : mergeConflict_16bitSound,
+						 j );
+	}
+	
+	// make sure there's no hole.
+	SInt16 theNumSounds = 0;
+	Boolean hasHole = false;
+	for (j = 0; j < theNumSlots; j++)
+	{
+		if (thePicks[j] == nil)
+			continue;
+	
+		hasHole = hasHole || (theNumSounds != j);
+		theNumSounds = j + 1;
+	}
+	if (hasHole)
+	{
+		// forget about conflicts on single sounds, the whole set is in conflict.
+		if (mConflicts.GetCount() > theNumConflicts)
+			mConflicts.RemoveItemsAt( mConflicts.GetCount() - theNumConflicts,
+									  theNumConflicts + 1 );
+		AddConflict( inClassIndex, in8bit ? mergeConflict_8bitSet : mergeConflict_16bitSet, -1 );
+	
+		theNumSounds = inNumOurs;
+		for (j = 0; j < inNumOurs; j++)
+			thePicks[j] = inOurs[j];
+	}
+	
+	outNumSounds = theNumSounds;
+	for (j = 0; j < theNumSounds; j++)
+		outSounds[j] = MakeSoundView( thePicks[j] );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 AddConflict
+// ---------------------------------------------------------------------------------
+
+void
+CWailSoundFileMerge::AddConflict(
+	SInt32	inClassIndex,
+	SInt16	inKind,
+	SInt16	inSoundIndex )
+{
+	SMergeConflict theConflict;
+	theConflict.mClassIndex = inClassIndex;
+	theConflict.mKind = inKind;
+	theConflict.mSoundIndex = inSoundIndex;
+	
+	mConflicts.AddItem( theConflict );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 AreSlotsSame										[static]
+// ---------------------------------------------------------------------------------
+// returns true if two sound slots contain the same thing. a slot without a sound
+// is only the same as another slot without a sound.
+
+Boolean
+CWailSoundFileMerge::AreSlotsSame(
+	LStream*	inSound1,
+	LStream*	inSound2 )
+{
+	if ((inSound1 == nil) || (inSound2 == nil))
+		return (inSound1 == inSound2);
+	
+	return CWailSoundClass::AreSoundsSame( inSound1, inSound2 );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MakeSoundView										[static]
+// ---------------------------------------------------------------------------------
+// returns a new sound that's a view of the whole given sound, so that merged
+// classes don't copy anything.
+
+LStream*
+CWailSoundFileMerge::MakeSoundView(
+	LStream*	inSound )
+{
+	return new CWailSoundStream( inSound, 0, inSound->GetLength() );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 GetConflictName									[static]
+// ---------------------------------------------------------------------------------
+// returns the name of a kind of conflict, as written in reports.
+
+ConstStringPtr
+CWailSoundFileMerge::GetConflictName(
+	SInt16	inKind )
+{
+	switch (inKind)
+	{
+		case mergeConflict_Attributes:		return "\pattributes";
+		case mergeConflict_8bitSound:		return "\p8bitsound";
+		case mergeConflict_16bitSound:		return "\p16bitsound";
+		case mergeConflict_8bitSet:			return "\p8bitset";
+		case mergeConflict_16bitSet:		return "\p16bitset";
+		case mergeConflict_Remap8bit:		return "\premap";
+	
+		default:	// programmer error or corruption?
+			SignalStringLiteral_( "Invalid merge conflict kind" );
+			return "\p?";
+	}
+}
@@ -0,0 +1,119 @@
+// =================================================================================
+//	CWailSoundFileMerge.h					2003, Charles Lechasseur
+// =================================================================================
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <TArray.h>
+
+#include "CWailSoundFileData.h"
+
+
+// kinds of conflicts found by CWailSoundFileMerge:
+
+const SInt16	mergeConflict_Attributes		= 1;	// both sides changed attributes.
+const SInt16	mergeConflict_8bitSound			= 2;	// both sides changed a sound.
+const SInt16	mergeConflict_16bitSound		= 3;
+const SInt16	mergeConflict_8bitSet			= 4;	// merging sounds one by one would
+const SInt16	mergeConflict_16bitSet			= 5;	// leave a hole in the set.
+const SInt16	mergeConflict_Remap8bit			= 6;	// remapping changed on one side,
+														// 16-bit sounds on the other.
+
+struct SMergeConflict
+{
+	SInt32		mClassIndex;	// 1-based index of the class.
+	SInt16		mKind;			// see mergeConflict_ constants above.
+	SInt16		mSoundIndex;	// 0-based index of the sound, or -1.
+};
+
+
+// CWailSoundFileMerge class
+
+class CWailSoundFileMerge
+{
+	public:
+	
+							CWailSoundFileMerge(
+								CWailSoundFileData&	inBase,
+								CWailSoundFileData&	inOurs,
+								CWailSoundFileData&	inTheirs );
+		virtual				~CWailSoundFileMerge();
+	
+		CWailSoundFileData*	Merge();
+	
+		SInt32				CountConflicts() const { return mConflicts.GetCount(); }
+		const TArray<SMergeConflict>&	GetConflicts() const { return mConflicts; }
+	
+		void				WriteReport(
+								LStream&			inReport ) const;
+	
+	protected:
+	
+		CWailSoundClass*	MergeClass(
+								SInt32				inClassIndex );
+		void				MergeAttributes(
+								SInt32				inClassIndex,
+								const CWailSoundClass& inBase,
+								const CWailSoundClass& inOurs,
+								const CWailSoundClass& inTheirs,
+								CWailSoundClass&	outClass );
+		void				MergeSoundSet(
+								SInt32				inClassIndex,
+								Boolean				in8bit,
+								SInt16				inNumBase,
+								LStream* const		inBase[5],
+								SInt16				inNumOurs,
+								LStream* const		inOurs[5],
+								SInt16				inNumTheirs,
+								LStream* const		inTheirs[5],
+								SInt16&				outNumSounds,
+								LStream*			outSounds[5] );
+		void				AddConflict(
+								SInt32				inClassIndex,
+								SInt16				inKind,
+								SInt16				inSoundIndex );
+	
+		static Boolean		AreSlotsSame(
+								LStream*			inSound1,
+								LStream*			inSound2 );
+		static LStream*		MakeSoundView(
+								LStream*			inSound );
+		static ConstStringPtr GetConflictName(
+								SInt16				inKind );
+	
+		CWailSoundFileData&			mBase;
+		CWailSoundFileData&			mOurs;
+		CWailSoundFileData&			mTheirs;
+		TArray<SMergeConflict>		mConflicts;
+	
+	private:
+		// Defensive programming. No copy constructor or operator=
+							CWailSoundFileMerge( const CWailSoundFileMerge& );
+		CWailSoundFileMerge&	operator=( const CWailSoundFileMerge& );
+};
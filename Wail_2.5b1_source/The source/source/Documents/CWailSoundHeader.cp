@@ -0,0 +1,320 @@
+// =================================================================================
+//	CWailSoundHeader.cp					2003, Charles Lechasseur
+// =================================================================================
+//
+// CWailSoundHeader reads the sampled sound header at the start of a Marathon sound,
+// without going through the Sound Manager: Marathon sounds are a standard or an
+// extended sound header followed by the samples, which is all we need to know the
+// format of a sound and where its samples are.
+//
+// headers are read byte by byte, big-endian, so they can be anywhere in memory.
+// compressed sound headers aren't supported; Marathon doesn't use them.
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include "CWailSoundHeader.h"
+
+#include <Sound.h>
+
+#include "CWailSoundStream.h"
+
+
+// sound header encodings, and where their samples start.
+
+const UInt8		soundHeader_Standard			= 0x00;
+const UInt8		soundHeader_Extended			= 0xFF;
+
+const SInt32	soundHeader_StandardLength		= 22;
+const SInt32	soundHeader_ExtendedLength		= soundHeader_MaxLength;
+
+
+// ---------------------------------------------------------------------------------
+//		 Read16
+// ---------------------------------------------------------------------------------
+
+static inline UInt16
+Read16(
+	const UInt8*	inData )
+{
+	return (UInt16) ((((UInt16) inData[0]) << 8) | inData[1]);
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Read32
+// ---------------------------------------------------------------------------------
+
+static inline UInt32
+Read32(
+	const UInt8*	inData )
+{
+	return (((UInt32) inData[0]) << 24) | (((UInt32) inData[1]) << 16) |
+		   (((UInt32) inData[2]) << 8) | ((UInt32) inData[3]);
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Write16
+// ---------------------------------------------------------------------------------
+
+static inline void
+Write16(
+	UInt8*	outData,
+	UInt16	inValue )
+{
+	outData[0] = (UInt8) (inValue >> 8);
+	outData[1] = (UInt8) inValue;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Write32
+// ---------------------------------------------------------------------------------
+
+static inline void
+Write32(
+	UInt8*	outData,
+	UInt32	inValue )
+{
+	outData[0] = (UInt8) (inValue >> 24);
+	outData[1] = (UInt8) (inValue >> 16);
+	outData[2] = (UInt8) (inValue >> 8);
+	outData[3] = (UInt8) inValue;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CWailSoundHeader				Constructor
+// ---------------------------------------------------------------------------------
+
+CWailSoundHeader::CWailSoundHeader()
+	: mExtended( false ),
+	  mSampleRate( 0 ),
+	  mBaseFrequency( 0 ),
+	  mLoopStart( 0 ),
+	  mLoopEnd( 0 ),
+	  mNumChannels( 0 ),
+	  mNumFrames( 0 ),
+	  mSampleSize( 0 ),
+	  mDataOffset( 0 ),
+	  mSamples( nil )
+{
+	for (SInt32 i = 0; i < (SInt32) sizeof(mAIFFSampleRate); i++)
+		mAIFFSampleRate[i] = 0;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ~CWailSoundHeader				Destructor
+// ---------------------------------------------------------------------------------
+
+CWailSoundHeader::~CWailSoundHeader()
+{
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Parse
+// ---------------------------------------------------------------------------------
+// reads the header of a sound in memory. returns false if it's not a sound we
+// understand. the samples are pointed to, not copied: they're only valid as long as
+// the given sound is.
+
+Boolean
+CWailSoundHeader::Parse(
+	const void*	inSound,
+	SInt32		inLength )
+{
+	mSamples = nil;
+	if (!ParseHeader( (const UInt8*) inSound, inLength, inLength ))
+		return false;
+	
+	mSamples = ((const char*) inSound) + mDataOffset;
+	return true;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Parse
+// ---------------------------------------------------------------------------------
+// reads the header of a sound in a stream. if the stream is a sound stream that can
+// give us its buffer, the samples are pointed to; otherwise GetSamples returns nil,
+// and they're read from the stream at GetDataOffset. the marker is left where it was.
+
+Boolean
+CWailSoundHeader::Parse(
+	LStream&	inSound )
+{
+	CWailSoundStream* theSoundStream = dynamic_cast<CWailSoundStream*>(&inSound);
+	if ((theSoundStream != nil) && theSoundStream->CanGetBuffer())
+		return Parse( theSoundStream->GetBuffer(), theSoundStream->GetLength() );
+	
+	UInt8 theHeader[soundHeader_ExtendedLength];
+	SInt32 theLength = inSound.GetLength();
+	SInt32 theHeaderLength = (theLength < soundHeader_ExtendedLength) ? theLength
+																	   : soundHeader_ExtendedLength;
+	
+	SInt32 theMarker = inSound.GetMarker();
+	inSound.SetMarker( 0, streamFrom_Start );
+	inSound.ReadBlock( theHeader, theHeaderLength );
+	inSound.SetMarker( theMarker, streamFrom_Start );
+	
+	mSamples = nil;
+	return ParseHeader( theHeader, theHeaderLength, theLength );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 GetFormat
+// ---------------------------------------------------------------------------------
+// returns the format of the samples, like the Sound Manager gives it: 8-bit samples
+// are offset binary, 16-bit samples are two's complement.
+
+OSType
+CWailSoundHeader::GetFormat() const
+{
+	return (mSampleSize == 8) ? kOffsetBinary : kTwosComplement;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 GetDataLength
+// ---------------------------------------------------------------------------------
+// returns the length of the samples, in bytes.
+
+SInt32
+CWailSoundHeader::GetDataLength() const
+{
+	return mNumFrames * mNumChannels * (mSampleSize / 8);
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Write
+// ---------------------------------------------------------------------------------
+// writes a header for the same sound with samples of the given size (8 or 16 bits).
+// mono 8-bit sounds get a standard header, others an extended one. outHeader must
+// have room for soundHeader_MaxLength bytes. returns the length of the header; the
+// samples go right after it.
+
+SInt32
+CWailSoundHeader::Write(
+	void*	outHeader,
+	SInt16	inSampleSize ) const
+{
+	UInt8* theHeader = (UInt8*) outHeader;
+	Boolean isExtended = ((mNumChannels != 1) || (inSampleSize != 8));
+	
+	Write32( theHeader, 0 );	// samplePtr: the samples follow.
+	Write32( theHeader + 4, isExtended ? (UInt32) mNumChannels : (UInt32) mNumFrames );
+	Write32( theHeader + 8, mSampleRate );
+	Write32( theHeader + 12, (UInt32) mLoopStart );
+	Write32( theHeader + 16, (UInt32) mLoopEnd );
+	theHeader[20] = isExtended ? soundHeader_Extended : soundHeader_Standard;
+	theHeader[21] = mBaseFrequency;
+	
+	if (!isExtended)
+		return soundHeader_StandardLength;
+	
+	// everything we don't know about is 0.
+	for (SInt32 i = 22; i < soundHeader_ExtendedLength; i++)
+		theHeader[i] = 0;
+	Write32( theHeader + 22, (UInt32) mNumFrames );
+	::BlockMoveData( mAIFFSampleRate, theHeader + 26, sizeof(mAIFFSampleRate) );
+	Write16( theHeader + 48, (UInt16) inSampleSize );
+	
+	return soundHeader_ExtendedLength;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ParseHeader
+// ---------------------------------------------------------------------------------
+// reads a sound header. inHeaderLength bytes of the sound are given; the whole
+// sound is inSoundLength bytes long. returns false if the header can't be read or
+// if its samples don't fit in the sound.
+
+Boolean
+CWailSoundHeader::ParseHeader(
+	const UInt8*	inHeader,
+	SInt32			inHeaderLength,
+	SInt32			inSoundLength )
+{
+	if (inHeaderLength < soundHeader_StandardLength)
+		return false;
+	
+	// both kinds of headers start the same way. the second field is the length in
+	// standard headers, and the number of channels in extended ones.
+	mSampleRate = Read32( inHeader + 8 );
+	mLoopStart = (SInt32) Read32( inHeader + 12 );
+	mLoopEnd = (SInt32) Read32( inHeader + 16 );
+	mBaseFrequency = inHeader[21];
+	
+	switch (inHeader[20])
+	{
+		case soundHeader_Standard:
+			mExtended = false;
+			for (SInt32 i = 0; i < (SInt32) sizeof(mAIFFSampleRate); i++)
+				mAIFFSampleRate[i] = 0;
+			mNumChannels = 1;
+			mNumFrames = (SInt32) Read32( inHeader + 4 );
+			mSampleSize = 8;
+			mDataOffset = soundHeader_StandardLength;
+			break;
+	
+		case soundHeader_Extended:
+			if (inHeaderLength < soundHeader_ExtendedLength)
+				return false;
+	
+			mExtended = true;
+			::BlockMoveData( inHeader + 26, mAIFFSampleRate, sizeof(mAIFFSampleRate) );
+			mNumChannels = (SInt32) Read32( inHeader + 4 );
+			mNumFrames = (SInt32) Read32( inHeader + 22 );
+			mSampleSize = (SInt16) Read16( inHeader + 48 );
+			mDataOffset = soundHeader_ExtendedLength;
+			break;
+	
+		default:
+			// compressed or unknown.
+			return false;
+	}
+	
+	if (((mNumChannels != 1) && (mNumChannels != 2)) ||
+		((mSampleSize != 8) && (mSampleSize != 16)) ||
+		(mNumFrames < 0))
+	{
+		return false;
+	}
+	
+	// the samples must be in the sound. we divide instead of multiplying, so that a
+	// huge number of frames can't overflow.
+	SInt32 theFrameSize = mNumChannels * (mSampleSize / 8);
+	if (mNumFrames > ((inSoundLength - mDataOffset) / theFrameSize))
+		return false;
+	
+	return true;
+}
@@ -0,0 +1,97 @@
+// =================================================================================
+//	CWailSoundHeader.h					2003, Charles Lechasseur
+// =================================================================================
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <LStream.h>
+
+
+// longest header Write can write.
+
+const SInt32	soundHeader_MaxLength			= 64;
+
+
+// CWailSoundHeader class
+
+class CWailSoundHeader
+{
+	public:
+		
+							CWailSoundHeader();
+		virtual				~CWailSoundHeader();
+		
+		Boolean				Parse(
+								const void*			inSound,
+								SInt32				inLength );
+		Boolean				Parse(
+								LStream&			inSound );
+		
+		Boolean				IsExtended() const { return mExtended; }
+		UInt32				GetSampleRate() const { return mSampleRate; }	// UnsignedFixed.
+		UInt8				GetBaseFrequency() const { return mBaseFrequency; }
+		SInt32				GetLoopStart() const { return mLoopStart; }
+		SInt32				GetLoopEnd() const { return mLoopEnd; }
+		SInt32				GetNumChannels() const { return mNumChannels; }
+		SInt32				GetNumFrames() const { return mNumFrames; }
+		SInt16				GetSampleSize() const { return mSampleSize; }	// in bits.
+		OSType				GetFormat() const;
+		
+		SInt32				GetDataOffset() const { return mDataOffset; }
+		SInt32				GetDataLength() const;
+		const void*			GetSamples() const { return mSamples; }
+		
+		SInt32				Write(
+								void*				outHeader,
+								SInt16				inSampleSize ) const;
+		
+	protected:
+		
+		Boolean				ParseHeader(
+								const UInt8*		inHeader,
+								SInt32				inHeaderLength,
+								SInt32				inSoundLength );
+		
+		Boolean				mExtended;
+		UInt32				mSampleRate;
+		UInt8				mBaseFrequency;
+		SInt32				mLoopStart;
+		SInt32				mLoopEnd;
+		SInt32				mNumChannels;
+		SInt32				mNumFrames;
+		SInt16				mSampleSize;
+		SInt32				mDataOffset;
+		const void*			mSamples;		// nil if they couldn't be pointed to.
+		UInt8				mAIFFSampleRate[10];	// extended80, from extended headers.
+		
+	private:
+		// Defensive programming. No copy constructor or operator=
+							CWailSoundHeader( const CWailSoundHeader& );
+		CWailSoundHeader&	operator=( const CWailSoundHeader& );
+};
@@ -38,8 +38,11 @@
 
 #include "CWailSoundStream.h"
 
+#include <UMemoryMgr.h>
+
 #include "CVirtualStream.h"
 #include "CStreamView.h"
+#include "CMappedFileStream.h"
 
 
 // ---------------------------------------------------------------------------
@@ -50,7 +53,9 @@
 
 CWailSoundStream::CWailSoundStream(
 	Handle	inHandle )
-	: mStream( NULL )
+	: mStream( NULL ),
+	  mMappedData( NULL ),
+	  mHashValid( false )
 {
 	try
 	{
@@ -79,6 +84,28 @@ CWailSoundStream::CWailSoundStream(
 }
 
 
+// ---------------------------------------------------------------------------
+//	 CWailSoundStream							Constructor	with buffer
+// ---------------------------------------------------------------------------
+//	works like the constructor with a handle, but simply copies the data from
+//	the given buffer. the buffer still belongs to the caller.
+
+CWailSoundStream::CWailSoundStream(
+	const void*	inData,
+	SInt32		inLength )
+	: mStream( NULL ),
+	  mMappedData( NULL ),
+	  mHashValid( false )
+{
+	// allocate a virtual stream
+	mStream = new CVirtualStream( inLength );
+	ThrowIfNil_( mStream );
+	
+	// store data from the buffer into our private stream.
+	WriteData( inData, inLength );
+}
+
+
 // ---------------------------------------------------------------------------
 //	 CWailSoundStream							Constructor	with stream view
 // ---------------------------------------------------------------------------
@@ -92,11 +119,42 @@ CWailSoundStream::CWailSoundStream(
 	LStream*			inStream,
 	SInt32				inStartOffset,
 	SInt32				inLength )
-	: mStream( new CStreamView( inStream, inStartOffset, inLength ) )
+	: mStream( new CStreamView( inStream, inStartOffset, inLength ) ),
+	  mMappedData( NULL ),
+	  mHashValid( false )
 {
 }
 
 
+// ---------------------------------------------------------------------------
+//	 CWailSoundStream							Constructor	with mapped file
+// ---------------------------------------------------------------------------
+//	creates a stream that points directly inside the data of a mapped file.
+//	no other stream is created, we simply keep our own marker and copy data
+//	straight from the mapping when reading.
+//
+//	we do not assume ownership of the provided mapped file, though it must remain
+//	alive while this object is.
+
+CWailSoundStream::CWailSoundStream(
+	const CMappedFileStream*	inMappedFile,
+	SInt32						inStartOffset,
+	SInt32						inLength )
+	: mStream( NULL ),
+	  mMappedData( NULL ),
+	  mHashValid( false )
+{
+	ThrowIfNil_( inMappedFile );
+	ThrowIf_( (inStartOffset < 0) || (inLength < 0) ||
+			  (inStartOffset + inLength > inMappedFile->GetLength()) );
+
+	mMappedData = (const char*) inMappedFile->GetBufferAt( inStartOffset );
+	
+	// we use LStream's marker and length, since we have no hidden stream.
+	LStream::SetLength( inLength );
+}
+
+
 // ---------------------------------------------------------------------------
 //	 ~CWailSoundStream							Destructor	[public]
 // ---------------------------------------------------------------------------
@@ -127,7 +185,10 @@ CWailSoundStream::SetMarker(
 	SInt32		inOffset,
 	EStreamFrom	inFromWhere )
 {
-	mStream->SetMarker( inOffset, inFromWhere );
+	if (mStream != NULL)
+		mStream->SetMarker( inOffset, inFromWhere );
+	else
+		LStream::SetMarker( inOffset, inFromWhere );
 }
 
 
@@ -138,7 +199,10 @@ CWailSoundStream::SetMarker(
 SInt32
 CWailSoundStream::GetMarker() const
 {
-	return mStream->GetMarker();
+	if (mStream != NULL)
+		return mStream->GetMarker();
+	else
+		return LStream::GetMarker();
 }
 
 
@@ -151,8 +215,12 @@ CWailSoundStream::SetLength(
 	SInt32	inLength )
 {
 	SignalIf_( dynamic_cast<CStreamView*>(mStream) != nil );
+	SignalIf_( mMappedData != NULL );
 
-	mStream->SetLength( inLength );
+	mHashValid = false;
+	
+	if (mStream != NULL)
+		mStream->SetLength( inLength );
 }
 
 
@@ -163,7 +231,10 @@ CWailSoundStream::SetLength(
 SInt32
 CWailSoundStream::GetLength() const
 {
-	return mStream->GetLength();
+	if (mStream != NULL)
+		return mStream->GetLength();
+	else
+		return LStream::GetLength();
 }
 
 
@@ -177,8 +248,15 @@ CWailSoundStream::PutBytes(
 	SInt32&		ioByteCount )
 {
 	SignalIf_( dynamic_cast<CStreamView*>(mStream) != nil );
+	SignalIf_( mMappedData != NULL );
 
-	return mStream->PutBytes( inBuffer, ioByteCount );
+	mHashValid = false;
+	
+	if (mStream != NULL)
+		return mStream->PutBytes( inBuffer, ioByteCount );
+	
+	ioByteCount = 0;
+	return writErr;
 }
 
 
@@ -191,5 +269,360 @@ CWailSoundStream::GetBytes(
 	void*	outBuffer,
 	SInt32&	ioByteCount)
 {
-	return mStream->GetBytes( outBuffer, ioByteCount );
-}
\ No newline at end of file
+	if (mStream != NULL)
+		return mStream->GetBytes( outBuffer, ioByteCount );
+	
+	// we're mapped. copy data straight from the mapping.
+	ExceptionCode err = noErr;
+	SInt32 theMarker = LStream::GetMarker();
+	SInt32 theLength = LStream::GetLength();
+	
+	// make sure we don't read past the end of our sound.
+	if (theMarker + ioByteCount > theLength)
+	{
+		ioByteCount = theLength - theMarker;
+		err = readErr;
+	}
+	
+	if (ioByteCount > 0)
+	{
+		::BlockMoveData( mMappedData + theMarker, outBuffer, ioByteCount );
+		LStream::SetMarker( ioByteCount, streamFrom_Marker );
+	}
+	
+	return err;
+}
+
+
+#pragma mark --- Direct access ---
+
+
+// ---------------------------------------------------------------------------
+//		 CanGetBuffer
+// ---------------------------------------------------------------------------
+// returns true if a pointer to our sound data can be obtained with GetBuffer.
+// this is always the case if we're mapped; otherwise we ask our hidden stream
+// if it's a virtual stream.
+
+Boolean
+CWailSoundStream::CanGetBuffer() const
+{
+	if (mMappedData != NULL)
+		return true;
+	
+	CVirtualStream* theVirtualStream = dynamic_cast<CVirtualStream*>(mStream);
+	return ((theVirtualStream != NULL) && theVirtualStream->CanGetBuffer());
+}
+
+
+// ---------------------------------------------------------------------------
+//		 GetBuffer
+// ---------------------------------------------------------------------------
+// returns a pointer to our sound data. the pointer is read-only and only valid
+// until the stream is modified or destroyed. call CanGetBuffer first.
+
+const void*
+CWailSoundStream::GetBuffer() const
+{
+	if (mMappedData != NULL)
+		return mMappedData;
+	
+	CVirtualStream* theVirtualStream = dynamic_cast<CVirtualStream*>(mStream);
+	ThrowIfNil_( theVirtualStream );
+	
+	return theVirtualStream->GetBuffer();
+}
+
+
+#pragma mark --- Content hash ---
+
+
+// ---------------------------------------------------------------------------
+//		 GetContentHash
+// ---------------------------------------------------------------------------
+// returns a hash of our sound data. it's computed the first time it's asked
+// for, then kept until the data changes. the marker is left where it was.
+
+const SSoundHash&
+CWailSoundStream::GetContentHash()
+{
+	if (!mHashValid)
+	{
+		if (CanGetBuffer())
+		{
+			InitHash( mContentHash );
+			HashBytes( GetBuffer(), GetLength(), mContentHash );
+		}
+		else
+		{
+			SInt32 theMarker = GetMarker();
+			HashStream( *this, mContentHash );
+			SetMarker( theMarker, streamFrom_Start );
+		}
+		
+		mHashValid = true;
+	}
+	
+	return mContentHash;
+}
+
+
+// ---------------------------------------------------------------------------
+//		 HashStream										[static]
+// ---------------------------------------------------------------------------
+// hashes the whole content of any stream, reading it one chunk at a time.
+// the marker is left at the end of the stream.
+
+void
+CWailSoundStream::HashStream(
+	LStream&		inStream,
+	SSoundHash&		outHash )
+{
+	const SInt32 kChunkSize = 32 * 1024;
+	
+	InitHash( outHash );
+	
+	SInt32 theLeft = inStream.GetLength();
+	if (theLeft <= 0)
+		return;
+	
+	StPointerBlock theBuffer( (theLeft > kChunkSize) ? kChunkSize : theLeft );
+	
+	inStream.SetMarker( 0, streamFrom_Start );
+	while (theLeft > 0)
+	{
+		SInt32 theChunk = (theLeft > kChunkSize) ? kChunkSize : theLeft;
+		inStream.ReadBlock( theBuffer, theChunk );
+		HashBytes( theBuffer, theChunk, outHash );
+		theLeft -= theChunk;
+	}
+}
+
+
+// ---------------------------------------------------------------------------
+//		 InitHash											[static]
+// ---------------------------------------------------------------------------
+
+void
+CWailSoundStream::InitHash(
+	SSoundHash&		outHash )
+{
+	outHash.mHash1 = 2166136261UL;	// FNV-1a offset basis.
+	outHash.mHash2 = 0;
+}
+
+
+// ---------------------------------------------------------------------------
+//		 HashBytes											[static]
+// ---------------------------------------------------------------------------
+// adds the given bytes to a hash. not meant to resist anything, just to tell
+// different sounds apart quickly. call InitHash first.
+
+void
+CWailSoundStream::HashBytes(
+	const void*		inData,
+	SInt32			inLength,
+	SSoundHash&		ioHash )
+{
+	const UInt8* theData = (const UInt8*) inData;
+	UInt32 theHash1 = ioHash.mHash1;
+	UInt32 theHash2 = ioHash.mHash2;
+	
+	while (inLength-- > 0)
+	{
+		UInt8 theByte = *theData++;
+		
+		theHash1 ^= theByte;
+		theHash1 *= 16777619UL;		// FNV prime.
+		
+		theHash2 = theByte + (theHash2 << 6) + (theHash2 << 16) - theHash2;
+	}
+	
+	ioHash.mHash1 = theHash1;
+	ioHash.mHash2 = theHash2;
+}
+
+
+#pragma mark --- Comparing ---
+
+
+// ---------------------------------------------------------------------------
+//		 FindFirstDifference								[static]
+// ---------------------------------------------------------------------------
+// compares two streams from their start and returns the offset of the first
+// byte that differs, or -1 if both streams are the same. if one stream is
+// a prefix of the other, the length of the shortest one is returned.
+//
+// streams are compared one chunk at a time, so memory use doesn't depend on
+// the size of the streams. sounds that can give us a pointer to their data
+// are not copied at all. markers are left anywhere.
+
+SInt32
+CWailSoundStream::FindFirstDifference(
+	LStream&	inStream1,
+	LStream&	inStream2 )
+{
+	const SInt32 kChunkSize = 32 * 1024;
+	
+	SInt32 theLength1 = inStream1.GetLength();
+	SInt32 theLength2 = inStream2.GetLength();
+	SInt32 theLength = (theLength1 < theLength2) ? theLength1 : theLength2;
+	
+	// see which streams we can look at directly.
+	const char* theData1 = nil;
+	const char* theData2 = nil;
+	CWailSoundStream* theSound = dynamic_cast<CWailSoundStream*>(&inStream1);
+	if ((theSound != nil) && theSound->CanGetBuffer())
+		theData1 = (const char*) theSound->GetBuffer();
+	theSound = dynamic_cast<CWailSoundStream*>(&inStream2);
+	if ((theSound != nil) && theSound->CanGetBuffer())
+		theData2 = (const char*) theSound->GetBuffer();
+	
+	// others are read in a chunk buffer.
+	SInt32 theBufferSize = (theLength > kChunkSize) ? kChunkSize : theLength;
+	StPointerBlock theBuffer1( (theData1 == nil) ? theBufferSize : 0 );
+	StPointerBlock theBuffer2( (theData2 == nil) ? theBufferSize : 0 );
+	if (theData1 == nil)
+		inStream1.SetMarker( 0, streamFrom_Start );
+	if (theData2 == nil)
+		inStream2.SetMarker( 0, streamFrom_Start );
+	
+	SInt32 theOffset = 0;
+	while (theOffset < theLength)
+	{
+		SInt32 theChunk = theLength - theOffset;
+		if (theChunk > kChunkSize)
+			theChunk = kChunkSize;
+		
+		const char* theChunk1;
+		if (theData1 != nil)
+			theChunk1 = theData1 + theOffset;
+		else
+		{
+			inStream1.ReadBlock( theBuffer1, theChunk );
+			theChunk1 = theBuffer1;
+		}
+		
+		const char* theChunk2;
+		if (theData2 != nil)
+			theChunk2 = theData2 + theOffset;
+		else
+		{
+			inStream2.ReadBlock( theBuffer2, theChunk );
+			theChunk2 = theBuffer2;
+		}
+		
+		SInt32 theDiff = FindFirstDifferentByte( theChunk1, theChunk2, theChunk );
+		if (theDiff >= 0)
+			return theOffset + theDiff;
+		
+		theOffset += theChunk;
+	}
+	
+	return (theLength1 == theLength2) ? -1 : theLength;
+}
+
+
+// ---------------------------------------------------------------------------
+//		 CountSameLastBytes								[static]
+// ---------------------------------------------------------------------------
+// returns the number of bytes at the end of both streams that are the same,
+// up to inMaxCount. like FindFirstDifference, streams are read one chunk at a
+// time, but backwards. markers are left anywhere.
+
+SInt32
+CWailSoundStream::CountSameLastBytes(
+	LStream&	inStream1,
+	LStream&	inStream2,
+	SInt32		inMaxCount )
+{
+	const SInt32 kChunkSize = 32 * 1024;
+	
+	SInt32 theLength1 = inStream1.GetLength();
+	SInt32 theLength2 = inStream2.GetLength();
+	SInt32 theLength = (theLength1 < theLength2) ? theLength1 : theLength2;
+	if (inMaxCount < theLength)
+		theLength = inMaxCount;
+	
+	SInt32 theBufferSize = (theLength > kChunkSize) ? kChunkSize : theLength;
+	StPointerBlock theBuffer1( theBufferSize );
+	StPointerBlock theBuffer2( theBufferSize );
+	
+	SInt32 theCount = 0;
+	while (theCount < theLength)
+	{
+		SInt32 theChunk = theLength - theCount;
+		if (theChunk > kChunkSize)
+			theChunk = kChunkSize;
+		
+		// read the chunk that ends where the same bytes found so far start.
+		inStream1.SetMarker( theLength1 - theCount - theChunk, streamFrom_Start );
+		inStream1.ReadBlock( theBuffer1, theChunk );
+		inStream2.SetMarker( theLength2 - theCount - theChunk, streamFrom_Start );
+		inStream2.ReadBlock( theBuffer2, theChunk );
+		
+		const UInt8* theBytes1 = (const UInt8*) (Ptr) theBuffer1;
+		const UInt8* theBytes2 = (const UInt8*) (Ptr) theBuffer2;
+		for (SInt32 i = theChunk - 1; i >= 0; i--)
+		{
+			if (theBytes1[i] != theBytes2[i])
+				return theCount + (theChunk - 1 - i);
+		}
+		
+		theCount += theChunk;
+	}
+	
+	return theCount;
+}
+
+
+// ---------------------------------------------------------------------------
+//		 FindFirstDifferentByte							[static]
+// ---------------------------------------------------------------------------
+// returns the offset of the first byte that differs between two buffers, or -1.
+// when both buffers are aligned the same way, we compare them four bytes at a
+// time and only look at single bytes in the word that differs.
+
+SInt32
+CWailSoundStream::FindFirstDifferentByte(
+	const void*		inData1,
+	const void*		inData2,
+	SInt32			inLength )
+{
+	const UInt8* theBytes1 = (const UInt8*) inData1;
+	const UInt8* theBytes2 = (const UInt8*) inData2;
+	SInt32 i = 0;
+	
+	if ((((UInt32) theBytes1 ^ (UInt32) theBytes2) & 3) == 0)
+	{
+		// get to a word boundary.
+		while ((i < inLength) && (((UInt32) (theBytes1 + i) & 3) != 0))
+		{
+			if (theBytes1[i] != theBytes2[i])
+				return i;
+			i++;
+		}
+		
+		// compare whole words, stopping at the first one that differs.
+		const UInt32* theWords1 = (const UInt32*) (theBytes1 + i);
+		const UInt32* theWords2 = (const UInt32*) (theBytes2 + i);
+		SInt32 theNumWords = (inLength - i) >> 2;
+		while ((theNumWords > 0) && (*theWords1 == *theWords2))
+		{
+			theWords1++;
+			theWords2++;
+			theNumWords--;
+		}
+		i = (const UInt8*) theWords1 - theBytes1;
+	}
+	
+	// the rest (or everything, if buffers are not aligned alike) byte by byte.
+	while (i < inLength)
+	{
+		if (theBytes1[i] != theBytes2[i])
+			return i;
+		i++;
+	}
+	
+	return -1;
+}
@@ -31,6 +31,17 @@
 #pragma once
 #include <LStream.h>
 
+class CMappedFileStream;
+
+
+// content hash of a sound. our compiler has no 64-bit integer type we can count
+// on, so it's made of two different 32-bit hashes computed in the same pass.
+
+struct SSoundHash
+{
+	UInt32		mHash1;		// FNV-1a
+	UInt32		mHash2;		// sdbm
+};
 
 class CWailSoundStream: public LStream
 {
@@ -42,6 +53,12 @@ class CWailSoundStream: public LStream
 							CWailSoundStream(
 								Handle				inHandle );
 								
+		//Constructor copying data from a buffer
+		
+							CWailSoundStream(
+								const void*			inData,
+								SInt32				inLength );
+								
 		//Constructor matching CStreamView's constructor
 		
 							CWailSoundStream(
@@ -49,6 +66,13 @@ class CWailSoundStream: public LStream
 								SInt32				inStartOffset,
 								SInt32				inLength );
 		
+		//Constructor pointing directly inside a mapped file
+		
+							CWailSoundStream(
+								const CMappedFileStream*	inMappedFile,
+								SInt32						inStartOffset,
+								SInt32						inLength );
+		
 		//Destructor
 		
 		virtual				~CWailSoundStream();
@@ -72,12 +96,50 @@ class CWailSoundStream: public LStream
 									void			*outBuffer,
 									SInt32			&ioByteCount);
 		
+		// direct access to sound data
+		
+		Boolean					CanGetBuffer() const;
+		const void*				GetBuffer() const;
+		
+		// content hash
+		
+		const SSoundHash&		GetContentHash();
+		Boolean					IsHashKnown() const { return mHashValid; }
+		
+		static void				HashStream(
+									LStream&		inStream,
+									SSoundHash&		outHash );
+		static void				InitHash(
+									SSoundHash&		outHash );
+		static void				HashBytes(
+									const void*		inData,
+									SInt32			inLength,
+									SSoundHash&		ioHash );
+		
+		// comparing streams
+		
+		static SInt32			FindFirstDifference(
+									LStream&		inStream1,
+									LStream&		inStream2 );
+		static SInt32			CountSameLastBytes(
+									LStream&		inStream1,
+									LStream&		inStream2,
+									SInt32			inMaxCount );
+		
 	private:
 	// Member Variables and Classes
 	
-		LStream*			mStream;	// the real stream.
+		LStream*			mStream;		// the real stream. nil if we're mapped.
+		const char*			mMappedData;	// pointer to our sound in a mapped file.
+		SSoundHash			mContentHash;	// hash of our data, if mHashValid.
+		Boolean				mHashValid;
 	
 	// Private Functions
+		static SInt32			FindFirstDifferentByte(
+									const void*		inData1,
+									const void*		inData2,
+									SInt32			inLength );
+		
 		// Defensive programming. No  operator=
 		CWailSoundStream&			operator=(const CWailSoundStream&);
 		// Defensive programming. No Copy Constructor
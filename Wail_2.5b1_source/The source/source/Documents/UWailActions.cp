@@ -115,6 +115,7 @@ CAddSoundAction::RedoSelf()
 	// get the current class.
 	CWailSoundClass *theClass;
 	mWindow->GetSoundFileData()->mSoundClasses.FetchItemAt( mClassNumber + 1, theClass );
+	theClass->mDirty = true;	// the class must be saved.
 
 	// store this stream in the class' member variable.
 	if (mIs8bit)
@@ -163,6 +164,7 @@ CAddSoundAction::UndoSelf()
 	// get the current class.
 	CWailSoundClass *theClass;
 	mWindow->GetSoundFileData()->mSoundClasses.FetchItemAt( mClassNumber + 1, theClass );
+	theClass->mDirty = true;	// the class must be saved.
 	
 	// substract one to the number of sounds.
 	if (mIs8bit)
@@ -247,6 +249,7 @@ CRemoveSoundAction::RedoSelf()
 	// get the sound class.
 	CWailSoundClass *theClass;
 	mWindow->GetSoundFileData()->mSoundClasses.FetchItemAt( mClassNumber + 1, theClass );
+	theClass->mDirty = true;	// the class must be saved.
 	
 	// delete the sound.
 	if (mIs8bit)
@@ -318,6 +321,7 @@ CRemoveSoundAction::UndoSelf()
 	// get the sound class.
 	CWailSoundClass *theClass;
 	mWindow->GetSoundFileData()->mSoundClasses.FetchItemAt( mClassNumber + 1, theClass );
+	theClass->mDirty = true;	// the class must be saved.
 	
 	// move sounds back up if necessary.
 	if (mSoundNumber < (mIs8bit
@@ -547,6 +551,7 @@ CDontRemap8bitAction::RedoSelf()
 	// mark class as no longer re-mapped.
 	CWailSoundClass *theClass;
 	mWindow->GetSoundFileData()->mSoundClasses.FetchItemAt( mClassNumber + 1, theClass );
+	theClass->mDirty = true;	// the class must be saved.
 	theClass->mRemap8bit = false;
 	// remapping makes us dirty.
 	mWindow->SetDirty( true );
@@ -582,6 +587,7 @@ CDontRemap8bitAction::UndoSelf()
 	// mark the class as remapped.
 	CWailSoundClass *theClass;
 	mWindow->GetSoundFileData()->mSoundClasses.FetchItemAt( mClassNumber + 1, theClass );
+	theClass->mDirty = true;	// the class must be saved.
 	theClass->mRemap8bit = true;
 	// remapping makes us dirty.
 	mWindow->SetDirty( true );
@@ -655,6 +661,7 @@ CRemap8bitAction::RedoSelf()
 	// get current class.
 	CWailSoundClass *theClass;
 	mWindow->GetSoundFileData()->mSoundClasses.FetchItemAt( mClassNumber + 1, theClass );
+	theClass->mDirty = true;	// the class must be saved.
 	
 	// we must delete all 16-bit sounds but store them in case we need them later.
 	SInt16 i;
@@ -699,6 +706,7 @@ CRemap8bitAction::UndoSelf()
 	// get current class.
 	CWailSoundClass *theClass;
 	mWindow->GetSoundFileData()->mSoundClasses.FetchItemAt( mClassNumber + 1, theClass );
+	theClass->mDirty = true;	// the class must be saved.
 	
 	// we must replace all 16-bit sounds where they were.
 	SInt16 i;
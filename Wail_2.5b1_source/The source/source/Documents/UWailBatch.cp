@@ -0,0 +1,1587 @@
+// =================================================================================
+//	UWailBatch.cp					2003, Charles Lechasseur
+// =================================================================================
+//
+// UWailBatch gives access to what Wail can do with sound files without going
+// through windows and dialogs: loading, saving, comparing, stripping sound files and
+// building shuttles. documents use it too, so both paths share the same code.
+//
+// it can also run batch scripts, which are text files of type fileType_WailBatchScript
+// that are dropped on Wail (or opened with an AppleScript "open" command). each line
+// of a script is a command followed by its arguments, separated by tabs:
+//
+//	copy	<file>	<out file>					rewrites a sound file.
+//	dedup	<file>	<out file>					rewrites a sound file, storing identical
+//												sound sets only once.
+//	compare	<file>	<other file>	<out file>	keeps only the classes of <file> that
+//												differ from those of <other file>.
+//	diff	<old file>	<new file>	<out report>
+//												lists what changed from <old file> to
+//												<new file> in a text report, without
+//												loading either file.
+//	matrix	<out report>	<file>	<file>...	tells, for each class, which files have
+//												the same class (same number in the
+//												report) and which don't have it (0).
+//	merge	<base>	<ours>	<theirs>	<out file>	[<conflict report>]
+//												merges changes made to <base> in <ours>
+//												and <theirs>. on conflicts, <ours> wins;
+//												conflicts are listed in the report.
+//	strip16	<file>	<out file>					removes 16-bit sounds of classes that
+//												have 8-bit sounds, and remaps them.
+//	make8bit	<file>	<out file>	[dither]	replaces the 8-bit sounds of classes
+//												that have 16-bit sounds by conversions
+//												of those. with "dither", noise is added
+//												to hide the loss of precision.
+//	shuttle	<file>	<out shuttle>	[compress]	builds a shuttle from a sound file.
+//												with "compress", the sound data is
+//												compressed in the shuttle.
+//	deltashuttle	<file>	<source file>	<out shuttle>	[compress]
+//												builds a shuttle that only contains
+//												what <source file> doesn't have. it
+//												can only be run on <source file>.
+//	patch	<file>	<out patch>	[compress]	like shuttle, but only writes the
+//												shuttle data, in a file without a
+//												resource fork. drop it on any shuttle
+//												with sound files to install it.
+//	deltapatch	<file>	<source file>	<out patch>	[compress]
+//												like deltashuttle, for patch files.
+//	unpack	<file>	<out folder>				writes each sound of a sound file in its
+//												own file, with a manifest of the classes.
+//	pack	<folder>	<out file>				builds a sound file from a folder made
+//												by unpack.
+//
+// paths are HFS paths; those starting with ':' are relative to the script's folder.
+// empty lines and lines starting with '#' are ignored. output files are replaced.
+//
+// while a script runs, no progress dialog is shown. results are written to a text
+// file beside the script, named like the script followed by " Report". each line of
+// the report contains, separated by tabs: the script line number, "ok" or "error",
+// the command and a list of key=value pairs.
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include "UWailBatch.h"
+
+#include <LFileStream.h>
+#include <UMemoryMgr.h>
+
+#include "MoreFilesExtras.h"
+
+#include "StOldResFile.h"
+#include "CCompressedStream.h"
+#include "CInFileStream.h"
+#include "CTempFileStream.h"
+#include "CTextFileStream.h"
+
+#include "CWailProgressDialog.h"
+#include "CWailSoundFileDiff.h"
+#include "CWailSoundFileMatrix.h"
+#include "CWailSoundFileMerge.h"
+#include "CWailSoundHeader.h"
+#include "CWailSoundStream.h"
+#include "UWailSamples.h"
+
+#include "C_PatchFile.h"
+
+#include "WailShuttleConstants.h"
+
+
+// suffix added to the name of a script to get the name of its report.
+
+const unsigned char	batchReport_Suffix[]	= "\p Report";
+
+// maximum length of a script line.
+
+const SInt32		batchScript_MaxLine		= 1023;
+
+// name of the manifest file in an unpacked sound file's folder, and the first word
+// of its first line.
+
+const unsigned char	unpack_ManifestName[]	= "\pManifest";
+const char			unpack_ManifestIdent[]	= "snd2";
+
+// size of the buffer used to copy sounds when unpacking.
+
+const SInt32		unpack_CopyBufferSize	= 32L * 1024L;
+
+// a sound is only stored as a delta in a shuttle if that saves at least this many
+// bytes. otherwise, the delta entry isn't worth it.
+
+const SInt32		shuttleDelta_MinSaving	= 1024L;
+
+
+// ---------------------------------------------------------------------------------
+//		 LoadSoundFile										[static]
+// ---------------------------------------------------------------------------------
+// loads the given sound file and returns its data. the caller owns the data; the
+// data owns the file's stream.
+//
+// if inStreamSounds is true, sounds are left in the file and each class's sounds
+// are only looked at when needed, so that big files can be handled without
+// taking a lot of memory.
+
+CWailSoundFileData*
+UWailBatch::LoadSoundFile(
+	const FSSpec&	inFile,
+	Boolean			inStreamSounds /*= false*/ )
+{
+	LFileStream* theFileStream = new LFileStream( inFile );
+	ThrowIfNil_( theFileStream );
+	StDeleter<LFileStream> theFileStreamDeleter( theFileStream );
+	
+	// we're not going to write to the file, so there's no need for write permission.
+	theFileStream->OpenDataFork( fsRdPerm );
+	
+	ESoundLoadMethod theLoadMethod = loadMethod_ViewFile;
+	if (!inStreamSounds)
+		theLoadMethod = CWailSoundFileData::ChooseLoadMethod( theFileStream->GetLength() );
+	
+	// load in an empty data rather than with the stream constructor, so that the data
+	// is deleted if loading fails. LoadFromFile owns the stream as soon as it's called
+	// (we never read in RAM here), so the data deletes the stream too in that case.
+	StDeleter<CWailSoundFileData> theData( new CWailSoundFileData() );
+	theData->LoadFromFile( theFileStreamDeleter.Release(), theLoadMethod, inStreamSounds );
+	
+	return theData.Release();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 SaveSoundFile										[static]
+// ---------------------------------------------------------------------------------
+// saves the given data in a new sound file. if the file exists, it is replaced, so
+// it must not be the file the data was loaded from.
+
+void
+UWailBatch::SaveSoundFile(
+	CWailSoundFileData&	inData,
+	const FSSpec&		inFile,
+	UInt32				inSaveFlags /*= saveFlag_None*/,
+	SInt32				*outBytesSaved /*= nil*/,
+	OSType				inFileType /*= fileType_MarathonInfinitySound*/,
+	OSType				inFileCreator /*= fileCreator_MarathonInfinitySound*/ )
+{
+	// get rid of the old file, if any.
+	OSErr err = ::FSpDelete( &inFile );
+	if (err != fnfErr)
+		ThrowIfOSErr_( err );
+	
+	LFileStream theFileStream( inFile );
+	theFileStream.CreateNewDataFile( inFileCreator, inFileType );
+	theFileStream.OpenDataFork( fsRdWrPerm );
+	
+	inData.SaveToFile( &theFileStream, inSaveFlags, outBytesSaved );
+	
+	theFileStream.CloseDataFork();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MakeShuttle										[static]
+// ---------------------------------------------------------------------------------
+// creates a shuttle that will install the given data. if the shuttle file exists,
+// it is replaced.
+//
+// if a source file is given, the shuttle is a delta shuttle: sounds that start or
+// end like the source's sound at the same place only have their middle stored, and
+// the shuttle takes the rest from the source file when it runs. such a shuttle
+// refuses to run on any other file. returns the number of sounds stored that way.
+//
+// if inCompress is true, the sound data is compressed in blocks (see CCompressedStream).
+// the shuttle only decompresses the blocks it reads, as it installs.
+
+SInt32
+UWailBatch::MakeShuttle(
+	CWailSoundFileData&	inData,
+	const FSSpec&		inShuttleFile,
+	const FSSpec*		inSourceFile /*= nil*/,
+	Boolean				inCompress /*= false*/ )
+{
+	// build the delta data first, so that nothing is written if it fails.
+	CWailSoundFileData* theShuttleData = &inData;
+	StDeleter<CWailSoundFileData> theDeltaData;
+	TArray<SShuttleDeltaEntry> theDeltaEntries;
+	SShuttleDeltaHeader theDeltaHeader;
+	if (inSourceFile != nil)
+	{
+		theDeltaData.Adopt( PrepareShuttleDelta( inData, *inSourceFile, theDeltaHeader, theDeltaEntries ) );
+		theShuttleData = theDeltaData.Get();
+	}
+	
+	// get rid of the old file, if any.
+	OSErr err = ::FSpDelete( &inShuttleFile );
+	if (err != fnfErr)
+		ThrowIfOSErr_( err );
+	
+	// create the base Shuttle content.
+	MakeFileFromMakeInfo( inShuttleFile );
+	
+	// save current resource fork for later.
+	StOldResFile oldResFile;
+	
+	// create a file stream from our file.
+	CInFileStream *theFileStream = new CInFileStream( inShuttleFile );
+	
+	// create an auto-deleter to be exception-safe.
+	// this will automatically delete the file stream at the end of this block.
+	StDeleter<CInFileStream> theFileStreamDeleter( theFileStream );
+	
+	// open its data fork.
+	theFileStream->OpenDataFork( fsRdWrPerm );
+	
+	// the data goes after the shuttle's own data fork.
+	SShuttleDataInfo theInfo = WriteShuttleData( *theFileStream, *theShuttleData, inCompress,
+												 (inSourceFile != nil) ? &theDeltaHeader : nil,
+												 theDeltaEntries );
+	
+	// close the data fork.
+	theFileStream->CloseDataFork();
+	
+	// open the resource fork.
+	theFileStream->OpenResourceFork( fsRdWrPerm );
+	
+	// we need to tell the shuttle where to start looking for its data in its own data fork,
+	// and where its delta section is. the trailer says it too, but shuttles that were
+	// built before it don't look there: we will create a resource with that information
+	// and add it to the shuttle as a resource.
+	{
+		StHandleBlock theLongHandle( sizeof(SShuttleDataInfo) );
+		(**((SShuttleDataInfo**) ((Handle) theLongHandle))) = theInfo;
+		
+		// add the resource to the shuttle.
+		::AddResource( theLongHandle,
+					   rShuttleData_Type,
+					   rShuttleData_ID,
+					   // resource name:
+					   	"\p" );
+		ThrowIfResError_();
+		
+		// release that new resource from memory.
+		::ReleaseResource( theLongHandle.Release() );
+		ThrowIfResError_();
+	}
+	
+	// close the resource fork.
+	theFileStream->CloseResourceFork();
+	
+	// the file stream is deleted here by the StDeleter created earlier.
+	
+	return theDeltaEntries.GetCount();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MakeShuttlePatch									[static]
+// ---------------------------------------------------------------------------------
+// like MakeShuttle, but only writes the shuttle data, in a file of its own with no
+// resource fork. the trailer at the end tells where everything is. dropping such a
+// file on a shuttle along with sound files installs it instead of the shuttle's own
+// data. returns the number of delta sounds.
+//
+// the data is written in one pass; only compressing needs a temp file.
+
+SInt32
+UWailBatch::MakeShuttlePatch(
+	CWailSoundFileData&	inData,
+	const FSSpec&		inPatchFile,
+	const FSSpec*		inSourceFile /*= nil*/,
+	Boolean				inCompress /*= false*/ )
+{
+	// build the delta data first, so that nothing is written if it fails.
+	CWailSoundFileData* thePatchData = &inData;
+	StDeleter<CWailSoundFileData> theDeltaData;
+	TArray<SShuttleDeltaEntry> theDeltaEntries;
+	SShuttleDeltaHeader theDeltaHeader;
+	if (inSourceFile != nil)
+	{
+		theDeltaData.Adopt( PrepareShuttleDelta( inData, *inSourceFile, theDeltaHeader, theDeltaEntries ) );
+		thePatchData = theDeltaData.Get();
+	}
+	
+	// get rid of the old file, if any.
+	OSErr err = ::FSpDelete( &inPatchFile );
+	if (err != fnfErr)
+		ThrowIfOSErr_( err );
+	
+	CInFileStream theFileStream( inPatchFile );
+	theFileStream.CreateNewDataFile( fileCreator_Wail, fileType_ShuttlePatch );
+	theFileStream.OpenDataFork( fsRdWrPerm );
+	
+	WriteShuttleData( theFileStream, *thePatchData, inCompress,
+					  (inSourceFile != nil) ? &theDeltaHeader : nil,
+					  theDeltaEntries );
+	
+	theFileStream.CloseDataFork();
+	
+	return theDeltaEntries.GetCount();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 PrepareShuttleDelta								[static]
+// ---------------------------------------------------------------------------------
+// builds the data of a delta shuttle against the given source file, along with its
+// delta section. the caller owns the returned data.
+
+CWailSoundFileData*
+UWailBatch::PrepareShuttleDelta(
+	CWailSoundFileData&			inData,
+	const FSSpec&				inSourceFile,
+	SShuttleDeltaHeader&		outHeader,
+	TArray<SShuttleDeltaEntry>&	outEntries )
+{
+	StDeleter<CWailSoundFileData> theSourceData( LoadSoundFile( inSourceFile, true ) );
+	StDeleter<CWailSoundFileData> theDeltaData( MakeShuttleDelta( inData, *theSourceData, outEntries ) );
+	
+	// the shuttle checks it's looking at the right file before using anything in it.
+	LFileStream theSourceFile( inSourceFile );
+	theSourceFile.OpenDataFork( fsRdPerm );
+	CWailSoundFileData::HashFileTables( theSourceFile, outHeader.mSourceHash );
+	theSourceFile.CloseDataFork();
+	
+	outHeader.mIdent = shuttleDelta_Ident;
+	outHeader.mVersion = shuttleDelta_Version;
+	outHeader.mNumEntries = outEntries.GetCount();
+	
+	return theDeltaData.Release();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 WriteShuttleData									[static]
+// ---------------------------------------------------------------------------------
+// writes shuttle data at the end of the given file: the sound file data, the delta
+// section if there's one, then the trailer. the file's inset is moved to the start
+// of the sound file data. returns where things were written.
+
+SShuttleDataInfo
+UWailBatch::WriteShuttleData(
+	CInFileStream&						ioFile,
+	CWailSoundFileData&					inData,
+	Boolean								inCompress,
+	const SShuttleDeltaHeader*			inDeltaHeader,
+	const TArray<SShuttleDeltaEntry>&	inDeltaEntries )
+{
+	// move the inset of the InFileStream to make it look like
+	// it starts at the end of the file.
+	SShuttleDataInfo theInfo;
+	theInfo.mDataOffset = ioFile.GetInset() + ioFile.GetLength();
+	theInfo.mDeltaOffset = 0;
+	ioFile.SetInset( theInfo.mDataOffset );
+	
+	// save the data to the file. to compress it, we need all of it first; it's saved
+	// in a temp file, then compressed in the shuttle.
+	if (inCompress)
+	{
+		CTempFileStream theImageFile;
+		inData.SaveToFile( &theImageFile );
+		
+		ioFile.SetMarker( 0, streamFrom_Start );
+		CCompressedStream::Compress( theImageFile, ioFile );
+	}
+	else
+		inData.SaveToFile( &ioFile );
+	
+	// the delta section goes right after it.
+	if (inDeltaHeader != nil)
+	{
+		theInfo.mDeltaOffset = ioFile.GetLength();
+		ioFile.SetMarker( theInfo.mDeltaOffset, streamFrom_Start );
+		ioFile.WriteBlock( inDeltaHeader, sizeof(SShuttleDeltaHeader) );
+		
+		SInt32 numEntries = inDeltaEntries.GetCount();
+		for (SInt32 i = 1; i <= numEntries; i++)
+			ioFile.WriteBlock( &inDeltaEntries[i], sizeof(SShuttleDeltaEntry) );
+	}
+	
+	// the trailer ends the file.
+	SShuttleTrailer theTrailer;
+	theTrailer.mInfo = theInfo;
+	theTrailer.mVersion = shuttleTrailer_Version;
+	theTrailer.mIdent = shuttleTrailer_Ident;
+	ioFile.SetMarker( ioFile.GetLength(), streamFrom_Start );
+	ioFile.WriteBlock( &theTrailer, sizeof(SShuttleTrailer) );
+	
+	return theInfo;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MakeShuttleDelta									[static]
+// ---------------------------------------------------------------------------------
+// returns data that looks like the given data, except that sounds that start or end
+// like the source's sound in the same slot only contain their middle part. what was
+// cut is described in outEntries. the caller owns the returned data; its sounds are
+// views of inData's sounds, so inData must outlive it.
+
+CWailSoundFileData*
+UWailBatch::MakeShuttleDelta(
+	CWailSoundFileData&			inData,
+	CWailSoundFileData&			inSourceData,
+	TArray<SShuttleDeltaEntry>&	outEntries )
+{
+	SInt32 numClasses = inData.mSoundClasses.GetCount();
+	
+	// the shuttle doesn't know the demo layout; it can't find sounds in such a source.
+	SInt32 numSourceClasses = inSourceData.mDemoLayout ? 0 : inSourceData.mSoundClasses.GetCount();
+	
+	StDeleter<CWailSoundFileData> theDeltaData( new CWailSoundFileData() );
+	theDeltaData->mDemoLayout = inData.mDemoLayout;
+	theDeltaData->mSoundClasses.AdjustAllocation( numClasses );
+	
+	CWailSoundClass theEmptyClass;
+	for (SInt32 i = 1; i <= numClasses; i++)
+	{
+		CWailSoundClass* theClass = inData.GetSoundClass( i );
+		
+		// unused classes are taken from the source file as a whole by the shuttle.
+		CWailSoundClass* theSourceClass = &theEmptyClass;
+		if ((i <= numSourceClasses) && (theClass->mClassID != classID_Unused))
+			theSourceClass = inSourceData.GetSoundClass( i );
+		
+		StDeleter<CWailSoundClass> theDeltaClass( new CWailSoundClass() );
+		theDeltaClass->mClassID = theClass->mClassID;
+		theDeltaClass->mVolume = theClass->mVolume;
+		theDeltaClass->mFlags = theClass->mFlags;
+		theDeltaClass->mChance = theClass->mChance;
+		theDeltaClass->mLowPitch = theClass->mLowPitch;
+		theDeltaClass->mHighPitch = theClass->mHighPitch;
+		theDeltaClass->mRemap8bit = theClass->mRemap8bit;
+		
+		theDeltaClass->mNum8bitSounds = theClass->mNum8bitSounds;
+		MakeDeltaSoundSet( i, 0, theClass->mNum8bitSounds, theClass->m8bitSounds,
+						   theSourceClass->mNum8bitSounds, theSourceClass->m8bitSounds,
+						   theDeltaClass->m8bitSounds, outEntries );
+		theDeltaClass->mNum16bitSounds = theClass->mNum16bitSounds;
+		MakeDeltaSoundSet( i, 1, theClass->mNum16bitSounds, theClass->m16bitSounds,
+						   theSourceClass->mNum16bitSounds, theSourceClass->m16bitSounds,
+						   theDeltaClass->m16bitSounds, outEntries );
+		
+		theDeltaData->mSoundClasses.AddItem( theDeltaClass.Release() );
+	}
+	
+	return theDeltaData.Release();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Make8bitSound										[static]
+// ---------------------------------------------------------------------------------
+// returns a new 8-bit sound made from the given 16-bit sound, or nil if it isn't a
+// 16-bit sound we can read. the samples are converted a chunk at a time, so that only
+// the new sound has to fit in memory.
+
+LStream*
+UWailBatch::Make8bitSound(
+	LStream&	in16bitSound,
+	Boolean		inDither,
+	UInt32&		ioDitherSeed )
+{
+	CWailSoundHeader theHeader;
+	if (!theHeader.Parse( in16bitSound ) || (theHeader.GetSampleSize() != 16))
+		return nil;
+	
+	// the new header keeps everything but the sample size.
+	UInt8 theNewHeader[soundHeader_MaxLength];
+	SInt32 theNewHeaderLength = theHeader.Write( theNewHeader, 8 );
+	SInt32 theNumSamples = theHeader.GetNumFrames() * theHeader.GetNumChannels();
+	
+	StHandleBlock theSound( theNewHeaderLength + theNumSamples );
+	const SInt32 kChunkSamples = 4096;
+	StPointerBlock theChunk( kChunkSamples * sizeof(SInt16) );
+	SInt16* theSamples = (SInt16*) theChunk.Get();
+	
+	// allocating may have moved the samples we were pointing to; point to them again.
+	theHeader.Parse( in16bitSound );
+	
+	{
+		StHandleLocker theLock( theSound );
+		::BlockMoveData( theNewHeader, *theSound.Get(), theNewHeaderLength );
+		UInt8* theOut = (UInt8*) *theSound.Get() + theNewHeaderLength;
+		
+		// samples we can point to are converted from where they are; the others are
+		// read a chunk at a time. either way, they're made native before narrowing.
+		const UInt8* theIn = (const UInt8*) theHeader.GetSamples();
+		SInt32 theMarker = in16bitSound.GetMarker();
+		if (theIn == nil)
+			in16bitSound.SetMarker( theHeader.GetDataOffset(), streamFrom_Start );
+		
+		for (SInt32 i = 0; i < theNumSamples; i += kChunkSamples)
+		{
+			SInt32 theCount = theNumSamples - i;
+			if (theCount > kChunkSamples)
+				theCount = kChunkSamples;
+			
+			if (theIn != nil)
+				UWailSamples::BigEndianToNative16( theIn + (i * 2), theSamples, theCount );
+			else
+			{
+				in16bitSound.ReadBlock( theSamples, theCount * 2 );
+				UWailSamples::BigEndianToNative16( theSamples, theSamples, theCount );
+			}
+			
+			if (inDither)
+				UWailSamples::Narrow16To8Dithered( theSamples, theOut + i, theCount, ioDitherSeed );
+			else
+				UWailSamples::Narrow16To8( theSamples, theOut + i, theCount );
+		}
+		
+		if (theIn == nil)
+			in16bitSound.SetMarker( theMarker, streamFrom_Start );
+	}
+	
+	return new CWailSoundStream( theSound.Release() );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MakeDeltaSoundSet									[static]
+// ---------------------------------------------------------------------------------
+// fills outSounds with views of the given sounds, cutting what's the same at the
+// start and at the end of the source's sound in the same slot when it's worth it.
+// an entry is added to ioEntries for each sound that's cut.
+
+void
+UWailBatch::MakeDeltaSoundSet(
+	SInt32						inClassIndex,
+	SInt16						inSet,
+	SInt16						inNumSounds,
+	LStream* const				inSounds[5],
+	SInt16						inNumSourceSounds,
+	LStream* const				inSourceSounds[5],
+	LStream*					outSounds[5],
+	TArray<SShuttleDeltaEntry>&	ioEntries )
+{
+	for (SInt16 j = 0; j < inNumSounds; j++)
+	{
+		LStream* theSound = inSounds[j];
+		SInt32 theLength = theSound->GetLength();
+		SInt32 thePrefixLength = 0;
+		SInt32 theSuffixLength = 0;
+		
+		if (j < inNumSourceSounds)
+		{
+			LStream* theSourceSound = inSourceSounds[j];
+			SInt32 theSourceLength = theSourceSound->GetLength();
+			
+			thePrefixLength = CWailSoundStream::FindFirstDifference( *theSound, *theSourceSound );
+			if (thePrefixLength < 0)
+				thePrefixLength = theLength;	// same sound.
+			
+			// the end must not overlap the start, in either sound.
+			SInt32 theMaxSuffix = ((theLength < theSourceLength) ? theLength : theSourceLength) -
+								  thePrefixLength;
+			theSuffixLength = CWailSoundStream::CountSameLastBytes( *theSound, *theSourceSound,
+																	 theMaxSuffix );
+			
+			if ((thePrefixLength + theSuffixLength) >= shuttleDelta_MinSaving)
+			{
+				SShuttleDeltaEntry theEntry;
+				theEntry.mSet = inSet;
+				theEntry.mClass = inClassIndex - 1;
+				theEntry.mSound = j;
+				theEntry.mReserved = 0;
+				theEntry.mSourceLength = theSourceLength;
+				theEntry.mPrefixLength = thePrefixLength;
+				theEntry.mSuffixLength = theSuffixLength;
+				
+				CWailSoundStream* theSourceView = dynamic_cast<CWailSoundStream*>(theSourceSound);
+				if (theSourceView != nil)
+					theEntry.mSourceHash = theSourceView->GetContentHash();
+				else
+					CWailSoundStream::HashStream( *theSourceSound, theEntry.mSourceHash );
+				
+				ioEntries.AddItem( theEntry );
+			}
+			else
+			{
+				thePrefixLength = 0;
+				theSuffixLength = 0;
+			}
+		}
+		
+		outSounds[j] = new CWailSoundStream( theSound, thePrefixLength,
+											 theLength - thePrefixLength - theSuffixLength );
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Strip16bitSounds									[static]
+// ---------------------------------------------------------------------------------
+// removes the 16-bit sounds of every class that has 8-bit sounds, and makes those
+// classes remap their 8-bit sounds instead. classes that only have 16-bit sounds are
+// left alone. returns the number of classes that changed.
+
+SInt32
+UWailBatch::Strip16bitSounds(
+	CWailSoundFileData&	ioData )
+{
+	// we're about to delete sounds, so make sure they're all there.
+	ioData.PrefetchAllClasses();
+	
+	SInt32 theNumStripped = 0;
+	SInt32 theNumClasses = ioData.mSoundClasses.GetCount();
+	for (SInt32 i = 1; i <= theNumClasses; i++)
+	{
+		CWailSoundClass* theClass = ioData.mSoundClasses[i];
+		if ((theClass->mNum8bitSounds > 0) && !theClass->mRemap8bit)
+		{
+			for (SInt16 j = 0; j < theClass->mNum16bitSounds; j++)
+			{
+				delete theClass->m16bitSounds[j];
+				theClass->m16bitSounds[j] = nil;
+			}
+			theClass->mNum16bitSounds = 0;
+			theClass->mRemap8bit = true;
+			theClass->mDirty = true;	// the class must be saved.
+			
+			++theNumStripped;
+		}
+	}
+	
+	return theNumStripped;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Make8bitSounds									[static]
+// ---------------------------------------------------------------------------------
+// replaces the 8-bit sounds of every class that has 16-bit sounds by 8-bit versions
+// of those, so that both sets always match. a class is left alone if one of its
+// 16-bit sounds can't be read or converted. returns the number of classes that
+// changed.
+
+SInt32
+UWailBatch::Make8bitSounds(
+	CWailSoundFileData&	ioData,
+	Boolean				inDither )
+{
+	// we're about to replace sounds, so make sure they're all there.
+	ioData.PrefetchAllClasses();
+	
+	// the same noise goes on from sound to sound; only its start is fixed, so that
+	// converting the same file twice gives the same result.
+	UInt32 theDitherSeed = 1;
+	
+	SInt32 theNumConverted = 0;
+	SInt32 theNumClasses = ioData.mSoundClasses.GetCount();
+	for (SInt32 i = 1; i <= theNumClasses; i++)
+	{
+		CWailSoundClass* theClass = ioData.mSoundClasses[i];
+		if (theClass->mNum16bitSounds == 0)
+			continue;
+		
+		// convert all sounds before touching the class, in case one fails. a sound
+		// that can't be converted (not enough memory, a read error...) fails the
+		// class too, instead of the whole file.
+		LStream* the8bitSounds[5] = { nil, nil, nil, nil, nil };
+		Boolean isGood = true;
+		SInt16 j;
+		try
+		{
+			for (j = 0; isGood && (j < theClass->mNum16bitSounds); j++)
+			{
+				the8bitSounds[j] = Make8bitSound( *theClass->m16bitSounds[j],
+												  inDither, theDitherSeed );
+				isGood = (the8bitSounds[j] != nil);
+			}
+		}
+		
+		catch (...)
+		{
+			isGood = false;
+		}
+		
+		if (!isGood)
+		{
+			for (j = 0; j < theClass->mNum16bitSounds; j++)
+				delete the8bitSounds[j];
+			continue;
+		}
+		
+		for (j = 0; j < theClass->mNum8bitSounds; j++)
+		{
+			delete theClass->m8bitSounds[j];
+			theClass->m8bitSounds[j] = nil;
+		}
+		for (j = 0; j < theClass->mNum16bitSounds; j++)
+			theClass->m8bitSounds[j] = the8bitSounds[j];
+		theClass->mNum8bitSounds = theClass->mNum16bitSounds;
+		theClass->mRemap8bit = false;
+		theClass->mDirty = true;	// the class must be saved.
+		
+		++theNumConverted;
+	}
+	
+	return theNumConverted;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CountNonEmptyClasses								[static]
+// ---------------------------------------------------------------------------------
+// returns the number of classes of the data that are used.
+
+SInt32
+UWailBatch::CountNonEmptyClasses(
+	const CWailSoundFileData& inData )
+{
+	SInt32 theCount = 0;
+	SInt32 theNumClasses = inData.mSoundClasses.GetCount();
+	for (SInt32 i = 1; i <= theNumClasses; i++)
+	{
+		const CWailSoundClass* theClass = inData.mSoundClasses[i];
+		if (theClass->mClassID != classID_Unused)
+			++theCount;
+	}
+	
+	return theCount;
+}
+
+
+#pragma mark -
+
+// ---------------------------------------------------------------------------------
+//		 DiffSoundFiles									[static]
+// ---------------------------------------------------------------------------------
+// writes what changed between two sound files in a text report (see
+// CWailSoundFileDiff::WriteReport) and returns the number of classes that changed.
+// neither file is loaded; only their class headers are kept in memory.
+
+SInt32
+UWailBatch::DiffSoundFiles(
+	const FSSpec&	inOldFile,
+	const FSSpec&	inNewFile,
+	const FSSpec&	inReportFile )
+{
+	LFileStream theOldFile( inOldFile );
+	theOldFile.OpenDataFork( fsRdPerm );
+	LFileStream theNewFile( inNewFile );
+	theNewFile.OpenDataFork( fsRdPerm );
+	
+	CWailSoundFileDiff theDiff( theOldFile, theNewFile );
+	theDiff.Compare();
+	
+	// get rid of the old report, if any.
+	OSErr err = ::FSpDelete( &inReportFile );
+	if (err != fnfErr)
+		ThrowIfOSErr_( err );
+	
+	LFileStream theReport( inReportFile );
+	theReport.CreateNewDataFile( fileCreator_Wail, fileType_Text );
+	theReport.OpenDataFork( fsRdWrPerm );
+	theDiff.WriteReport( theReport );
+	theReport.CloseDataFork();
+	
+	return theDiff.CountChangedClasses();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MatchSoundFiles									[static]
+// ---------------------------------------------------------------------------------
+// writes a report telling which of the given sound files have the same content for
+// each class (see CWailSoundFileMatrix), and returns the number of classes that are
+// not the same in all files. each file is read once, one after the other; the first
+// line of the report names the files.
+
+SInt32
+UWailBatch::MatchSoundFiles(
+	const TArray<FSSpec>&	inFiles,
+	const FSSpec&			inReportFile )
+{
+	CWailSoundFileMatrix theMatrix;
+	
+	SInt32 numFiles = inFiles.GetCount();
+	SInt32 i;
+	for (i = 1; i <= numFiles; i++)
+	{
+		LFileStream theFile( inFiles[i] );
+		theFile.OpenDataFork( fsRdPerm );
+		theMatrix.AddFile( theFile );
+	}
+	
+	// get rid of the old report, if any.
+	OSErr err = ::FSpDelete( &inReportFile );
+	if (err != fnfErr)
+		ThrowIfOSErr_( err );
+	
+	LFileStream theReport( inReportFile );
+	theReport.CreateNewDataFile( fileCreator_Wail, fileType_Text );
+	theReport.OpenDataFork( fsRdWrPerm );
+	
+	// file names might not fit in a single string, so write them one by one.
+	LStr255 theLine( "\pclass" );
+	theReport.WriteBlock( theLine.TextPtr(), theLine.Length() );
+	for (i = 1; i <= numFiles; i++)
+	{
+		theLine = "\p\t";
+		theLine += inFiles[i].name;
+		theReport.WriteBlock( theLine.TextPtr(), theLine.Length() );
+	}
+	theLine = "\p\r";
+	theReport.WriteBlock( theLine.TextPtr(), theLine.Length() );
+	
+	theMatrix.WriteReport( theReport );
+	theReport.CloseDataFork();
+	
+	return theMatrix.CountDifferentClasses();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MergeSoundFiles									[static]
+// ---------------------------------------------------------------------------------
+// merges the changes made to a base sound file in two other files, and saves the
+// result in a new file (see CWailSoundFileMerge). returns the number of conflicts;
+// if inReportFile is not nil, conflicts are listed in that text file.
+//
+// the three files are streamed, not loaded: merged sounds are copied from them
+// when the merged file is saved.
+
+SInt32
+UWailBatch::MergeSoundFiles(
+	const FSSpec&	inBaseFile,
+	const FSSpec&	inOurFile,
+	const FSSpec&	inTheirFile,
+	const FSSpec&	inOutFile,
+	const FSSpec*	inReportFile /*= nil*/ )
+{
+	StDeleter<CWailSoundFileData> theBase( LoadSoundFile( inBaseFile, true ) );
+	StDeleter<CWailSoundFileData> theOurs( LoadSoundFile( inOurFile, true ) );
+	StDeleter<CWailSoundFileData> theTheirs( LoadSoundFile( inTheirFile, true ) );
+	
+	// the merged data uses sounds of the others, so it must go first.
+	CWailSoundFileMerge theMerge( *theBase, *theOurs, *theTheirs );
+	StDeleter<CWailSoundFileData> theMergedData( theMerge.Merge() );
+	SaveSoundFile( *theMergedData, inOutFile );
+	
+	if (inReportFile != nil)
+	{
+		// get rid of the old report, if any.
+		OSErr err = ::FSpDelete( inReportFile );
+		if (err != fnfErr)
+			ThrowIfOSErr_( err );
+		
+		LFileStream theReport( *inReportFile );
+		theReport.CreateNewDataFile( fileCreator_Wail, fileType_Text );
+		theReport.OpenDataFork( fsRdWrPerm );
+		theMerge.WriteReport( theReport );
+		theReport.CloseDataFork();
+	}
+	
+	return theMerge.CountConflicts();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 UnpackSoundFile									[static]
+// ---------------------------------------------------------------------------------
+// writes each sound of the given data in its own file in the given folder, which is
+// created if needed. a manifest describing the classes is written as well, so that
+// PackSoundFile can rebuild the data. returns the number of sounds written.
+//
+// the first line of the manifest contains "snd2", 1 if the data uses the M2 Demo
+// layout (0 otherwise) and the number of classes. each other line describes one
+// class: its index, class ID, volume, flags, chance, low pitch, high pitch, number
+// of 8-bit sounds, number of 16-bit sounds and 1 if 8-bit sounds are remapped.
+// everything is separated by tabs. see MakeSoundFileName for the sound file names.
+//
+// classes are handled one at a time, and sounds are copied through a small buffer,
+// so this doesn't need much memory if the data was loaded with inStreamSounds.
+
+SInt32
+UWailBatch::UnpackSoundFile(
+	CWailSoundFileData&	inData,
+	const FSSpec&		inFolder )
+{
+	// create the folder, or find it if it's already there.
+	SInt32 theDirID = 0;
+	OSErr err = ::FSpDirCreate( &inFolder, smSystemScript, &theDirID );
+	if (err == dupFNErr)
+	{
+		Boolean isDirectory = false;
+		ThrowIfOSErr_( ::FSpGetDirectoryID( &inFolder, &theDirID, &isDirectory ) );
+		ThrowIf_( !isDirectory );
+	}
+	else
+	{
+		ThrowIfOSErr_( err );
+	}
+	
+	// create the manifest.
+	FSSpec theManifestFile;
+	err = ::FSMakeFSSpec( inFolder.vRefNum, theDirID, unpack_ManifestName, &theManifestFile );
+	if (err == noErr)
+		ThrowIfOSErr_( ::FSpDelete( &theManifestFile ) );
+	else if (err != fnfErr)
+		ThrowIfOSErr_( err );
+	
+	LFileStream theManifest( theManifestFile );
+	theManifest.CreateNewDataFile( fileCreator_Wail, fileType_Text );
+	theManifest.OpenDataFork( fsRdWrPerm );
+	
+	SInt32 theNumClasses = inData.mSoundClasses.GetCount();
+	LStr255 theLine( unpack_ManifestIdent );
+	theLine += "\p\t";
+	theLine += (SInt32) (inData.mDemoLayout ? 1 : 0);
+	theLine += "\p\t";
+	theLine += theNumClasses;
+	theLine += "\p\r";
+	theManifest.WriteBlock( theLine.TextPtr(), theLine.Length() );
+	
+	StPointerBlock theBuffer( unpack_CopyBufferSize );
+	SInt32 theNumSounds = 0;
+	
+	for (SInt32 i = 1; i <= theNumClasses; i++)
+	{
+		CWailSoundClass* theClass = inData.GetSoundClass( i );
+		
+		// describe the class in the manifest.
+		theLine = i;
+		theLine += "\p\t";
+		theLine += (SInt32) theClass->mClassID;
+		theLine += "\p\t";
+		theLine += (SInt32) theClass->mVolume;
+		theLine += "\p\t";
+		theLine += (SInt32) theClass->mFlags;
+		theLine += "\p\t";
+		theLine += (SInt32) theClass->mChance;
+		theLine += "\p\t";
+		theLine += (SInt32) theClass->mLowPitch;
+		theLine += "\p\t";
+		theLine += (SInt32) theClass->mHighPitch;
+		theLine += "\p\t";
+		theLine += (SInt32) theClass->mNum8bitSounds;
+		theLine += "\p\t";
+		theLine += (SInt32) theClass->mNum16bitSounds;
+		theLine += "\p\t";
+		theLine += (SInt32) (theClass->mRemap8bit ? 1 : 0);
+		theLine += "\p\r";
+		theManifest.WriteBlock( theLine.TextPtr(), theLine.Length() );
+		
+		// write its sounds.
+		SInt16 j;
+		for (j = 0; j < theClass->mNum8bitSounds; j++)
+		{
+			LStr255 theName;
+			MakeSoundFileName( i, true, j, theName );
+			CopySoundToFile( theClass->m8bitSounds[j], inFolder.vRefNum, theDirID,
+							 theName, theBuffer, unpack_CopyBufferSize );
+			++theNumSounds;
+		}
+		for (j = 0; j < theClass->mNum16bitSounds; j++)
+		{
+			LStr255 theName;
+			MakeSoundFileName( i, false, j, theName );
+			CopySoundToFile( theClass->m16bitSounds[j], inFolder.vRefNum, theDirID,
+							 theName, theBuffer, unpack_CopyBufferSize );
+			++theNumSounds;
+		}
+	}
+	
+	theManifest.CloseDataFork();
+	
+	return theNumSounds;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 PackSoundFile										[static]
+// ---------------------------------------------------------------------------------
+// builds sound file data from a folder created by UnpackSoundFile. the caller owns
+// the data; saving it with SaveSoundFile gives the same file Wail would have saved
+// from the unpacked data.
+//
+// sounds are read one at a time and kept in virtual memory, so they can be paged out
+// to disk if memory gets tight.
+
+CWailSoundFileData*
+UWailBatch::PackSoundFile(
+	const FSSpec&		inFolder )
+{
+	SInt32 theDirID = 0;
+	Boolean isDirectory = false;
+	ThrowIfOSErr_( ::FSpGetDirectoryID( &inFolder, &theDirID, &isDirectory ) );
+	ThrowIf_( !isDirectory );
+	
+	// open the manifest.
+	FSSpec theManifestFile;
+	ThrowIfOSErr_( ::FSMakeFSSpec( inFolder.vRefNum, theDirID, unpack_ManifestName,
+								   &theManifestFile ) );
+	CTextFileStream theManifest( theManifestFile );
+	theManifest.OpenDataFork( fsRdPerm );
+	
+	// check the first line.
+	char theLine[256];
+	theManifest.GetLine( theLine, 255 );
+	char* theTokens = theLine;
+	ThrowIf_( LStr255( NextToken( theTokens ) ) != LStr255( unpack_ManifestIdent ) );
+	Boolean isDemoLayout = (NextNumber( theTokens ) != 0);
+	SInt32 theNumClasses = NextNumber( theTokens );
+	ThrowIf_( (theNumClasses < 0) || (theNumClasses > 32767) );
+	
+	StDeleter<CWailSoundFileData> theData( new CWailSoundFileData );
+	theData->mDemoLayout = isDemoLayout;
+	theData->mSoundClasses.AdjustAllocation( theNumClasses );
+	
+	for (SInt32 i = 1; i <= theNumClasses; i++)
+	{
+		// read the class's description. classes must be in order.
+		theManifest.GetLine( theLine, 255 );
+		theTokens = theLine;
+		ThrowIf_( NextNumber( theTokens ) != i );
+		
+		CWailSoundClass* theClass = new CWailSoundClass;
+		theData->mSoundClasses.AddItem( theClass );
+			// the data now owns the class.
+		
+		theClass->mClassID = NextNumber( theTokens );
+		theClass->mVolume = NextNumber( theTokens );
+		theClass->mFlags = NextNumber( theTokens );
+		theClass->mChance = NextNumber( theTokens );
+		theClass->mLowPitch = NextNumber( theTokens );
+		theClass->mHighPitch = NextNumber( theTokens );
+		SInt32 theNum8bitSounds = NextNumber( theTokens );
+		SInt32 theNum16bitSounds = NextNumber( theTokens );
+		theClass->mRemap8bit = (NextNumber( theTokens ) != 0);
+		ThrowIf_( (theNum8bitSounds < 0) || (theNum8bitSounds > 5) ||
+				  (theNum16bitSounds < 0) || (theNum16bitSounds > 5) );
+		
+		// read its sounds. counts are only updated as sounds are added, so that the
+		// class can always be deleted safely.
+		SInt16 j;
+		for (j = 0; j < theNum8bitSounds; j++)
+		{
+			LStr255 theName;
+			MakeSoundFileName( i, true, j, theName );
+			theClass->m8bitSounds[j] = ReadSoundFromFile( inFolder.vRefNum, theDirID, theName );
+			theClass->mNum8bitSounds = j + 1;
+		}
+		for (j = 0; j < theNum16bitSounds; j++)
+		{
+			LStr255 theName;
+			MakeSoundFileName( i, false, j, theName );
+			theClass->m16bitSounds[j] = ReadSoundFromFile( inFolder.vRefNum, theDirID, theName );
+			theClass->mNum16bitSounds = j + 1;
+		}
+	}
+	
+	theManifest.CloseDataFork();
+	
+	return theData.Release();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MakeSoundFileName									[static]
+// ---------------------------------------------------------------------------------
+// returns the name of the file that contains a sound of an unpacked sound file. it
+// looks like "C12-8-1" for the first 8-bit sound of the 12th class. inSoundIndex is
+// 0-based, but the name uses 1-based numbers.
+
+void
+UWailBatch::MakeSoundFileName(
+	SInt32		inClassIndex,
+	Boolean		in8bit,
+	SInt16		inSoundIndex,
+	LStr255&	outName )
+{
+	outName = "\pC";
+	outName += inClassIndex;
+	outName += (in8bit ? "\p-8-" : "\p-16-");
+	outName += (SInt32) (inSoundIndex + 1);
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CopySoundToFile									[static]
+// ---------------------------------------------------------------------------------
+// writes a sound in a new file, replacing it if it exists. the sound is copied
+// through the given buffer.
+
+void
+UWailBatch::CopySoundToFile(
+	LStream*		inSound,
+	SInt16			inVRefNum,
+	SInt32			inDirID,
+	ConstStringPtr	inName,
+	Ptr				inBuffer,
+	SInt32			inBufferSize )
+{
+	FSSpec theSpec;
+	OSErr err = ::FSMakeFSSpec( inVRefNum, inDirID, inName, &theSpec );
+	if (err == noErr)
+		ThrowIfOSErr_( ::FSpDelete( &theSpec ) );
+	else if (err != fnfErr)
+		ThrowIfOSErr_( err );
+	
+	LFileStream theFile( theSpec );
+	theFile.CreateNewDataFile( fileCreator_Wail, fileType_WailRawSound );
+	theFile.OpenDataFork( fsRdWrPerm );
+	
+	SInt32 theLeft = inSound->GetLength();
+	theFile.SetLength( theLeft );
+	inSound->SetMarker( 0, streamFrom_Start );
+	while (theLeft > 0)
+	{
+		SInt32 theChunk = (theLeft > inBufferSize) ? inBufferSize : theLeft;
+		inSound->ReadBlock( inBuffer, theChunk );
+		theFile.WriteBlock( inBuffer, theChunk );
+		theLeft -= theChunk;
+	}
+	
+	theFile.CloseDataFork();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ReadSoundFromFile									[static]
+// ---------------------------------------------------------------------------------
+// reads a sound written by CopySoundToFile. the caller owns the returned stream.
+
+LStream*
+UWailBatch::ReadSoundFromFile(
+	SInt16			inVRefNum,
+	SInt32			inDirID,
+	ConstStringPtr	inName )
+{
+	FSSpec theSpec;
+	ThrowIfOSErr_( ::FSMakeFSSpec( inVRefNum, inDirID, inName, &theSpec ) );
+	
+	LFileStream theFile( theSpec );
+	theFile.OpenDataFork( fsRdPerm );
+	
+	SInt32 theLength = theFile.GetLength();
+	StPointerBlock theData( theLength );
+	theFile.ReadBlock( theData, theLength );
+	theFile.CloseDataFork();
+	
+	// this copies the sound in virtual memory.
+	return new CWailSoundStream( theData, theLength );
+}
+
+
+#pragma mark -
+
+// ---------------------------------------------------------------------------------
+//		 RunScript											[static]
+// ---------------------------------------------------------------------------------
+// runs the batch script in the given file. see the top of this file for the syntax.
+// a line that fails is reported and doesn't stop the script.
+
+void
+UWailBatch::RunScript(
+	const FSSpec&	inScriptFile )
+{
+	// open the script.
+	CTextFileStream theScript( inScriptFile );
+	theScript.OpenDataFork( fsRdPerm );
+	
+	// create the report beside it.
+	FSSpec theReportFile;
+	LStr255 theReportName( inScriptFile.name );
+	if (theReportName.Length() > 31 - batchReport_Suffix[0])
+		theReportName[0] = 31 - batchReport_Suffix[0];
+	theReportName += batchReport_Suffix;
+	OSErr err = ::FSMakeFSSpec( inScriptFile.vRefNum,
+								inScriptFile.parID,
+								theReportName,
+								&theReportFile );
+	if (err == noErr)
+		ThrowIfOSErr_( ::FSpDelete( &theReportFile ) );
+	else if (err != fnfErr)
+		ThrowIfOSErr_( err );
+	
+	LFileStream theReport( theReportFile );
+	theReport.CreateNewDataFile( fileCreator_Wail, fileType_Text );
+	theReport.OpenDataFork( fsRdWrPerm );
+	
+	// we don't want progress dialogs popping up while we work.
+	Boolean wasQuiet = CWailProgressDialog::IsQuiet();
+	CWailProgressDialog::SetQuiet( true );
+	
+	try
+	{
+		StPointerBlock theLine( batchScript_MaxLine + 1 );
+		SInt32 theLineNumber = 0;
+		while (!theScript.AtEnd())
+		{
+			theScript.GetLine( theLine, batchScript_MaxLine - 1 );
+			++theLineNumber;
+			
+			// skip comments and empty lines.
+			char* theArguments = theLine;
+			char* theCommand = NextToken( theArguments );
+			if ((*theCommand == '\0') || (*theCommand == '#'))
+				continue;
+			
+			// run the command and report how it went.
+			LStr255 theDetails;
+			Boolean isGood = true;
+			try
+			{
+				RunCommand( inScriptFile, theCommand, theArguments, theDetails );
+			}
+			
+			catch (ExceptionCode catchedErr)
+			{
+				isGood = false;
+				theDetails = "\perr=";
+				theDetails += (SInt32) catchedErr;
+			}
+			
+			catch (...)
+			{
+				// something other than a toolbox error (a bad_alloc, say). it still
+				// only fails this line.
+				isGood = false;
+				theDetails = "\perr=unknown";
+			}
+			
+			WriteReportLine( theReport, theLineNumber, isGood, theCommand, theDetails );
+		}
+	}
+	
+	catch (...)
+	{
+		CWailProgressDialog::SetQuiet( wasQuiet );
+		throw;
+	}
+	
+	CWailProgressDialog::SetQuiet( wasQuiet );
+	
+	theReport.CloseDataFork();
+	theScript.CloseDataFork();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 RunCommand										[static]
+// ---------------------------------------------------------------------------------
+// runs one command of a batch script. outDetails receives the key=value pairs to put
+// in the report. throws if anything goes wrong.
+
+void
+UWailBatch::RunCommand(
+	const FSSpec&	inScriptFile,
+	const char*		inCommand,
+	char*			inArguments,
+	LStr255&		outDetails )
+{
+	LStr255 theCommand( inCommand );
+	
+	// make sure we know the command before doing anything.
+	Boolean isCompare = (theCommand == "\pcompare");
+	Boolean isDeltaShuttle = (theCommand == "\pdeltashuttle");
+	Boolean isDeltaPatch = (theCommand == "\pdeltapatch");
+	Boolean isDiff = (theCommand == "\pdiff");
+	Boolean isMatrix = (theCommand == "\pmatrix");
+	Boolean isMerge = (theCommand == "\pmerge");
+	Boolean isPack = (theCommand == "\ppack");
+	Boolean isPatch = (theCommand == "\ppatch");
+	Boolean isUnpack = (theCommand == "\punpack");
+	if (!isCompare && !isDeltaShuttle && !isDeltaPatch && !isDiff && !isMatrix && !isMerge &&
+		!isPack && !isPatch && !isUnpack &&
+		(theCommand != "\pcopy") &&
+		(theCommand != "\pdedup") &&
+		(theCommand != "\pstrip16") &&
+		(theCommand != "\pmake8bit") &&
+		(theCommand != "\pshuttle"))
+	{
+		Throw_( paramErr );
+	}
+	
+	// the matrix takes any number of files, so its report comes first.
+	if (isMatrix)
+	{
+		FSSpec theReportFile;
+		OSErr err = ::FSMakeFSSpec( inScriptFile.vRefNum, inScriptFile.parID,
+									LStr255( NextToken( inArguments ) ), &theReportFile );
+		if (err != fnfErr)
+			ThrowIfOSErr_( err );
+		
+		TArray<FSSpec> theFiles;
+		while (*inArguments != '\0')
+		{
+			FSSpec theFile;
+			MakeSpecFromPath( inScriptFile, NextToken( inArguments ), theFile );
+			theFiles.AddItem( theFile );
+		}
+		ThrowIf_( theFiles.GetCount() < 2 );
+		
+		SInt32 theNumDifferent = MatchSoundFiles( theFiles, theReportFile );
+		outDetails = "\pdiffclasses=";
+		outDetails += theNumDifferent;
+		return;
+	}
+	
+	// all other commands start with a sound file (or folder), and end with an output file
+	// (or folder).
+	FSSpec theFile, theOtherFile, theThirdFile, theOutFile;
+	MakeSpecFromPath( inScriptFile, NextToken( inArguments ), theFile );
+	if (isCompare || isDeltaShuttle || isDeltaPatch || isDiff || isMerge)
+		MakeSpecFromPath( inScriptFile, NextToken( inArguments ), theOtherFile );
+	if (isMerge)
+		MakeSpecFromPath( inScriptFile, NextToken( inArguments ), theThirdFile );
+	
+	// the output file usually doesn't exist yet.
+	const char* theOutPath = NextToken( inArguments );
+	ThrowIf_( *theOutPath == '\0' );
+	OSErr err = ::FSMakeFSSpec( inScriptFile.vRefNum, inScriptFile.parID,
+								LStr255( theOutPath ), &theOutFile );
+	if (err != fnfErr)
+		ThrowIfOSErr_( err );
+	
+	// shuttles and patches can be compressed.
+	Boolean isCompressed = false;
+	if (isDeltaShuttle || isDeltaPatch || isPatch || (theCommand == "\pshuttle"))
+	{
+		const char* theOption = NextToken( inArguments );
+		if (*theOption != '\0')
+		{
+			ThrowIf_( LStr255( theOption ) != "\pcompress" );
+			isCompressed = true;
+		}
+	}
+	
+	// 8-bit sounds can be dithered.
+	Boolean isDithered = false;
+	if (theCommand == "\pmake8bit")
+	{
+		const char* theOption = NextToken( inArguments );
+		if (*theOption != '\0')
+		{
+			ThrowIf_( LStr255( theOption ) != "\pdither" );
+			isDithered = true;
+		}
+	}
+	
+	// we can't write over a file we're reading.
+	ThrowIf_( (theOutFile.vRefNum == theFile.vRefNum) &&
+			  (theOutFile.parID == theFile.parID) &&
+			  ::EqualString( theOutFile.name, theFile.name, false, true ) );
+	
+	// merging needs three files, and maybe writes a report.
+	if (isMerge)
+	{
+		FSSpec theReportFile;
+		const FSSpec* theReport = nil;
+		const char* theReportPath = NextToken( inArguments );
+		if (*theReportPath != '\0')
+		{
+			err = ::FSMakeFSSpec( inScriptFile.vRefNum, inScriptFile.parID,
+								  LStr255( theReportPath ), &theReportFile );
+			if (err != fnfErr)
+				ThrowIfOSErr_( err );
+			theReport = &theReportFile;
+		}
+		
+		SInt32 theNumConflicts = MergeSoundFiles( theFile, theOtherFile, theThirdFile,
+												  theOutFile, theReport );
+		outDetails = "\pconflicts=";
+		outDetails += theNumConflicts;
+		return;
+	}
+	
+	// diffing works on the files themselves.
+	if (isDiff)
+	{
+		SInt32 theNumChanged = DiffSoundFiles( theFile, theOtherFile, theOutFile );
+		outDetails = "\pchangedclasses=";
+		outDetails += theNumChanged;
+		return;
+	}
+	
+	// packing builds its data from a folder; others load a sound file. when unpacking,
+	// we only need to look at each sound once, so don't load them all.
+	StDeleter<CWailSoundFileData> theData( isPack ? PackSoundFile( theFile )
+												  : LoadSoundFile( theFile, isUnpack ) );
+	
+	if (isPack)
+	{
+		SaveSoundFile( *theData, theOutFile );
+		outDetails = "\pclasses=";
+		outDetails += theData->mSoundClasses.GetCount();
+	}
+	else if (isUnpack)
+	{
+		SInt32 theNumSounds = UnpackSoundFile( *theData, theOutFile );
+		outDetails = "\psounds=";
+		outDetails += theNumSounds;
+	}
+	else if (theCommand == "\pcopy")
+	{
+		SaveSoundFile( *theData, theOutFile );
+		outDetails = "\pclasses=";
+		outDetails += CountNonEmptyClasses( *theData );
+	}
+	else if (theCommand == "\pdedup")
+	{
+		SInt32 theBytesSaved = 0;
+		SaveSoundFile( *theData, theOutFile, saveFlag_Deduplicate, &theBytesSaved );
+		outDetails = "\pbytessaved=";
+		outDetails += theBytesSaved;
+	}
+	else if (theCommand == "\pcompare")
+	{
+		StDeleter<CWailSoundFileData> theOtherData( LoadSoundFile( theOtherFile ) );
+		theData->CompareAndKeepOnlyDiffs( *theOtherData );
+		SaveSoundFile( *theData, theOutFile );
+		outDetails = "\pdiffclasses=";
+		outDetails += CountNonEmptyClasses( *theData );
+	}
+	else if (theCommand == "\pstrip16")
+	{
+		SInt32 theNumStripped = Strip16bitSounds( *theData );
+		SaveSoundFile( *theData, theOutFile );
+		outDetails = "\pstrippedclasses=";
+		outDetails += theNumStripped;
+	}
+	else if (theCommand == "\pmake8bit")
+	{
+		SInt32 theNumConverted = Make8bitSounds( *theData, isDithered );
+		SaveSoundFile( *theData, theOutFile );
+		outDetails = "\pconvertedclasses=";
+		outDetails += theNumConverted;
+	}
+	else if (isPatch || isDeltaPatch)
+	{
+		SInt32 theNumDeltas = MakeShuttlePatch( *theData, theOutFile,
+												isDeltaPatch ? &theOtherFile : nil, isCompressed );
+		outDetails = "\pclasses=";
+		outDetails += CountNonEmptyClasses( *theData );
+		outDetails += "\p\tdeltas=";
+		outDetails += theNumDeltas;
+	}
+	else if (isDeltaShuttle)
+	{
+		SInt32 theNumDeltas = MakeShuttle( *theData, theOutFile, &theOtherFile, isCompressed );
+		outDetails = "\pclasses=";
+		outDetails += CountNonEmptyClasses( *theData );
+		outDetails += "\p\tdeltas=";
+		outDetails += theNumDeltas;
+	}
+	else	// shuttle
+	{
+		MakeShuttle( *theData, theOutFile, nil, isCompressed );
+		outDetails = "\pclasses=";
+		outDetails += CountNonEmptyClasses( *theData );
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 NextToken											[static]
+// ---------------------------------------------------------------------------------
+// returns the next tab-separated token of the given line and moves ioLine past it.
+// the token is terminated in place. returns an empty string if there's none left.
+
+char*
+UWailBatch::NextToken(
+	char*&	ioLine )
+{
+	char* theToken = ioLine;
+	
+	while ((*ioLine != '\0') && (*ioLine != '\t'))
+		++ioLine;
+	
+	if (*ioLine == '\t')
+	{
+		*ioLine = '\0';
+		++ioLine;
+	}
+	
+	return theToken;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 NextNumber										[static]
+// ---------------------------------------------------------------------------------
+// same as NextToken, but converts the token to a number. throws if there's none.
+
+SInt32
+UWailBatch::NextNumber(
+	char*&	ioLine )
+{
+	const char* theToken = NextToken( ioLine );
+	ThrowIf_( *theToken == '\0' );
+	
+	SInt32 theNumber = 0;
+	::StringToNum( LStr255( theToken ), &theNumber );
+	
+	return theNumber;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 MakeSpecFromPath									[static]
+// ---------------------------------------------------------------------------------
+// makes a spec for an existing file from a path found in the given script.
+
+void
+UWailBatch::MakeSpecFromPath(
+	const FSSpec&	inScriptFile,
+	const char*		inPath,
+	FSSpec&			outSpec )
+{
+	// an empty path would give us the script's folder.
+	ThrowIf_( *inPath == '\0' );
+	
+	ThrowIfOSErr_( ::FSMakeFSSpec( inScriptFile.vRefNum,
+								   inScriptFile.parID,
+								   LStr255( inPath ),
+								   &outSpec ) );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 WriteReportLine									[static]
+// ---------------------------------------------------------------------------------
+// writes one line in the report of a script.
+
+void
+UWailBatch::WriteReportLine(
+	LStream&		inReport,
+	SInt32			inLineNumber,
+	Boolean			inSucceeded,
+	const char*		inCommand,
+	ConstStringPtr	inDetails )
+{
+	LStr255 theLine( inLineNumber );
+	theLine += "\p\t";
+	theLine += (inSucceeded ? "\pok" : "\perror");
+	theLine += "\p\t";
+	theLine += LStr255( inCommand );
+	theLine += "\p\t";
+	theLine += inDetails;
+	theLine += "\p\r";
+	
+	inReport.WriteBlock( theLine.TextPtr(), theLine.Length() );
+}
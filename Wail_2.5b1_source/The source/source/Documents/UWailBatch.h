@@ -0,0 +1,181 @@
+// =================================================================================
+//	UWailBatch.h					2003, Charles Lechasseur
+// =================================================================================
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <LString.h>
+#include <TArray.h>
+
+#include "CInFileStream.h"
+#include "CWailSoundFileData.h"
+#include "WailShuttleConstants.h"
+#include "WailTypes.h"
+
+
+// batch script file type. a batch script is a text file with this type.
+
+const OSType	fileType_WailBatchScript			= 'WBat';
+
+// type of the files containing sounds of an unpacked sound file. these are raw
+// Marathon sounds, as stored in sound files.
+
+const OSType	fileType_WailRawSound				= 'WSnd';
+
+
+// UWailBatch class
+
+class UWailBatch
+{
+	public:
+
+		// operations on sound files. none of these use windows or dialogs.
+
+		static CWailSoundFileData*	LoadSoundFile(
+										const FSSpec&		inFile,
+										Boolean				inStreamSounds = false );
+		static void					SaveSoundFile(
+										CWailSoundFileData&	inData,
+										const FSSpec&		inFile,
+										UInt32				inSaveFlags = saveFlag_None,
+										SInt32				*outBytesSaved = nil,
+										OSType				inFileType = fileType_MarathonInfinitySound,
+										OSType				inFileCreator = fileCreator_MarathonInfinitySound );
+		static SInt32				MakeShuttle(
+										CWailSoundFileData&	inData,
+										const FSSpec&		inShuttleFile,
+										const FSSpec*		inSourceFile = nil,
+										Boolean				inCompress = false );
+		static SInt32				MakeShuttlePatch(
+										CWailSoundFileData&	inData,
+										const FSSpec&		inPatchFile,
+										const FSSpec*		inSourceFile = nil,
+										Boolean				inCompress = false );
+		static SInt32				Strip16bitSounds(
+										CWailSoundFileData&	ioData );
+		static SInt32				Make8bitSounds(
+										CWailSoundFileData&	ioData,
+										Boolean				inDither = false );
+		static SInt32				CountNonEmptyClasses(
+										const CWailSoundFileData& inData );
+		static SInt32				DiffSoundFiles(
+										const FSSpec&		inOldFile,
+										const FSSpec&		inNewFile,
+										const FSSpec&		inReportFile );
+		static SInt32				MatchSoundFiles(
+										const TArray<FSSpec>& inFiles,
+										const FSSpec&		inReportFile );
+		static SInt32				MergeSoundFiles(
+										const FSSpec&		inBaseFile,
+										const FSSpec&		inOurFile,
+										const FSSpec&		inTheirFile,
+										const FSSpec&		inOutFile,
+										const FSSpec*		inReportFile = nil );
+
+		// unpacking sound files to folders, and back.
+
+		static SInt32				UnpackSoundFile(
+										CWailSoundFileData&	inData,
+										const FSSpec&		inFolder );
+		static CWailSoundFileData*	PackSoundFile(
+										const FSSpec&		inFolder );
+
+		// batch scripts
+
+		static void					RunScript(
+										const FSSpec&		inScriptFile );
+
+	protected:
+
+		static CWailSoundFileData*	PrepareShuttleDelta(
+										CWailSoundFileData&	inData,
+										const FSSpec&		inSourceFile,
+										SShuttleDeltaHeader& outHeader,
+										TArray<SShuttleDeltaEntry>& outEntries );
+		static SShuttleDataInfo		WriteShuttleData(
+										CInFileStream&		ioFile,
+										CWailSoundFileData&	inData,
+										Boolean				inCompress,
+										const SShuttleDeltaHeader* inDeltaHeader,
+										const TArray<SShuttleDeltaEntry>& inDeltaEntries );
+		static CWailSoundFileData*	MakeShuttleDelta(
+										CWailSoundFileData&	inData,
+										CWailSoundFileData&	inSourceData,
+										TArray<SShuttleDeltaEntry>& outEntries );
+		static LStream*				Make8bitSound(
+										LStream&			in16bitSound,
+										Boolean				inDither,
+										UInt32&				ioDitherSeed );
+		static void					MakeDeltaSoundSet(
+										SInt32				inClassIndex,
+										SInt16				inSet,
+										SInt16				inNumSounds,
+										LStream* const		inSounds[5],
+										SInt16				inNumSourceSounds,
+										LStream* const		inSourceSounds[5],
+										LStream*			outSounds[5],
+										TArray<SShuttleDeltaEntry>& ioEntries );
+
+		static void					MakeSoundFileName(
+										SInt32				inClassIndex,
+										Boolean				in8bit,
+										SInt16				inSoundIndex,
+										LStr255&			outName );
+		static void					CopySoundToFile(
+										LStream*			inSound,
+										SInt16				inVRefNum,
+										SInt32				inDirID,
+										ConstStringPtr		inName,
+										Ptr					inBuffer,
+										SInt32				inBufferSize );
+		static LStream*				ReadSoundFromFile(
+										SInt16				inVRefNum,
+										SInt32				inDirID,
+										ConstStringPtr		inName );
+
+		static void					RunCommand(
+										const FSSpec&		inScriptFile,
+										const char*			inCommand,
+										char*				inArguments,
+										LStr255&			outDetails );
+		static char*				NextToken(
+										char*&				ioLine );
+		static SInt32				NextNumber(
+										char*&				ioLine );
+		static void					MakeSpecFromPath(
+										const FSSpec&		inScriptFile,
+										const char*			inPath,
+										FSSpec&				outSpec );
+		static void					WriteReportLine(
+										LStream&			inReport,
+										SInt32				inLineNumber,
+										Boolean				inSucceeded,
+										const char*			inCommand,
+										ConstStringPtr		inDetails );
+};
@@ -0,0 +1,201 @@
+// =================================================================================
+//	UWailSamples.cp					2003, Charles Lechasseur
+// =================================================================================
+//
+// UWailSamples converts sound samples between the formats Wail deals with: Marathon
+// and the Sound Manager use offset binary 8-bit samples and big-endian 16-bit
+// samples, AIFF files use two's complement samples, and some AIFF-C files use
+// little-endian ones.
+//
+// all conversions work between two buffers or in place (pass the same buffer
+// twice). the conversions done for every byte (sign flips and swaps) work on 4 bytes
+// at a time once the buffers are aligned.
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include "UWailSamples.h"
+
+
+// ---------------------------------------------------------------------------------
+//		 FlipSign8											[static]
+// ---------------------------------------------------------------------------------
+// converts 8-bit samples from offset binary to two's complement, or back: both only
+// differ by their high bit.
+
+void
+UWailSamples::FlipSign8(
+	const void*	inSamples,
+	void*		outSamples,
+	SInt32		inNumSamples )
+{
+	const UInt8* theIn = (const UInt8*) inSamples;
+	UInt8* theOut = (UInt8*) outSamples;
+	SInt32 i = 0;
+	
+	// if both buffers can be aligned together, do bytes until they are, then words.
+	if ((((unsigned long) theIn ^ (unsigned long) theOut) & 3) == 0)
+	{
+		while ((i < inNumSamples) && (((unsigned long) (theIn + i) & 3) != 0))
+		{
+			theOut[i] = (UInt8) (theIn[i] ^ 0x80);
+			i++;
+		}
+	
+		const UInt32* theInWords = (const UInt32*) (theIn + i);
+		UInt32* theOutWords = (UInt32*) (theOut + i);
+		SInt32 numWords = (inNumSamples - i) / 4;
+		for (SInt32 j = 0; j < numWords; j++)
+			theOutWords[j] = theInWords[j] ^ 0x80808080UL;
+		i += numWords * 4;
+	}
+	
+	for (; i < inNumSamples; i++)
+		theOut[i] = (UInt8) (theIn[i] ^ 0x80);
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Swap16											[static]
+// ---------------------------------------------------------------------------------
+// swaps the bytes of 16-bit samples.
+
+void
+UWailSamples::Swap16(
+	const void*	inSamples,
+	void*		outSamples,
+	SInt32		inNumSamples )
+{
+	const UInt8* theIn = (const UInt8*) inSamples;
+	UInt8* theOut = (UInt8*) outSamples;
+	SInt32 i = 0;
+	
+	if ((((unsigned long) theIn ^ (unsigned long) theOut) & 3) == 0)
+	{
+		while ((i < inNumSamples) && (((unsigned long) (theIn + (i * 2)) & 3) != 0))
+		{
+			UInt8 theByte = theIn[i * 2];
+			theOut[i * 2] = theIn[(i * 2) + 1];
+			theOut[(i * 2) + 1] = theByte;
+			i++;
+		}
+	
+		// two samples per word.
+		const UInt32* theInWords = (const UInt32*) (theIn + (i * 2));
+		UInt32* theOutWords = (UInt32*) (theOut + (i * 2));
+		SInt32 numWords = (inNumSamples - i) / 2;
+		for (SInt32 j = 0; j < numWords; j++)
+		{
+			UInt32 theWord = theInWords[j];
+			theOutWords[j] = ((theWord >> 8) & 0x00FF00FFUL) | ((theWord << 8) & 0xFF00FF00UL);
+		}
+		i += numWords * 2;
+	}
+	
+	for (; i < inNumSamples; i++)
+	{
+		UInt8 theByte = theIn[i * 2];
+		theOut[i * 2] = theIn[(i * 2) + 1];
+		theOut[(i * 2) + 1] = theByte;
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 BigEndianToNative16								[static]
+// ---------------------------------------------------------------------------------
+// converts big-endian 16-bit samples, like those of Marathon sounds, to samples we
+// can compute with. on the Mac, they're the same.
+
+void
+UWailSamples::BigEndianToNative16(
+	const void*	inSamples,
+	SInt16*		outSamples,
+	SInt32		inNumSamples )
+{
+#if TARGET_RT_LITTLE_ENDIAN
+	Swap16( inSamples, outSamples, inNumSamples );
+#else
+	if (inSamples != outSamples)
+		::BlockMoveData( inSamples, outSamples, inNumSamples * sizeof(SInt16) );
+#endif
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Narrow16To8										[static]
+// ---------------------------------------------------------------------------------
+// converts 16-bit samples to 8-bit offset binary samples, rounding to the nearest.
+
+void
+UWailSamples::Narrow16To8(
+	const SInt16*	inSamples,
+	UInt8*			outSamples,
+	SInt32			inNumSamples )
+{
+	for (SInt32 i = 0; i < inNumSamples; i++)
+	{
+		// 32768 makes it offset binary, and 128 rounds it.
+		SInt32 theSample = (((SInt32) inSamples[i]) + 32768L + 128L) >> 8;
+		if (theSample > 255)
+			theSample = 255;
+		outSamples[i] = (UInt8) theSample;
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Narrow16To8Dithered								[static]
+// ---------------------------------------------------------------------------------
+// like Narrow16To8, but adds triangular noise of up to one 8-bit step before
+// truncating, so that quiet sounds hiss a little instead of turning into steps.
+// ioSeed is the state of the noise; pass the same one from call to call.
+
+void
+UWailSamples::Narrow16To8Dithered(
+	const SInt16*	inSamples,
+	UInt8*			outSamples,
+	SInt32			inNumSamples,
+	UInt32&			ioSeed )
+{
+	UInt32 theSeed = ioSeed;
+	for (SInt32 i = 0; i < inNumSamples; i++)
+	{
+		// two 8-bit random values from a linear congruential generator; their
+		// difference is triangular, between -255 and 255. 128 centers it like the
+		// rounding in Narrow16To8.
+		theSeed = (theSeed * 1664525UL) + 1013904223UL;
+		SInt32 theNoise = (SInt32) ((theSeed >> 24) & 0xFF) - (SInt32) ((theSeed >> 16) & 0xFF);
+		
+		SInt32 theSample = (((SInt32) inSamples[i]) + 32768L + 128L + theNoise) >> 8;
+		if (theSample > 255)
+			theSample = 255;
+		else if (theSample < 0)
+			theSample = 0;
+		outSamples[i] = (UInt8) theSample;
+	}
+	ioSeed = theSeed;
+}
@@ -0,0 +1,69 @@
+// =================================================================================
+//	UWailSamples.h					2003, Charles Lechasseur
+// =================================================================================
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+
+// UWailSamples class
+
+class UWailSamples
+{
+	public:
+		
+		// 8-bit samples: offset binary (Marathon, Sound Manager) <-> two's complement (AIFF).
+		
+		static void				FlipSign8(
+									const void*		inSamples,
+									void*			outSamples,
+									SInt32			inNumSamples );
+		
+		// 16-bit samples: big-endian <-> little-endian.
+		
+		static void				Swap16(
+									const void*		inSamples,
+									void*			outSamples,
+									SInt32			inNumSamples );
+		static void				BigEndianToNative16(
+									const void*		inSamples,
+									SInt16*			outSamples,
+									SInt32			inNumSamples );
+		
+		// 16-bit native samples -> 8-bit offset binary samples.
+		
+		static void				Narrow16To8(
+									const SInt16*	inSamples,
+									UInt8*			outSamples,
+									SInt32			inNumSamples );
+		static void				Narrow16To8Dithered(
+									const SInt16*	inSamples,
+									UInt8*			outSamples,
+									SInt32			inNumSamples,
+									UInt32&			ioSeed );
+};
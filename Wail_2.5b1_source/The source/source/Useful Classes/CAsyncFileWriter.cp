@@ -0,0 +1,208 @@
+// =================================================================================
+//	CAsyncFileWriter.cp					2003, Charles Lechasseur
+// =================================================================================
+//
+// writes data to an open file using asynchronous File Manager calls. each write
+// specifies its own position in the file, so writes don't depend on each other
+// and several of them can be queued at once. this lets the caller prepare the next
+// block of data while the previous ones are being written.
+//
+// buffers given to WriteAt must remain valid until the write is done. if a buffer
+// is given as inBufferToDispose, we take ownership of it and dispose of it once
+// the write is complete.
+//
+// errors are reported by WaitForAll (and by WriteAt, when a slot is reused). the
+// destructor waits for all pending writes but ignores errors, so always call
+// WaitForAll when done.
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include "CAsyncFileWriter.h"
+
+
+// ---------------------------------------------------------------------------
+//	 CAsyncFileWriter						Constructor	[public]
+// ---------------------------------------------------------------------------
+// inFileRefNum must be the ref num of a file opened with write permission.
+// inBaseOffset is added to all offsets given to WriteAt; this is useful when
+// writing inside another file (see CInFileStream).
+
+CAsyncFileWriter::CAsyncFileWriter(
+	SInt16	inFileRefNum,
+	SInt32	inBaseOffset,
+	SInt16	inMaxPending )
+	: mFileRefNum( inFileRefNum ),
+	  mBaseOffset( inBaseOffset ),
+	  mMaxPending( inMaxPending ),
+	  mNextWrite( 0 ),
+	  mWrites( nil ),
+	  mError( noErr )
+{
+	ThrowIf_( mMaxPending <= 0 );
+
+	mWrites = (SPendingWrite*) ::NewPtrClear( sizeof(SPendingWrite) * mMaxPending );
+	ThrowIfMemFail_( mWrites );
+}
+
+
+// ---------------------------------------------------------------------------
+//	 ~CAsyncFileWriter						Destructor	[public]
+// ---------------------------------------------------------------------------
+
+CAsyncFileWriter::~CAsyncFileWriter()
+{
+	// we can't let the File Manager write with our param blocks once they're gone.
+	for (SInt16 i = 0; i < mMaxPending; i++)
+		WaitFor( mWrites[i] );
+
+	::DisposePtr( (Ptr) mWrites );
+}
+
+
+// ---------------------------------------------------------------------------
+//		 WriteAt
+// ---------------------------------------------------------------------------
+// queues a write of inLength bytes from inBuffer at inOffset in the file.
+// if all our slots are busy, we wait for the oldest write to finish.
+
+void
+CAsyncFileWriter::WriteAt(
+	SInt32		inOffset,
+	const void*	inBuffer,
+	SInt32		inLength,
+	Ptr			inBufferToDispose )
+{
+	// get next slot. wait for it if it's still busy.
+	SPendingWrite& theWrite = mWrites[mNextWrite];
+	WaitFor( theWrite );
+	mNextWrite = (mNextWrite + 1) % mMaxPending;
+
+	// if a previous write failed, there's no point in going on.
+	if (mError != noErr)
+	{
+		if (inBufferToDispose != nil)
+			::DisposePtr( inBufferToDispose );
+		ThrowIfOSErr_( mError );
+	}
+
+	// set up the param block.
+	ParamBlockRec& thePB = theWrite.mParamBlock;
+	thePB.ioParam.ioCompletion = nil;
+	thePB.ioParam.ioRefNum = mFileRefNum;
+	thePB.ioParam.ioBuffer = (Ptr) inBuffer;
+	thePB.ioParam.ioReqCount = inLength;
+	thePB.ioParam.ioPosMode = fsFromStart;
+	thePB.ioParam.ioPosOffset = mBaseOffset + inOffset;
+
+	theWrite.mInUse = true;
+	theWrite.mBufferToDispose = inBufferToDispose;
+
+	// queue the write. errors will be collected when we wait for it.
+	::PBWriteAsync( &thePB );
+}
+
+
+// ---------------------------------------------------------------------------
+//		 WaitForAll
+// ---------------------------------------------------------------------------
+// waits for all pending writes and throws if any of them failed.
+
+void
+CAsyncFileWriter::WaitForAll()
+{
+	for (SInt16 i = 0; i < mMaxPending; i++)
+		WaitFor( mWrites[i] );
+
+	OSErr err = mError;
+	mError = noErr;
+	ThrowIfOSErr_( err );
+}
+
+
+// ---------------------------------------------------------------------------
+//		 Flush
+// ---------------------------------------------------------------------------
+// waits for all pending writes, then asks the File Manager to flush the file
+// to disk.
+
+void
+CAsyncFileWriter::Flush()
+{
+	WaitForAll();
+
+	FlushFile( mFileRefNum );
+}
+
+
+// ---------------------------------------------------------------------------
+//		 FlushFile											[static]
+// ---------------------------------------------------------------------------
+// asks the File Manager to flush the given open file to disk.
+
+void
+CAsyncFileWriter::FlushFile(
+	SInt16	inFileRefNum )
+{
+	ParamBlockRec thePB;
+	thePB.ioParam.ioCompletion = nil;
+	thePB.ioParam.ioRefNum = inFileRefNum;
+	ThrowIfOSErr_( ::PBFlushFileSync( &thePB ) );
+}
+
+
+// ---------------------------------------------------------------------------
+//		 WaitFor
+// ---------------------------------------------------------------------------
+// waits until the given write is complete, then frees its slot. remembers the
+// first error that occurs.
+
+void
+CAsyncFileWriter::WaitFor(
+	SPendingWrite&	ioWrite )
+{
+	if (ioWrite.mInUse)
+	{
+		// ioResult stays positive while the request is queued or in progress.
+		while (ioWrite.mParamBlock.ioParam.ioResult > 0)
+			;	// nothing to do but wait.
+
+		OSErr err = ioWrite.mParamBlock.ioParam.ioResult;
+		if ((err == noErr) && (ioWrite.mParamBlock.ioParam.ioActCount !=
+							   ioWrite.mParamBlock.ioParam.ioReqCount))
+			err = ioErr;
+		if (mError == noErr)
+			mError = err;
+
+		if (ioWrite.mBufferToDispose != nil)
+		{
+			::DisposePtr( ioWrite.mBufferToDispose );
+			ioWrite.mBufferToDispose = nil;
+		}
+
+		ioWrite.mInUse = false;
+	}
+}
@@ -0,0 +1,100 @@
+// =================================================================================
+//	CAsyncFileWriter.h					2003, Charles Lechasseur
+// =================================================================================
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <Files.h>
+
+
+// default number of writes that can be pending at the same time.
+
+const SInt16	default_MaxPendingWrites	= 8;
+
+
+class CAsyncFileWriter
+{
+	public:
+	// Public Functions
+
+		//Constructor
+
+								CAsyncFileWriter(
+									SInt16			inFileRefNum,
+									SInt32			inBaseOffset = 0,
+									SInt16			inMaxPending = default_MaxPendingWrites );
+
+		//Destructor
+
+		virtual					~CAsyncFileWriter();
+
+		// writing
+
+		void					WriteAt(
+									SInt32			inOffset,
+									const void*		inBuffer,
+									SInt32			inLength,
+									Ptr				inBufferToDispose = nil );
+		void					WaitForAll();
+
+		// flushing
+
+		void					Flush();
+
+		static void				FlushFile(
+									SInt16			inFileRefNum );
+
+	protected:
+
+		// a pending write. the param block must stay alive until the write is done.
+
+		struct SPendingWrite
+		{
+			ParamBlockRec		mParamBlock;
+			Boolean				mInUse;
+			Ptr					mBufferToDispose;
+		};
+
+		void					WaitFor(
+									SPendingWrite&	ioWrite );
+
+	private:
+	// Member Variables
+
+		SInt16					mFileRefNum;	// file we write to.
+		SInt32					mBaseOffset;	// added to all offsets.
+		SInt16					mMaxPending;	// number of slots in mWrites.
+		SInt16					mNextWrite;		// next slot to use.
+		SPendingWrite*			mWrites;		// our slots.
+		OSErr					mError;			// first error that occured.
+
+		// Defensive programming. No copy constructor nor operator=
+								CAsyncFileWriter(const CAsyncFileWriter&);
+		CAsyncFileWriter&		operator=(const CAsyncFileWriter&);
+};
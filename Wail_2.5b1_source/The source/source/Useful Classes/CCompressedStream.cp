@@ -0,0 +1,557 @@
+// =================================================================================
+//	CCompressedStream.cp					2003, Charles Lechasseur
+// =================================================================================
+//
+// A read-only stream that decompresses data written by CCompressedStream::Compress.
+//
+// Data is compressed in blocks of compressed_BlockSize bytes, each on its own, with a
+// small LZ77 codec made to be fast when decompressing. The offset of each block is
+// kept, so reading somewhere only decompresses the blocks that hold what's read; the
+// last one is kept around for the next read. Blocks that don't get smaller are stored
+// as is.
+//
+// Each compressed block is a list of sequences. A sequence starts with a token:
+// its high 4 bits are the number of literals, its low 4 bits the length of the match
+// minus compressed_MinMatch. When a number is 15, bytes follow that are added to it
+// until one isn't 255. Then come the literals, then the offset of the match (16 bits,
+// big-endian, counted back from the current position). The last sequence of a block
+// has no match; it ends when its literals end the block.
+//
+// The compressed stream should remain alive while this one is used.
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include "CCompressedStream.h"
+
+#include <UMemoryMgr.h>
+
+
+// shortest match worth encoding.
+
+const SInt32	compressed_MinMatch		= 4;
+
+// number of entries in the hash table used to find matches when compressing.
+
+const SInt32	compressed_HashBits		= 12;
+const SInt32	compressed_HashSize		= 1L << compressed_HashBits;
+
+
+// ---------------------------------------------------------------------------
+//		 Read32
+// ---------------------------------------------------------------------------
+// reads 4 bytes, one by one since they're not always aligned.
+
+static inline UInt32
+Read32(
+	const UInt8*	inData )
+{
+	return (((UInt32) inData[0]) << 24) | (((UInt32) inData[1]) << 16) |
+		   (((UInt32) inData[2]) << 8) | ((UInt32) inData[3]);
+}
+
+
+// ---------------------------------------------------------------------------
+//		 HashOf
+// ---------------------------------------------------------------------------
+
+static inline SInt32
+HashOf(
+	UInt32	inSequence )
+{
+	return (SInt32) (((UInt32) (inSequence * 2654435761UL)) >> (32 - compressed_HashBits));
+}
+
+
+// ---------------------------------------------------------------------------
+//		 WriteLength
+// ---------------------------------------------------------------------------
+// writes the bytes that follow a token for a number that didn't fit in it.
+// returns the new position.
+
+static SInt32
+WriteLength(
+	SInt32	inLength,
+	UInt8*	outData,
+	SInt32	inPos )
+{
+	if (inLength < 15)
+		return inPos;
+	
+	inLength -= 15;
+	while (inLength >= 255)
+	{
+		outData[inPos++] = 255;
+		inLength -= 255;
+	}
+	outData[inPos++] = (UInt8) inLength;
+	
+	return inPos;
+}
+
+
+// ---------------------------------------------------------------------------
+//		 ReadLength
+// ---------------------------------------------------------------------------
+// reads the bytes that follow a token for a number that didn't fit in it.
+
+static SInt32
+ReadLength(
+	const UInt8*	inData,
+	SInt32			inLength,
+	SInt32&			ioPos )
+{
+	SInt32 theLength = 0;
+	UInt8 theByte;
+	do
+	{
+		ThrowIf_( ioPos >= inLength );
+		theByte = inData[ioPos++];
+		theLength += theByte;
+	}
+	while (theByte == 255);
+	
+	return theLength;
+}
+
+
+// ---------------------------------------------------------------------------
+//		 WriteSequence
+// ---------------------------------------------------------------------------
+// writes a sequence: some literals, followed by a match if inMatchLength isn't 0.
+// returns the new position, or -1 if the sequence doesn't fit.
+
+static SInt32
+WriteSequence(
+	const UInt8*	inLiterals,
+	SInt32			inNumLiterals,
+	SInt32			inMatchOffset,
+	SInt32			inMatchLength,
+	UInt8*			outData,
+	SInt32			inPos,
+	SInt32			inMaxLength )
+{
+	// worst case: token, literals with their length, offset and match length.
+	SInt32 theNeeded = 1 + inNumLiterals + (inNumLiterals / 255) + 1 +
+					   2 + (inMatchLength / 255) + 1;
+	if (inPos + theNeeded > inMaxLength)
+		return -1;
+	
+	SInt32 theMatchCode = (inMatchLength != 0) ? (inMatchLength - compressed_MinMatch) : 0;
+	outData[inPos++] = (UInt8) (((inNumLiterals < 15 ? inNumLiterals : 15) << 4) |
+								 (theMatchCode < 15 ? theMatchCode : 15));
+	
+	inPos = WriteLength( inNumLiterals, outData, inPos );
+	::BlockMoveData( inLiterals, outData + inPos, inNumLiterals );
+	inPos += inNumLiterals;
+	
+	if (inMatchLength != 0)
+	{
+		outData[inPos++] = (UInt8) (inMatchOffset >> 8);
+		outData[inPos++] = (UInt8) (inMatchOffset & 0xFF);
+		inPos = WriteLength( theMatchCode, outData, inPos );
+	}
+	
+	return inPos;
+}
+
+
+// ---------------------------------------------------------------------------
+//	 CCompressedStream						Constructor	[public]
+// ---------------------------------------------------------------------------
+// reads the header and block offsets of the compressed data, which must start at
+// the beginning of the given stream.
+
+CCompressedStream::CCompressedStream(
+	LStream*	inCompressedStream )
+	: mCompressedStream( inCompressedStream ),
+	  mBlockOffsets( nil ),
+	  mBlock( nil ),
+	  mBlockIndex( -1 ),
+	  mBlockLength( 0 ),
+	  mCompressedBlock( nil )
+{
+	SignalIf_( inCompressedStream == nil );
+	
+	mCompressedStream->SetMarker( 0, streamFrom_Start );
+	mCompressedStream->ReadBlock( &mHeader, sizeof(SCompressedHeader) );
+	
+	// we wouldn't know what to do with another version.
+	ThrowIf_( (mHeader.mIdent != compressed_Ident) ||
+			  (mHeader.mVersion != compressed_Version) ||
+			  (mHeader.mLength < 0) ||
+			  (mHeader.mBlockSize <= 0) ||
+			  (mHeader.mNumBlocks != ((mHeader.mLength + mHeader.mBlockSize - 1) / mHeader.mBlockSize)) );
+	
+	// allocate everything before keeping any of it, in case we run out of memory.
+	StPointerBlock theBlockOffsets( (mHeader.mNumBlocks + 1) * sizeof(SInt32) );
+	StPointerBlock theBlock( mHeader.mBlockSize );
+	StPointerBlock theCompressedBlock( mHeader.mBlockSize );
+	
+	mCompressedStream->ReadBlock( theBlockOffsets, (mHeader.mNumBlocks + 1) * sizeof(SInt32) );
+	
+	mBlockOffsets = (SInt32*) theBlockOffsets.Release();
+	mBlock = theBlock.Release();
+	mCompressedBlock = theCompressedBlock.Release();
+	
+	// set our length. (this one is kept in LStream)
+	LStream::SetLength( mHeader.mLength );
+}
+
+
+// ---------------------------------------------------------------------------
+//	 ~CCompressedStream					Destructor	[public]
+// ---------------------------------------------------------------------------
+
+CCompressedStream::~CCompressedStream()
+{
+	if (mBlockOffsets != nil)
+		::DisposePtr( (Ptr) mBlockOffsets );
+	if (mBlock != nil)
+		::DisposePtr( mBlock );
+	if (mCompressedBlock != nil)
+		::DisposePtr( mCompressedBlock );
+}
+
+
+// ---------------------------------------------------------------------------
+//		 SetLength
+// ---------------------------------------------------------------------------
+// Overridden to prevent setting the stream's length. This stream is read-only.
+
+void
+CCompressedStream::SetLength(
+	SInt32	inLength )
+{
+#pragma unused( inLength )
+	
+	SignalStringLiteral_( "Programmer error: setting length of compressed stream" );
+}
+
+
+// ---------------------------------------------------------------------------
+//		 PutBytes
+// ---------------------------------------------------------------------------
+// Overridden to prevent writing to the stream. This stream is read-only.
+
+ExceptionCode
+CCompressedStream::PutBytes(
+	const void*		inBuffer,
+	SInt32&			ioByteCount )
+{
+#pragma unused( inBuffer )
+	
+	SignalStringLiteral_( "Programmer error: writing to a compressed stream" );
+	ioByteCount = 0;
+	return unimpErr;
+}
+
+
+// ---------------------------------------------------------------------------
+//		 GetBytes
+// ---------------------------------------------------------------------------
+// Reads data from the stream, decompressing the blocks it's in as needed.
+
+ExceptionCode
+CCompressedStream::GetBytes(
+	void*			outBuffer,
+	SInt32&			ioByteCount )
+{
+	ExceptionCode err = noErr;
+	SInt32 theMarker = GetMarker();
+	
+	// make sure we don't read past the end.
+	if (theMarker + ioByteCount > GetLength())
+	{
+		ioByteCount = GetLength() - theMarker;
+		err = readErr;
+	}
+	
+	SInt32 theDone = 0;
+	while (theDone < ioByteCount)
+	{
+		SInt32 thePosition = theMarker + theDone;
+		SInt32 theBlock = thePosition / mHeader.mBlockSize;
+		LoadBlock( theBlock );
+	
+		SInt32 theOffset = thePosition - (theBlock * mHeader.mBlockSize);
+		SInt32 theCount = mBlockLength - theOffset;
+		if (theCount > ioByteCount - theDone)
+			theCount = ioByteCount - theDone;
+	
+		::BlockMoveData( mBlock + theOffset, ((char*) outBuffer) + theDone, theCount );
+		theDone += theCount;
+	}
+	
+	LStream::SetMarker( theMarker + ioByteCount, streamFrom_Start );
+	
+	return err;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 LoadBlock
+// ---------------------------------------------------------------------------------
+// reads and decompresses the given block (0-based), unless it's the one we have.
+
+void
+CCompressedStream::LoadBlock(
+	SInt32	inBlock )
+{
+	if (inBlock == mBlockIndex)
+		return;
+	
+	SInt32 theLength = mHeader.mLength - (inBlock * mHeader.mBlockSize);
+	if (theLength > mHeader.mBlockSize)
+		theLength = mHeader.mBlockSize;
+	
+	SInt32 theStart = mBlockOffsets[inBlock];
+	SInt32 theCompressedLength = mBlockOffsets[inBlock + 1] - theStart;
+	ThrowIf_( (theCompressedLength <= 0) || (theCompressedLength > theLength) );
+	
+	// forget the block we have; it'll be overwritten.
+	mBlockIndex = -1;
+	
+	mCompressedStream->SetMarker( theStart, streamFrom_Start );
+	if (theCompressedLength == theLength)
+	{
+		// stored as is.
+		mCompressedStream->ReadBlock( mBlock, theLength );
+	}
+	else
+	{
+		mCompressedStream->ReadBlock( mCompressedBlock, theCompressedLength );
+		DecompressBlock( (const UInt8*) mCompressedBlock, theCompressedLength,
+						 (UInt8*) mBlock, theLength );
+	}
+	
+	mBlockIndex = inBlock;
+	mBlockLength = theLength;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 IsCompressed										[static]
+// ---------------------------------------------------------------------------------
+// returns true if the given stream starts with compressed data.
+
+Boolean
+CCompressedStream::IsCompressed(
+	LStream&	inStream )
+{
+	if (inStream.GetLength() < (SInt32) sizeof(SCompressedHeader))
+		return false;
+	
+	SCompressedHeader theHeader;
+	inStream.SetMarker( 0, streamFrom_Start );
+	inStream.ReadBlock( &theHeader, sizeof(SCompressedHeader) );
+	
+	return (theHeader.mIdent == compressed_Ident);
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 Compress											[static]
+// ---------------------------------------------------------------------------------
+// compresses all of the first stream and writes it at the marker of the second one.
+// the marker is left at the end of what's written.
+
+void
+CCompressedStream::Compress(
+	LStream&	inFromStream,
+	LStream&	inToStream )
+{
+	SCompressedHeader theHeader;
+	theHeader.mIdent = compressed_Ident;
+	theHeader.mVersion = compressed_Version;
+	theHeader.mLength = inFromStream.GetLength();
+	theHeader.mBlockSize = compressed_BlockSize;
+	theHeader.mNumBlocks = (theHeader.mLength + compressed_BlockSize - 1) / compressed_BlockSize;
+	
+	// block offsets are known as blocks are written. leave room for them.
+	SInt32 theOffsetsLength = (theHeader.mNumBlocks + 1) * sizeof(SInt32);
+	StPointerBlock theOffsets( theOffsetsLength );
+	SInt32* theBlockOffsets = (SInt32*) theOffsets.Get();
+	
+	SInt32 theStart = inToStream.GetMarker();
+	inToStream.WriteBlock( &theHeader, sizeof(SCompressedHeader) );
+	inToStream.WriteBlock( theBlockOffsets, theOffsetsLength );
+	
+	StPointerBlock theBlock( compressed_BlockSize );
+	StPointerBlock theCompressedBlock( compressed_BlockSize );
+	StPointerBlock theHashTable( compressed_HashSize * sizeof(SInt32) );
+	
+	inFromStream.SetMarker( 0, streamFrom_Start );
+	for (SInt32 i = 0; i < theHeader.mNumBlocks; i++)
+	{
+		SInt32 theLength = theHeader.mLength - (i * compressed_BlockSize);
+		if (theLength > compressed_BlockSize)
+			theLength = compressed_BlockSize;
+		inFromStream.ReadBlock( theBlock, theLength );
+	
+		theBlockOffsets[i] = inToStream.GetMarker() - theStart;
+	
+		SInt32 theCompressedLength = CompressBlock( (const UInt8*) theBlock.Get(), theLength,
+													(UInt8*) theCompressedBlock.Get(), theLength,
+													(SInt32*) theHashTable.Get() );
+		if (theCompressedLength > 0)
+			inToStream.WriteBlock( theCompressedBlock, theCompressedLength );
+		else
+			inToStream.WriteBlock( theBlock, theLength );
+	}
+	theBlockOffsets[theHeader.mNumBlocks] = inToStream.GetMarker() - theStart;
+	
+	// now write the offsets.
+	SInt32 theEnd = inToStream.GetMarker();
+	inToStream.SetMarker( theStart + sizeof(SCompressedHeader), streamFrom_Start );
+	inToStream.WriteBlock( theBlockOffsets, theOffsetsLength );
+	inToStream.SetMarker( theEnd, streamFrom_Start );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CompressBlock										[static]
+// ---------------------------------------------------------------------------------
+// compresses a block. returns the compressed length, or 0 if it's not smaller than
+// the block (or doesn't fit in inMaxLength).
+//
+// matches are found with a hash table of the last position of each 4-byte sequence;
+// we don't look any further than that.
+
+SInt32
+CCompressedStream::CompressBlock(
+	const UInt8*	inData,
+	SInt32			inLength,
+	UInt8*			outData,
+	SInt32			inMaxLength,
+	SInt32*			ioHashTable )
+{
+	for (SInt32 i = 0; i < compressed_HashSize; i++)
+		ioHashTable[i] = -1;
+	
+	SInt32 thePos = 0;
+	SInt32 theAnchor = 0;	// start of literals not written yet.
+	SInt32 theOut = 0;
+	
+	while (thePos <= inLength - compressed_MinMatch)
+	{
+		UInt32 theSequence = Read32( inData + thePos );
+		SInt32 theHash = HashOf( theSequence );
+		SInt32 theCandidate = ioHashTable[theHash];
+		ioHashTable[theHash] = thePos;
+	
+		if ((theCandidate < 0) ||
+			(thePos - theCandidate > 0xFFFF) ||
+			(Read32( inData + theCandidate ) != theSequence))
+		{
+			thePos++;
+			continue;
+		}
+	
+		SInt32 theMatchLength = compressed_MinMatch;
+		while ((thePos + theMatchLength < inLength) &&
+			   (inData[theCandidate + theMatchLength] == inData[thePos + theMatchLength]))
+		{
+			theMatchLength++;
+		}
+	
+		theOut = WriteSequence( inData + theAnchor, thePos - theAnchor,
+								thePos - theCandidate, theMatchLength,
+								outData, theOut, inMaxLength );
+		if (theOut < 0)
+			return 0;
+	
+		thePos += theMatchLength;
+		theAnchor = thePos;
+	}
+	
+	// the rest is literals.
+	theOut = WriteSequence( inData + theAnchor, inLength - theAnchor, 0, 0,
+							outData, theOut, inMaxLength );
+	if ((theOut < 0) || (theOut >= inLength))
+		return 0;
+	
+	return theOut;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 DecompressBlock									[static]
+// ---------------------------------------------------------------------------------
+// decompresses a block. throws if the data doesn't decompress to exactly
+// inDecompressedLength bytes.
+
+void
+CCompressedStream::DecompressBlock(
+	const UInt8*	inData,
+	SInt32			inLength,
+	UInt8*			outData,
+	SInt32			inDecompressedLength )
+{
+	SInt32 thePos = 0;
+	SInt32 theOut = 0;
+	
+	while (thePos < inLength)
+	{
+		UInt8 theToken = inData[thePos++];
+	
+		// literals.
+		SInt32 theNumLiterals = theToken >> 4;
+		if (theNumLiterals == 15)
+			theNumLiterals += ReadLength( inData, inLength, thePos );
+		ThrowIf_( (thePos + theNumLiterals > inLength) ||
+				  (theOut + theNumLiterals > inDecompressedLength) );
+	
+		::BlockMoveData( inData + thePos, outData + theOut, theNumLiterals );
+		thePos += theNumLiterals;
+		theOut += theNumLiterals;
+	
+		// the last sequence has no match.
+		if (thePos == inLength)
+			break;
+	
+		// match.
+		ThrowIf_( thePos + 2 > inLength );
+		SInt32 theOffset = (((SInt32) inData[thePos]) << 8) | inData[thePos + 1];
+		thePos += 2;
+	
+		SInt32 theMatchLength = theToken & 0x0F;
+		if (theMatchLength == 15)
+			theMatchLength += ReadLength( inData, inLength, thePos );
+		theMatchLength += compressed_MinMatch;
+		ThrowIf_( (theOffset == 0) || (theOffset > theOut) ||
+				  (theOut + theMatchLength > inDecompressedLength) );
+	
+		// copy byte by byte: the match can overlap what it writes.
+		const UInt8* theFrom = outData + theOut - theOffset;
+		UInt8* theTo = outData + theOut;
+		for (SInt32 i = 0; i < theMatchLength; i++)
+			theTo[i] = theFrom[i];
+		theOut += theMatchLength;
+	}
+	
+	ThrowIf_( theOut != inDecompressedLength );
+}
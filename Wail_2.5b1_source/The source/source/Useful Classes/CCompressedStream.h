@@ -0,0 +1,126 @@
+// =================================================================================
+//	CCompressedStream.h					2003, Charles Lechasseur
+// =================================================================================
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <LStream.h>
+
+
+// header of compressed data, as written by CCompressedStream::Compress. it is
+// followed by (mNumBlocks + 1) offsets (SInt32) of the blocks, relative to the start
+// of the header; block i ends where block i + 1 starts.
+
+const OSType	compressed_Ident		= 'lzbk';
+const SInt32	compressed_Version		= 1;
+const SInt32	compressed_BlockSize	= 32L * 1024L;	// offsets in a block fit in 16 bits.
+
+#pragma options align=mac68k
+
+struct SCompressedHeader
+{
+	OSType		mIdent;			// compressed_Ident.
+	SInt32		mVersion;		// compressed_Version.
+	SInt32		mLength;		// length of the data once decompressed.
+	SInt32		mBlockSize;		// length of each block once decompressed (but the last).
+	SInt32		mNumBlocks;
+};
+
+#pragma options align=reset
+
+
+class CCompressedStream : public LStream
+{
+	public:
+	// Public Functions
+		
+		//Constructor
+		
+								CCompressedStream(
+									LStream*		inCompressedStream );
+		
+		//Destructor
+		
+		virtual					~CCompressedStream();
+		
+		// LStream overridden functions
+		
+		virtual void			SetLength(
+									SInt32			inLength );
+		
+		virtual ExceptionCode	PutBytes(
+									const void*		inBuffer,
+									SInt32&			ioByteCount );
+		
+		virtual ExceptionCode	GetBytes(
+									void*			outBuffer,
+									SInt32&			ioByteCount );
+		
+		// compressed data
+		
+		static Boolean			IsCompressed(
+									LStream&		inStream );
+		static void				Compress(
+									LStream&		inFromStream,
+									LStream&		inToStream );
+		
+	protected:
+		
+		void					LoadBlock(
+									SInt32			inBlock );
+		
+		static SInt32			CompressBlock(
+									const UInt8*	inData,
+									SInt32			inLength,
+									UInt8*			outData,
+									SInt32			inMaxLength,
+									SInt32*			ioHashTable );
+		static void				DecompressBlock(
+									const UInt8*	inData,
+									SInt32			inLength,
+									UInt8*			outData,
+									SInt32			inDecompressedLength );
+		
+	private:
+		
+		// Member variables
+		
+		LStream*			mCompressedStream;
+		SCompressedHeader	mHeader;
+		SInt32*				mBlockOffsets;
+		
+		Ptr					mBlock;				// last block read, decompressed.
+		SInt32				mBlockIndex;		// its index, or -1.
+		SInt32				mBlockLength;
+		Ptr					mCompressedBlock;	// read buffer.
+		
+		// Defensive programming. No copy constructor nor operator=
+							CCompressedStream(const CCompressedStream&);
+		CCompressedStream&		operator=(const CCompressedStream&);
+};
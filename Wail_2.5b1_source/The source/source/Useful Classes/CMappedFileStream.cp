@@ -0,0 +1,174 @@
+// =================================================================================
+//	CMappedFileStream.cp					2003, Charles Lechasseur
+// =================================================================================
+//
+// A read-only stream that "maps" the entire content of another stream (usually
+// a file) in memory. The content is read with a single call, in a locked handle
+// allocated in temporary memory if possible. After that, the mapped stream can be
+// read without any file access, and users can get pointers directly inside the
+// mapped data via GetBuffer and GetBufferAt.
+//
+// Since the data handle stays locked while the stream is alive, such pointers remain
+// valid until the stream is destroyed. The mapped stream doesn't need the original
+// stream once it's constructed.
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include "CMappedFileStream.h"
+
+
+// ---------------------------------------------------------------------------
+//	 CMappedFileStream						Constructor	[public]
+// ---------------------------------------------------------------------------
+// reads the whole content of the given stream. the stream's marker is left at
+// the end of the stream.
+
+CMappedFileStream::CMappedFileStream(
+	LStream&	inStreamToMap )
+	: LHandleStream( ReadWholeStream( inStreamToMap ) )
+{
+}
+
+
+// ---------------------------------------------------------------------------
+//	 ~CMappedFileStream					Destructor	[public]
+// ---------------------------------------------------------------------------
+
+CMappedFileStream::~CMappedFileStream()
+{
+	// LHandleStream disposes of the handle. it doesn't care if it's locked.
+}
+
+
+// ---------------------------------------------------------------------------
+//		 SetLength
+// ---------------------------------------------------------------------------
+// Overridden to prevent setting the stream's length. A mapping is read-only.
+
+void
+CMappedFileStream::SetLength(
+	SInt32	inLength )
+{
+#pragma unused( inLength )
+
+	SignalStringLiteral_( "Programmer error: setting length of a mapped file" );
+}
+
+
+// ---------------------------------------------------------------------------
+//		 PutBytes
+// ---------------------------------------------------------------------------
+// Overridden to prevent writing to the stream. A mapping is read-only.
+
+ExceptionCode
+CMappedFileStream::PutBytes(
+	const void*		inBuffer,
+	SInt32&			ioByteCount )
+{
+#pragma unused( inBuffer )
+
+	SignalStringLiteral_( "Programmer error: writing to a mapped file" );
+	ioByteCount = 0;
+	return unimpErr;
+}
+
+
+// ---------------------------------------------------------------------------
+//		 GetBufferAt
+// ---------------------------------------------------------------------------
+// returns a pointer to the mapped data at the given offset.
+
+const void*
+CMappedFileStream::GetBufferAt(
+	SInt32	inOffset ) const
+{
+	SignalIf_( (inOffset < 0) || (inOffset > GetLength()) );
+
+	return (*mDataH) + inOffset;
+}
+
+
+// ---------------------------------------------------------------------------
+//		 CanMap											[static]
+// ---------------------------------------------------------------------------
+// returns true if there seems to be enough memory to map a stream of the given
+// length, without eating into the inMemProtected bytes of RAM that must be kept
+// free. checks temporary memory first, then our own heap.
+
+Boolean
+CMappedFileStream::CanMap(
+	SInt32	inLength,
+	SInt32	inMemProtected )
+{
+	Size theGrow = 0;
+
+	return ((::TempMaxMem( &theGrow ) > (inLength + inMemProtected)) ||
+			(::MaxBlock() > (inLength + inMemProtected)));
+}
+
+
+// ---------------------------------------------------------------------------
+//		 ReadWholeStream									[static]
+// ---------------------------------------------------------------------------
+// allocates a handle big enough to contain the whole stream and reads it in
+// a single call. the handle is returned locked.
+
+Handle
+CMappedFileStream::ReadWholeStream(
+	LStream&	inStream )
+{
+	SInt32 theLength = inStream.GetLength();
+
+	// try temporary memory first, so that we don't fill our own heap.
+	OSErr err = noErr;
+	Handle theHandle = ::TempNewHandle( theLength, &err );
+	if (theHandle == nil)
+	{
+		// no luck. try our heap.
+		theHandle = ::NewHandle( theLength );
+		ThrowIfMemFail_( theHandle );
+	}
+
+	try
+	{
+		// lock the handle. it will stay locked while we're alive, since we give
+		// out pointers inside it.
+		::HLockHi( theHandle );
+
+		// read everything in one shot.
+		inStream.SetMarker( 0, streamFrom_Start );
+		inStream.ReadBlock( *theHandle, theLength );
+	}
+
+	catch (...)
+	{
+		::DisposeHandle( theHandle );
+		throw;
+	}
+
+	return theHandle;
+}
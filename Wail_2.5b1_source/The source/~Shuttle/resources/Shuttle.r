@@ -0,0 +1,144 @@
+// =================================================================================
+//	Shuttle.r						©2003, Charles Lechasseur
+// =================================================================================
+//
+// resources that were added after Shuttle.rsrc. they're kept as Rez source so they
+// can be read and merged without ResEdit or Constructor.
+
+/* Copyright (c) 2003, Charles Lechasseur
+**  All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without modification,
+** are permitted provided that the following conditions are met:
+** 
+** - Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** 
+** - Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the
+**   documentation and/or other materials provided with the distribution.
+** 
+** - The name of Charles Lechasseur may not be used to endorse or promote
+**   products derived from this software without specific prior written permission. 
+** 
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+** FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL CHARLES LECHASSEUR OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+** BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+** BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+** LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include "Types.r"
+
+
+// shown when a delta shuttle is run on a file it wasn't made against.
+// see CShuttleWork::DoWork.
+
+resource 'ALRT' (10000, "Wrong source file alert") {
+	{40, 40, 141, 370},
+	10000,
+	{
+		OK, visible, sound1,
+		OK, visible, sound1,
+		OK, visible, sound1,
+		OK, visible, sound1
+	},
+	alertPositionParentWindowScreen
+};
+
+resource 'DITL' (10000, "Wrong source file alert") {
+	{
+		{68, 259, 88, 317},
+		Button {
+			enabled,
+			"OK"
+		},
+		{10, 60, 58, 317},
+		StaticText {
+			disabled,
+			"This shuttle can't install its sounds in this file. "
+			"It only contains changes to another sound file."
+		}
+	}
+};
+
+
+// asks before installing in many files at once. ^0 is the number of files.
+// see CShuttleDocApp::CreateShuttleWorks.
+
+resource 'ALRT' (10001, "Install in many files alert") {
+	{40, 40, 141, 370},
+	10001,
+	{
+		OK, visible, sound1,
+		OK, visible, sound1,
+		OK, visible, sound1,
+		OK, visible, sound1
+	},
+	alertPositionParentWindowScreen
+};
+
+resource 'DITL' (10001, "Install in many files alert") {
+	{
+		{68, 259, 88, 317},
+		Button {
+			enabled,
+			"OK"
+		},
+		{68, 187, 88, 245},
+		Button {
+			enabled,
+			"Cancel"
+		},
+		{10, 60, 58, 317},
+		StaticText {
+			disabled,
+			"Install this shuttle's sounds in all ^0 files? "
+			"Each file will be replaced once all its sounds are installed."
+		}
+	}
+};
+
+
+// shown when installing in one of the files fails. ^0 is the file's name and ^1
+// the error. the other files are still installed. see CShuttleDocApp::DoSomeWork.
+
+resource 'ALRT' (10002, "Install failed alert") {
+	{40, 40, 141, 370},
+	10002,
+	{
+		OK, visible, sound1,
+		OK, visible, sound1,
+		OK, visible, sound1,
+		OK, visible, sound1
+	},
+	alertPositionParentWindowScreen
+};
+
+resource 'DITL' (10002, "Install failed alert") {
+	{
+		{68, 259, 88, 317},
+		Button {
+			enabled,
+			"OK"
+		},
+		{10, 60, 58, 317},
+		StaticText {
+			disabled,
+			"The sounds couldn't be installed in “^0” (error ^1). "
+			"Other files are still installed."
+		}
+	}
+};
+
+
+// strings used to fill in the alerts above.
+
+resource 'STR#' (10000, "Alert strings") {
+	{
+		"unknown"
+	}
+};
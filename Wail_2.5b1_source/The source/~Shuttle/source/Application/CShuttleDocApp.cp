@@ -60,6 +60,15 @@
 #include "WailTypes.h"
 
 
+// constants
+
+const	ResIDT		rALRT_InstallInManyFilesAlert	= 10001;
+const	ResIDT		rALRT_InstallFailedAlert		= 10002;
+
+const	ResIDT		STRx_AlertStrings				= 10000;
+const	SInt16		str_UnknownError				= 1;
+
+
 // =================================================================================
 //		 Main Program
 // =================================================================================
@@ -97,8 +106,9 @@ CShuttleDocApp::CShuttleDocApp()
 {
 	// init variables.
 	mHasFile = false;
+	mHasPatchFile = false;
 	mIdleCount = 0;
-	mShuttleWork = nil;
+	mCurrentWork = 1;
 	SetSleepTime( 1 );	// don't sleep too much.
 
 	// Register PowerPlant class creator functions.
@@ -124,8 +134,9 @@ CShuttleDocApp::CShuttleDocApp()
 
 CShuttleDocApp::~CShuttleDocApp()
 {
-	if (mShuttleWork != nil)
-		delete mShuttleWork;
+	// the first work owns the patch others use, so it goes last.
+	for (SInt32 i = mShuttleWorks.GetCount(); i >= 1; i--)
+		delete mShuttleWorks[i];
 }
 
 
@@ -172,16 +183,21 @@ CShuttleDocApp::SpendTime(
 			SendAEQuit();
 		}
 		
-		if (mShuttleWork == nil)
+		if (mShuttleWorks.GetCount() == 0)
 		{
-			// create a new CShuttleWork object to work on our file.
-			mShuttleWork = new CShuttleWork( mFile, this );
+			// create CShuttleWork objects to work on our files.
+			if (!CreateShuttleWorks())
+			{
+				// user cancelled.
+				StopRepeating();
+				SendAEQuit();
+			}
 		}
 		else
 		{
 			// let's do some work.
 			StopRepeating();
-			Boolean isDone = mShuttleWork->DoWork();
+			Boolean isDone = DoSomeWork();
 			StartRepeating();
 			
 			if (isDone)
@@ -303,9 +319,20 @@ CShuttleDocApp::OpenDocument(
 		case fileType_Marathon2Sound:
 		case fileType_MarathonInfinitySound:
 			{
-				mFile = *inMacFSSpec;
+				// many files can be dropped on us at once.
+				mFiles.AddItem( *inMacFSSpec );
 				mHasFile = true;
 			}
+			break;
+		
+		case fileType_ShuttlePatch:
+			{
+				// a patch file, made by Wail, dropped along with sound files. we
+				// install it instead of our own data.
+				mPatchFile = *inMacFSSpec;
+				mHasPatchFile = true;
+			}
+			break;
 	}
 }
 
@@ -334,3 +361,114 @@ CShuttleDocApp::ChooseDocument()
 		SendAEOpenDoc( theReply.sfFile );
 	}
 }
+
+
+// ---------------------------------------------------------------------------------
+//		 CreateShuttleWorks
+// ---------------------------------------------------------------------------------
+// creates a CShuttleWork object for each of our files. they all share the first
+// one's patch, so the shuttle data is only opened and read once. that's the patch
+// file dropped on us, if any.
+//
+// with many files, asking where to install sounds for each of them would be a pain:
+// we ask once, and sounds are installed in the files themselves. returns false if
+// the user cancelled.
+
+Boolean
+CShuttleDocApp::CreateShuttleWorks()
+{
+	SInt32 numFiles = mFiles.GetCount();
+	if (numFiles > 1)
+	{
+		LStr255 theNumFiles( numFiles );
+		::ParamText( theNumFiles, "\p", "\p", "\p" );
+		if (UModalAlerts::CautionAlert( rALRT_InstallInManyFilesAlert ) != kStdOkItemIndex)
+			return false;
+	}
+	
+	mShuttleWorks.AdjustAllocation( numFiles );
+	for (SInt32 i = 1; i <= numFiles; i++)
+	{
+		CShuttleWork* thePatchOwner = (i > 1) ? mShuttleWorks[1] : nil;
+		CShuttleWork* theWork = new CShuttleWork( mFiles[i], this, thePatchOwner,
+												  mHasPatchFile ? &mPatchFile : nil );
+		mShuttleWorks.AddItem( theWork );
+		
+		if (numFiles > 1)
+			theWork->InstallInSourceFile();
+	}
+	
+	mCurrentWork = 1;
+	return true;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 DoSomeWork
+// ---------------------------------------------------------------------------------
+// lets the next work that's not done do some work. works take turns, so that all
+// files are installed at the same time, each one copying big chunks in its turn.
+// returns true once all works are done.
+
+Boolean
+CShuttleDocApp::DoSomeWork()
+{
+	SInt32 numWorks = mShuttleWorks.GetCount();
+	for (SInt32 i = 1; i <= numWorks; i++)
+	{
+		SInt32 theIndex = mCurrentWork;
+		CShuttleWork* theWork = mShuttleWorks[theIndex];
+		
+		mCurrentWork++;
+		if (mCurrentWork > numWorks)
+			mCurrentWork = 1;
+		
+		if (!theWork->IsDone())
+		{
+			// a file that fails is given up, but the others are still installed.
+			try
+			{
+				theWork->DoWork();
+			}
+			
+			catch (ExceptionCode catchedErr)
+			{
+				theWork->Abandon();
+				ReportFailedWork( theIndex, LStr255( catchedErr ) );
+			}
+			
+			catch (...)
+			{
+				theWork->Abandon();
+				ReportFailedWork( theIndex, LStr255( STRx_AlertStrings, str_UnknownError ) );
+			}
+			
+			break;
+		}
+	}
+	
+	// see if anyone's left.
+	for (SInt32 j = 1; j <= numWorks; j++)
+	{
+		if (!mShuttleWorks[j]->IsDone())
+			return false;
+	}
+	
+	return true;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ReportFailedWork
+// ---------------------------------------------------------------------------------
+// tells the user that the sounds couldn't be installed in the file of the given
+// work (1-based). inError describes what went wrong.
+
+void
+CShuttleDocApp::ReportFailedWork(
+	SInt32			inWorkIndex,
+	ConstStringPtr	inError )
+{
+	::ParamText( mFiles[inWorkIndex].name, inError, "\p", "\p" );
+	UModalAlerts::StopAlert( rALRT_InstallFailedAlert );
+}
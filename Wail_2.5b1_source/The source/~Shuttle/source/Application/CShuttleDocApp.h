@@ -31,6 +31,7 @@
 #pragma once
 
 #include <LDocApplication.h>
+#include <TArray.h>
 #include "CSmartPeriodical.h"
 
 #include "CShuttleWork.h"
@@ -60,13 +61,22 @@ protected:
 	virtual void			OpenDocument( FSSpec *inMacFSSpec );
 	virtual void			ChooseDocument();
 	
+			Boolean			CreateShuttleWorks();
+			Boolean			DoSomeWork();
+			void			ReportFailedWork(
+								SInt32					inWorkIndex,
+								ConstStringPtr			inError );
+	
 protected:
 	// variables
 	
-	FSSpec			mFile;
+	TArray<FSSpec>	mFiles;
 	Boolean			mHasFile;
+	FSSpec			mPatchFile;				// patch file to install instead of our own data,
+	Boolean			mHasPatchFile;			// if one was dropped on us.
 	
 	UInt16			mIdleCount;
 	
-	CShuttleWork	*mShuttleWork;
+	TArray<CShuttleWork*>	mShuttleWorks;	// one per file. the first one owns the patch.
+	SInt32			mCurrentWork;			// 1-based.
 };
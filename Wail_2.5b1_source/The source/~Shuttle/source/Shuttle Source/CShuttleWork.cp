@@ -33,7 +33,11 @@
 #include "CShuttleWork.h"
 
 #include "WailShuttleConstants.h"
+#include "CWailSoundStream.h"
+#include "CAsyncFileWriter.h"
+#include "CCompressedStream.h"
 
+#include <UMemoryMgr.h>
 #include <UModalDialogs.h>
 
 
@@ -65,6 +69,8 @@ const	PaneIDT		pane_InNewFileRadio				= 'Copy';
 
 const	ResIDT		rPPob_WrongNumberOfClasses		= 1501;
 
+const	ResIDT		rALRT_WrongSourceFileAlert		= 10000;
+
 const	PaneIDT		pane_DontInstallSounds			= 'Dont';
 const	MessageT	msg_DontInstallSounds			= pane_DontInstallSounds;
 const	PaneIDT		pane_InstallFromSource			= 'Sour';
@@ -72,6 +78,19 @@ const	MessageT	msg_InstallFromSource			= pane_InstallFromSource;
 const	PaneIDT		pane_InstallFromShuttle			= 'Shut';
 const	MessageT	msg_InstallFromShuttle			= pane_InstallFromShuttle;
 
+const	SInt32		copy_MaxBufferSize				= 256L * 1024L;	// size of the buffer used
+const	SInt32		copy_MinBufferSize				= 16L * 1024L;	// to copy sound data.
+const	UInt32		copy_TimeSlice					= 15;			// ticks spent copying per call.
+const	SInt32		copy_ProgressSteps				= 1000;
+
+const	OSType		journal_Ident					= 'sjnl';	// journal of an install in
+const	SInt32		journal_Version					= 1;		// the source file. see
+const	OSType		fileType_ShuttleJournal			= 'SJnl';	// WriteJournal.
+const	SInt32		journal_Batch					= 1024L * 1024L;	// bytes copied between
+																	// checkpoints.
+
+const	SInt16		fileName_MaxLength				= 31;		// longest HFS file name.
+
 
 // ---------------------------------------------------------------------------
 //	 CShuttleWork
@@ -79,16 +98,36 @@ const	MessageT	msg_InstallFromShuttle			= pane_InstallFromShuttle;
 
 CShuttleWork::CShuttleWork(
 	const FSSpec&	inFile,
-	LCommander		*inSuper )
+	LCommander		*inSuper,
+	CShuttleWork	*inSharePatchWith /*= nil*/,
+	const FSSpec	*inPatchFile /*= nil*/ )
 	: LCommander( inSuper )
 {
 	// let's create the source LStream.
 	mSourceFile = new LFileStream( inFile );
 	mSourceFile->OpenDataFork( fsRdPerm );
 	
-	// let's create the patch LStream.
+	// let's create the patch LStream. when installing in many files, the patch is
+	// only opened and read once; the other works use it too. each read positions
+	// the stream first, so they don't get in each other's way.
 //	mPatchFile = new CResourceStream( rShuttleData_Type, rShuttleData_ID );
-	CreatePatchFile();
+	mHasDelta = false;
+	if (inSharePatchWith == nil)
+	{
+		CreatePatchFile( inPatchFile );
+		mOwnsPatchFile = true;
+	}
+	else
+	{
+		mPatchDataFile = inSharePatchWith->mPatchDataFile;
+		mPatchFile = inSharePatchWith->mPatchFile;
+		mOwnsPatchFile = false;
+		
+		mHasDelta = inSharePatchWith->mHasDelta;
+		mDeltaHeader = inSharePatchWith->mDeltaHeader;
+		mDeltaEntries = inSharePatchWith->mDeltaEntries;
+	}
+	mSourceChecked = false;
 	
 	// destination file doesn't exist yet.
 	mDestinationFile = nil;
@@ -96,6 +135,19 @@ CShuttleWork::CShuttleWork(
 	// progress dialog doesn't exist yet.
 	mProgressDialog = nil;
 	
+	// nothing to copy yet.
+	mCopyBuffer = nil;
+	mCopyBufferSize = 0;
+	mCopyTotal = 0;
+	mCopyDone = 0;
+	mCurrentSpan = 1;
+	mCurrentSpanDone = 0;
+	
+	// no journal yet.
+	mJournalFile = nil;
+	mResuming = false;
+	mJournaledBytes = 0;
+	
 	mIsDone = false;
 }
 
@@ -108,12 +160,18 @@ CShuttleWork::~CShuttleWork()
 {
 	if (mSourceFile != nil)
 		delete mSourceFile;
-	if (mPatchFile != nil)
+	if ((mPatchFile != nil) && (mPatchFile != mPatchDataFile) && mOwnsPatchFile)
 		delete mPatchFile;
+	if ((mPatchDataFile != nil) && mOwnsPatchFile)
+		delete mPatchDataFile;
 	if (mDestinationFile != nil)
 		delete mDestinationFile;
 	if (mProgressDialog != nil)
 		delete mProgressDialog;
+	if (mCopyBuffer != nil)
+		::DisposePtr( mCopyBuffer );
+	if (mJournalFile != nil)
+		delete mJournalFile;	// the file stays there if we didn't finish.
 }
 
 
@@ -125,6 +183,16 @@ CShuttleWork::~CShuttleWork()
 Boolean
 CShuttleWork::DoWork()
 {
+	// a delta shuttle only contains what its source file doesn't have, so it can't
+	// be run on any other file. check that before asking anything.
+	if ((!mIsDone) && (!mSourceChecked) && (!IsRightSourceFile()))
+	{
+		UModalAlerts::StopAlert( rALRT_WrongSourceFileAlert );
+		
+		mIsDone = true;
+	}
+	mSourceChecked = true;
+	
 	// let's check if the destination file exists.
 	if ((!mIsDone) && (mDestinationFile == nil))
 	{
@@ -182,13 +250,12 @@ CShuttleWork::DoWork()
 			mNumClasses = mNumClassesSource;
 		}
 		
-		// initialize progress bar.
+		// initialize progress bar. it follows the sound data being copied.
 		if (!mIsDone)
 		{
-			mProgressDialog->SetProgressBarSize( mNumClasses * 2 );
+			mProgressDialog->SetProgressBarSize( copy_ProgressSteps );
 			mProgressDialogInitialized = true;
-			mCurrentSet = 0;
-			mCurrentClass = -1;
+			mLayoutDone = false;
 		}
 	}
 	
@@ -200,10 +267,27 @@ CShuttleWork::DoWork()
 		FSSpec theSpecifier;
 		mSourceFile->GetSpecifier( theSpecifier );
 		ThrowIfOSErr_( ::FSpGetFInfo( &theSpecifier, &sourceInfo ) );
-
-		// create the file.
-		mDestinationFile->CreateNewDataFile( sourceInfo.fdCreator, sourceInfo.fdType,
-											 smSystemScript );
+		
+		// when installing in the source file, an install that was interrupted leaves
+		// its temp file and journal behind. we'll pick it up where it was.
+		if (mOverwriteSource)
+			mResuming = OpenJournal( sourceInfo.fdCreator );
+		
+		if (!mResuming)
+		{
+			// a temp file without a journal is of no use.
+			if (mOverwriteSource)
+			{
+				mDestinationFile->GetSpecifier( theSpecifier );
+				OSErr err = ::FSpDelete( &theSpecifier );
+				if (err != fnfErr)
+					ThrowIfOSErr_( err );
+			}
+			
+			// create the file.
+			mDestinationFile->CreateNewDataFile( sourceInfo.fdCreator, sourceInfo.fdType,
+												 smSystemScript );
+		}
 		// open it.
 		mDestinationFile->OpenDataFork( fsRdWrPerm );
 		mDestinationFileExists = true;
@@ -212,102 +296,211 @@ CShuttleWork::DoWork()
 	// let's see if we're ready to shuttle sounds.
 	if (!mIsDone)
 	{
-		// see if header is installed.
-		if (mCurrentClass == -1)
+		// see if the destination file is laid out.
+		if (!mLayoutDone)
 		{
-			// we must install the header.
+			// we must install the header and all class headers, and find out where
+			// each piece of sound data comes from. this only reads headers, so it's
+			// done in one go.
 			InstallHeader();
+			for (SInt16 theSet = 0; theSet <= 1; theSet++)
+				for (SInt16 theClass = 0; theClass < mNumClasses; theClass++)
+					InstallClass( theSet, theClass );
+			
+			// now that we know how big the file will be, make it that big at once.
+			mDestinationFile->SetLength( mCurrentOffset );
+			mLayoutDone = true;
+			
+			// see what the journal says, if any.
+			if (mJournalFile != nil)
+				StartJournal();
 		}
-		else
+		else if (CopySpans())
 		{
-			// we must install a sound class.
-			InstallClass( mCurrentSet, mCurrentClass );
-			// increment progress bar.
-			mProgressDialog->Increment();
-		}
-		
-		// increment class counter.
-		mCurrentClass++;
-		// see if we're done.
-		if (!(mCurrentClass < mNumClasses))
-			if (mCurrentSet < 1)
-			{
-				// we're not done - go to 16-bit set.
-				mCurrentSet++;
-				mCurrentClass = 0;
-			}
-			else 
+			// we're done.
+			mIsDone = true;
+			
+			// maybe we need to exchange data if it was a temp file.
+			if (mOverwriteSource)
 			{
-				// we're done.
-				mIsDone = true;
+				// close the dest file.
+				mDestinationFile->CloseDataFork();
+				// close the source file.
+				mSourceFile->CloseDataFork();
+				// exchange data.
+				FSSpec theSourceSpecifier,
+					   theDestinationSpecifier;
+				mSourceFile->GetSpecifier( theSourceSpecifier );
+				mDestinationFile->GetSpecifier( theDestinationSpecifier );
+				ThrowIfOSErr_( ::FSpExchangeFiles( &theSourceSpecifier,
+												   &theDestinationSpecifier ) );
+				// delete temp file.
+				ThrowIfOSErr_( ::FSpDelete( &theDestinationSpecifier ) );
 				
-				// maybe we need to exchange data if it was a temp file.
-				if (mOverwriteSource)
-				{
-					// close the dest file.
-					mDestinationFile->CloseDataFork();
-					// close the source file.
-					mSourceFile->CloseDataFork();
-					// exchange data.
-					FSSpec theSourceSpecifier,
-						   theDestinationSpecifier;
-					mSourceFile->GetSpecifier( theSourceSpecifier );
-					mDestinationFile->GetSpecifier( theDestinationSpecifier );
-					ThrowIfOSErr_( ::FSpExchangeFiles( &theSourceSpecifier,
-													   &theDestinationSpecifier ) );
-					// delete temp file.
-					ThrowIfOSErr_( ::FSpDelete( &theDestinationSpecifier ) );
-				}
+				// the journal is of no use anymore.
+				FSSpec theJournalSpecifier;
+				mJournalFile->GetSpecifier( theJournalSpecifier );
+				mJournalFile->CloseDataFork();
+				delete mJournalFile;
+				mJournalFile = nil;
+				ThrowIfOSErr_( ::FSpDelete( &theJournalSpecifier ) );
 			}
+		}
 	}
 
 	return mIsDone;
 }
 
 
+// ---------------------------------------------------------------------------------
+//		 Abandon
+// ---------------------------------------------------------------------------------
+// gives up on this work after DoWork failed. files are left as they are; if we
+// were installing in the source file, its journal lets the install be resumed.
+
+void
+CShuttleWork::Abandon()
+{
+	mIsDone = true;
+	
+	if (mProgressDialog != nil)
+	{
+		delete mProgressDialog;
+		mProgressDialog = nil;
+	}
+}
+
+
 // ---------------------------------------------------------------------------------
 //		 CreatePatchFile
 // ---------------------------------------------------------------------------------
-// creating the patch file object is now more complex. it requires that we
-// find an FSSpec to ourselves with the Process Manager, and then create
-// an inset file stream to read our data. we also need to fetch the data
-// offset from our resource.
+// creating the patch file object is now more complex. unless we're given a patch
+// file, it requires that we find an FSSpec to ourselves with the Process Manager,
+// and then create an inset file stream to read our data. the data offset is in the
+// trailer at the end of the data fork; shuttles built before the trailer existed
+// only have it in our resource.
 
 void
-CShuttleWork::CreatePatchFile()
+CShuttleWork::CreatePatchFile(
+	const FSSpec	*inPatchFile )
 {
+	FSSpec theSpec;
+	if (inPatchFile != nil)
+		theSpec = *inPatchFile;
+	else
+	{
+		// get the serial number of the current process - i.e., us.
+		ProcessSerialNumber thePSN;
+		ThrowIfOSErr_( ::GetCurrentProcess( &thePSN ) );
+		
+		// get more info about us.
+		ProcessInfoRec theInfoRec;
+		
+		// fill important fields.
+		theInfoRec.processInfoLength = sizeof(ProcessInfoRec);	// dumb.
+		theInfoRec.processName = nil;	// don't care about that.
+		theInfoRec.processAppSpec = &theSpec;
+		
+		ThrowIfOSErr_( ::GetProcessInformation( &thePSN, &theInfoRec ) );
+	}
+	
+	// create our file stream from that spec. the inset is set once we know the data
+	// offset. this will be closed when the object is destroyed in this object's
+	// destructor.
+	mPatchFile = nil;
+	mPatchDataFile = new CInFileStream( theSpec );
+	mPatchDataFile->OpenDataFork( fsRdPerm );
+	
 	// get the data offset.
-	SInt32 theDataOffset = 0;
+	SShuttleDataInfo theInfo;
+	theInfo.mDataOffset = 0;
+	theInfo.mDeltaOffset = 0;
+	if (!ReadTrailer( theInfo ))
 	{
+		// patch files have nothing else.
+		ThrowIf_( inPatchFile != nil );
+		
 		// fetch our resource. it contains the offset of the patch data
 		// inside the data fork.
 		StResource theResource( rShuttleData_Type, rShuttleData_ID, true, true );
 		
-		// the resource contains a signed 32-bit integer.
-		theDataOffset = **((SInt32**) ((Handle) theResource));
+		// the resource contains a signed 32-bit integer, followed by the offset of
+		// the delta section in newer shuttles.
+		if (::GetHandleSize( theResource ) >= sizeof(SShuttleDataInfo))
+			theInfo = **((SShuttleDataInfo**) ((Handle) theResource));
+		else
+			theInfo.mDataOffset = **((SInt32**) ((Handle) theResource));
 	}
+	mPatchDataFile->SetInset( theInfo.mDataOffset );
 	
-	// get the serial number of the current process - i.e., us.
-	ProcessSerialNumber thePSN;
-	ThrowIfOSErr_( ::GetCurrentProcess( &thePSN ) );
+	// the patch data may be compressed. then we read it through a stream that only
+	// decompresses the blocks we read. the resource doesn't tell; the data does.
+	if (CCompressedStream::IsCompressed( *mPatchDataFile ))
+		mPatchFile = new CCompressedStream( mPatchDataFile );
+	else
+		mPatchFile = mPatchDataFile;
 	
-	// get more info about us.
-	ProcessInfoRec theInfoRec;
-	FSSpec theSpec;
+	// read the delta section, if we're a delta shuttle. it's never compressed.
+	if (theInfo.mDeltaOffset != 0)
+		ReadDeltaSection( theInfo.mDeltaOffset );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ReadTrailer
+// ---------------------------------------------------------------------------------
+// reads the trailer at the end of the patch file's data fork. returns false if
+// there's none. the patch file's inset must still be 0.
+
+Boolean
+CShuttleWork::ReadTrailer(
+	SShuttleDataInfo&	outInfo )
+{
+	SInt32 theLength = mPatchDataFile->GetLength();
+	if (theLength < (SInt32) sizeof(SShuttleTrailer))
+		return false;
+	
+	SShuttleTrailer theTrailer;
+	mPatchDataFile->SetMarker( theLength - sizeof(SShuttleTrailer), streamFrom_Start );
+	mPatchDataFile->ReadBlock( &theTrailer, sizeof(SShuttleTrailer) );
 	
-	// fill important fields.
-	theInfoRec.processInfoLength = sizeof(ProcessInfoRec);	// dumb.
-	theInfoRec.processName = nil;	// don't care about that.
-	theInfoRec.processAppSpec = &theSpec;
+	if ((theTrailer.mIdent != shuttleTrailer_Ident) ||
+		(theTrailer.mVersion != shuttleTrailer_Version))
+	{
+		return false;
+	}
+	
+	outInfo = theTrailer.mInfo;
+	return true;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 ReadDeltaSection
+// ---------------------------------------------------------------------------------
+// reads the header and entries of the delta section, found at the given offset in
+// the patch file. entries are small, so they're all kept in memory.
+
+void
+CShuttleWork::ReadDeltaSection(
+	SInt32	inDeltaOffset )
+{
+	mPatchDataFile->SetMarker( inDeltaOffset, streamFrom_Start );
+	mPatchDataFile->ReadBlock( &mDeltaHeader, sizeof(SShuttleDeltaHeader) );
 	
-	ThrowIfOSErr_( ::GetProcessInformation( &thePSN, &theInfoRec ) );
+	// we wouldn't know what to do with another version.
+	ThrowIf_( (mDeltaHeader.mIdent != shuttleDelta_Ident) ||
+			  (mDeltaHeader.mVersion != shuttleDelta_Version) );
 	
-	// create our inset file stream from that spec and data offset.
-	mPatchFile = new CInFileStream( theSpec, theDataOffset );
+	mDeltaEntries.AdjustAllocation( mDeltaHeader.mNumEntries );
+	for (SInt32 i = 1; i <= mDeltaHeader.mNumEntries; i++)
+	{
+		SShuttleDeltaEntry theEntry;
+		mPatchDataFile->ReadBlock( &theEntry, sizeof(SShuttleDeltaEntry) );
+		mDeltaEntries.AddItem( theEntry );
+	}
 	
-	// open its data fork. this will be closed when the object is destroyed
-	// in this object's destructor.
-	mPatchFile->OpenDataFork( fsRdPerm );
+	mHasDelta = true;
 }
 
 
@@ -361,14 +554,7 @@ CShuttleWork::AskForDestinationFile()
 		FSSpec theFileSpec;
 		if (mOverwriteSource)
 		{
-			// we must create a temp file in the same folder as the source file.
-			mSourceFile->GetSpecifier( theFileSpec );
-			LString::AppendPStr(
-				theFileSpec.name, (ConstStringPtr) "\ptemp", sizeof (StrFileName) );
-			
-			mDestinationFile = new LFileStream( theFileSpec );
-			ThrowIfNil_( mDestinationFile );
-			mDestinationFileExists = false; // not created yet.
+			InstallInSourceFile();
 		}
 		else
 		{
@@ -404,6 +590,46 @@ CShuttleWork::AskForDestinationFile()
 }
 
 
+// ---------------------------------------------------------------------------------
+//		 InstallInSourceFile
+// ---------------------------------------------------------------------------------
+// makes sounds be installed in the source file itself, without asking. they're
+// installed in a temp file first, whose data is exchanged with the source file's
+// once everything is there, so the source file is never left half-installed.
+
+void
+CShuttleWork::InstallInSourceFile()
+{
+	mOverwriteSource = true;
+	
+	// we must create a temp file in the same folder as the source file.
+	FSSpec theFileSpec;
+	mSourceFile->GetSpecifier( theFileSpec );
+	AddSuffixToFileName( theFileSpec.name, "\ptemp" );
+	
+	mDestinationFile = new LFileStream( theFileSpec );
+	ThrowIfNil_( mDestinationFile );
+	mDestinationFileExists = false; // not created yet.
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 AddSuffixToFileName								[static]
+// ---------------------------------------------------------------------------------
+// appends inSuffix to the given file name. HFS names can't be longer than 31
+// characters, so the name is cut short to leave room for the suffix.
+
+void
+CShuttleWork::AddSuffixToFileName(
+	StrFileName		ioName,
+	ConstStringPtr	inSuffix )
+{
+	if (ioName[0] > fileName_MaxLength - inSuffix[0])
+		ioName[0] = fileName_MaxLength - inSuffix[0];
+	LString::AppendPStr( ioName, inSuffix, sizeof (StrFileName) );
+}
+
+
 // ---------------------------------------------------------------------------------
 //		 AskForInstallationMethod
 // ---------------------------------------------------------------------------------
@@ -493,15 +719,21 @@ CShuttleWork::InstallHeader()
 	mCurrentOffset = sizeof (SMthonSoundHeader) +
 					 sizeof (SMthonSoundClass) * (mNumClasses * 2);
 	
-	// enlarge sound file.
-	mDestinationFile->SetLength( mCurrentOffset );
+	// enlarge sound file. when resuming, the file already has sounds we want to keep.
+	if (!mResuming)
+		mDestinationFile->SetLength( mCurrentOffset );
+	
+	// sound data will start right after.
+	mCopySpans.RemoveItemsAt( mCopySpans.GetCount(), LArray::index_First );
+	mCopyTotal = 0;
 }
 
 
 // ---------------------------------------------------------------------------------
 //		 InstallClass
 // ---------------------------------------------------------------------------------
-// installs the given class, along with all its sounds, in the destination file.
+// installs the given class header in the destination file, and adds spans to copy
+// its sounds. sounds are copied later by CopySpans.
 
 void
 CShuttleWork::InstallClass(
@@ -555,12 +787,12 @@ CShuttleWork::InstallClass(
 	// first sound offset as its 8-bit equivalent.
 	Boolean isRemapped = false;
 	SInt32	the8bitOffset = mCurrentOffset;	// initialize safely just in case.
+	SMthonSoundClass the8bitHeader;
 	
 	if (inWhichSet == 1)	// only check this for 16-bit classes.
 	{
 		// read 8-bit header in correct file, like above.
 		// keep track of the source file for this 8-bit class.
-		SMthonSoundClass the8bitHeader;
 		LStream* theSource8bitFile = mPatchFile;
 		
 		if (inWhichClass < mNumClassesShuttle)
@@ -596,22 +828,36 @@ CShuttleWork::InstallClass(
 		}
 	}
 	
-	// install class header in the destination file.
-	SInt32 oldFirstSoundOffset = theClassHeader.mFirstSoundOffset;
+	// install class header in the destination file. sounds of a delta shuttle are
+	// longer once installed, so lengths of remapped classes must come from the
+	// installed 8-bit class too.
+	SMthonSoundClass theDestinationHeader = theClassHeader;
 	if (!isRemapped)
-		theClassHeader.mFirstSoundOffset = mCurrentOffset;
+	{
+		theDestinationHeader.mFirstSoundOffset = mCurrentOffset;
+		if (theSourceFile == mPatchFile)
+			AddDeltaLengths( inWhichSet, inWhichClass, theDestinationHeader );
+	}
 	else
-		theClassHeader.mFirstSoundOffset = the8bitOffset;
-	WriteSoundClass( mDestinationFile, inWhichSet, inWhichClass, mNumClasses, theClassHeader );
-	theClassHeader.mFirstSoundOffset = oldFirstSoundOffset;
+	{
+		theDestinationHeader.mFirstSoundOffset = the8bitOffset;
+		if (mHasDelta)
+		{
+			theDestinationHeader.mFirstSoundLength = the8bitHeader.mFirstSoundLength;
+			theDestinationHeader.mTotalLength = the8bitHeader.mTotalLength;
+			for (SInt16 j = 0; j < 5; j++)
+				theDestinationHeader.mSoundOffset[j] = the8bitHeader.mSoundOffset[j];
+		}
+	}
+	WriteSoundClass( mDestinationFile, inWhichSet, inWhichClass, mNumClasses, theDestinationHeader );
 	
 	// we transfer sounds only if the class is not remapped.
 	if (!isRemapped)
 	{
-		// position the stream's marker at the beginning of the sounds.
-		theSourceFile->SetMarker( theClassHeader.mFirstSoundOffset, streamFrom_Start );
+		// sounds start here in the source.
+		SInt32 theReadOffset = theClassHeader.mFirstSoundOffset;
 		
-		// read and install sounds.
+		// plan the copy of each sound.
 		SInt16 i;
 		for (i = 0; i < theClassHeader.mNumSounds; i++)
 		{
@@ -628,23 +874,436 @@ CShuttleWork::InstallClass(
 				// a sound in-between the first and the last.
 				theLength = theClassHeader.mSoundOffset[i + 1] - 
 							theClassHeader.mSoundOffset[i];
-							
-			// read the sound.
-			Ptr theSound = ::NewPtr( theLength );
-			ThrowIfNil_( theSound );
 			
-			ReadSound( theSourceFile, theSourceFile->GetMarker(), theLength, theSound );
-			
-			// write it in the destination file.
-			WriteSound( mDestinationFile, mCurrentOffset, theLength, theSound );
-			
-			// de-allocate sound.
-			::DisposePtr( theSound );
+			// sounds of a delta shuttle are completed with what's in the source file.
+			const SShuttleDeltaEntry* theEntry = nil;
+			if (theSourceFile == mPatchFile)
+				theEntry = FindDeltaEntry( inWhichSet, inWhichClass, i );
+			if (theEntry != nil)
+				InstallDeltaSound( *theEntry, theReadOffset, theLength );
+			else
+				AddCopySpan( theSourceFile, theReadOffset, theLength );
 			
-			// increment current offset.
-			mCurrentOffset += theLength;
+			theReadOffset += theLength;
+		}
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 AddCopySpan
+// ---------------------------------------------------------------------------------
+// plans the copy of the given bytes at the current offset of the destination file,
+// and moves the current offset past them. a span that follows the previous one in
+// both files is merged with it, so that consecutive sounds are copied in one go.
+
+void
+CShuttleWork::AddCopySpan(
+	LStream		*inFromWhere,
+	SInt32		inOffset,
+	SInt32		inSize )
+{
+	if (inSize <= 0)
+		return;
+	
+	SInt32 numSpans = mCopySpans.GetCount();
+	if (numSpans > 0)
+	{
+		SCopySpan& theLastSpan = mCopySpans[numSpans];
+		if ((theLastSpan.mFromWhere == inFromWhere) &&
+			(theLastSpan.mFromOffset + theLastSpan.mSize == inOffset) &&
+			(theLastSpan.mToOffset + theLastSpan.mSize == mCurrentOffset))
+		{
+			theLastSpan.mSize += inSize;
+			mCopyTotal += inSize;
+			mCurrentOffset += inSize;
+			return;
+		}
+	}
+	
+	SCopySpan theSpan;
+	theSpan.mFromWhere = inFromWhere;
+	theSpan.mFromOffset = inOffset;
+	theSpan.mToOffset = mCurrentOffset;
+	theSpan.mSize = inSize;
+	mCopySpans.AddItem( theSpan );
+	
+	mCopyTotal += inSize;
+	mCurrentOffset += inSize;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 CopySpans
+// ---------------------------------------------------------------------------------
+// copies planned spans to the destination file, using the biggest buffer we can
+// afford. to keep the application responsive, we return after copy_TimeSlice ticks
+// and continue where we were on the next call. returns true once everything has
+// been copied.
+
+Boolean
+CShuttleWork::CopySpans()
+{
+	// get a buffer first. leave some memory for the rest of the application.
+	if (mCopyBuffer == nil)
+	{
+		mCopyBufferSize = ::MaxBlock() / 2;
+		if (mCopyBufferSize > copy_MaxBufferSize)
+			mCopyBufferSize = copy_MaxBufferSize;
+		if (mCopyBufferSize < copy_MinBufferSize)
+			mCopyBufferSize = copy_MinBufferSize;
+		
+		mCopyBuffer = ::NewPtr( mCopyBufferSize );
+		ThrowIfNil_( mCopyBuffer );
+	}
+	
+	UInt32 theEndTicks = ::TickCount() + copy_TimeSlice;
+	SInt32 numSpans = mCopySpans.GetCount();
+	while (mCurrentSpan <= numSpans)
+	{
+		const SCopySpan& theSpan = mCopySpans[mCurrentSpan];
+		
+		SInt32 theSize = theSpan.mSize - mCurrentSpanDone;
+		if (theSize > mCopyBufferSize)
+			theSize = mCopyBufferSize;
+		
+		ReadSound( theSpan.mFromWhere, theSpan.mFromOffset + mCurrentSpanDone, theSize, mCopyBuffer );
+		WriteSound( mDestinationFile, theSpan.mToOffset + mCurrentSpanDone, theSize, mCopyBuffer );
+		
+		mCurrentSpanDone += theSize;
+		if (mCurrentSpanDone == theSpan.mSize)
+		{
+			mCurrentSpan++;
+			mCurrentSpanDone = 0;
+		}
+		
+		// increment progress bar.
+		SInt32 theUnit = (mCopyTotal / copy_ProgressSteps) + 1;
+		SInt32 theOldSteps = mCopyDone / theUnit;
+		mCopyDone += theSize;
+		mProgressDialog->Increment( (mCopyDone / theUnit) - theOldSteps );
+		
+		// the journal needs to know what was written.
+		if (mJournalFile != nil)
+			CWailSoundStream::HashBytes( mCopyBuffer, theSize, mWrittenHash );
+		
+		if (::TickCount() >= theEndTicks)
+			break;
+	}
+	
+	// write a checkpoint now and then. once everything's copied, the journal is
+	// deleted, so there's no need for one.
+	if ((mJournalFile != nil) && (mCurrentSpan <= numSpans) &&
+		((mCopyDone - mJournaledBytes) >= journal_Batch))
+	{
+		WriteJournal();
+	}
+	
+	return (mCurrentSpan > numSpans);
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 OpenJournal
+// ---------------------------------------------------------------------------------
+// opens the journal of an install in the source file, creating it if needed. the
+// journal is next to the source file, named like it followed by "journal". returns
+// true if both the journal and the temp file were left there by an interrupted
+// install, in which case mJournal receives the last checkpoint.
+
+Boolean
+CShuttleWork::OpenJournal(
+	OSType	inCreator )
+{
+	FSSpec theJournalSpec;
+	mSourceFile->GetSpecifier( theJournalSpec );
+	AddSuffixToFileName( theJournalSpec.name, "\pjournal" );
+	
+	FSSpec theTempSpec;
+	mDestinationFile->GetSpecifier( theTempSpec );
+	
+	FInfo theInfo;
+	Boolean canResume = ((::FSpGetFInfo( &theJournalSpec, &theInfo ) == noErr) &&
+						 (::FSpGetFInfo( &theTempSpec, &theInfo ) == noErr));
+	
+	mJournalFile = new LFileStream( theJournalSpec );
+	if (!canResume)
+	{
+		// start a new journal.
+		OSErr err = ::FSpDelete( &theJournalSpec );
+		if (err != fnfErr)
+			ThrowIfOSErr_( err );
+		mJournalFile->CreateNewDataFile( inCreator, fileType_ShuttleJournal, smSystemScript );
+	}
+	mJournalFile->OpenDataFork( fsRdWrPerm );
+	
+	// a journal without a whole checkpoint is no better than none.
+	if (canResume && (mJournalFile->GetLength() >= sizeof(SJournal)))
+	{
+		mJournalFile->SetMarker( 0, streamFrom_Start );
+		mJournalFile->ReadBlock( &mJournal, sizeof(SJournal) );
+		return true;
+	}
+	
+	return false;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 StartJournal
+// ---------------------------------------------------------------------------------
+// called once the destination file is laid out. when resuming, we continue from the
+// last checkpoint if it was made for the same install and if what it says was copied
+// is really in the temp file. otherwise, we start from the beginning.
+
+void
+CShuttleWork::StartJournal()
+{
+	SJournal theJournal;
+	theJournal.mIdent = journal_Ident;
+	theJournal.mVersion = journal_Version;
+	CWailSoundFileData::HashFileTables( *mSourceFile, theJournal.mSourceHash );
+	CWailSoundFileData::HashFileTables( *mPatchFile, theJournal.mPatchHash );
+	theJournal.mNumClasses = mNumClasses;
+	theJournal.mReserved = 0;
+	theJournal.mNumSpans = mCopySpans.GetCount();
+	theJournal.mCopyTotal = mCopyTotal;
+	
+	theJournal.mCurrentSpan = 1;
+	theJournal.mCurrentSpanDone = 0;
+	theJournal.mCopyDone = 0;
+	CWailSoundStream::InitHash( theJournal.mWrittenHash );
+	
+	if (mResuming && IsCheckpointValid( theJournal ))
+	{
+		theJournal.mCurrentSpan = mJournal.mCurrentSpan;
+		theJournal.mCurrentSpanDone = mJournal.mCurrentSpanDone;
+		theJournal.mCopyDone = mJournal.mCopyDone;
+		theJournal.mWrittenHash = mJournal.mWrittenHash;
+	}
+	mJournal = theJournal;
+	
+	mCurrentSpan = mJournal.mCurrentSpan;
+	mCurrentSpanDone = mJournal.mCurrentSpanDone;
+	mCopyDone = mJournal.mCopyDone;
+	mWrittenHash = mJournal.mWrittenHash;
+	mJournaledBytes = mCopyDone;
+	
+	// show what's already done.
+	SInt32 theUnit = (mCopyTotal / copy_ProgressSteps) + 1;
+	mProgressDialog->Increment( mCopyDone / theUnit );
+	
+	// from now on, the journal describes this install.
+	WriteJournal();
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 IsCheckpointValid
+// ---------------------------------------------------------------------------------
+// returns true if the checkpoint read in mJournal was made for the install
+// described by inJournal, and if the sound data it says was copied is in the temp
+// file. the data is read back and hashed to make sure.
+
+Boolean
+CShuttleWork::IsCheckpointValid(
+	const SJournal&	inJournal )
+{
+	if ((mJournal.mIdent != inJournal.mIdent) ||
+		(mJournal.mVersion != inJournal.mVersion) ||
+		!CWailSoundClass::AreHashesSame( mJournal.mSourceHash, inJournal.mSourceHash ) ||
+		!CWailSoundClass::AreHashesSame( mJournal.mPatchHash, inJournal.mPatchHash ) ||
+		(mJournal.mNumClasses != inJournal.mNumClasses) ||
+		(mJournal.mNumSpans != inJournal.mNumSpans) ||
+		(mJournal.mCopyTotal != inJournal.mCopyTotal))
+	{
+		return false;
+	}
+	
+	// the checkpoint must make sense.
+	if ((mJournal.mCurrentSpan < 1) || (mJournal.mCurrentSpan > mJournal.mNumSpans) ||
+		(mJournal.mCurrentSpanDone < 0) ||
+		(mJournal.mCurrentSpanDone >= mCopySpans[mJournal.mCurrentSpan].mSize))
+	{
+		return false;
+	}
+	
+	SInt32 theCopyDone = mJournal.mCurrentSpanDone;
+	for (SInt32 i = 1; i < mJournal.mCurrentSpan; i++)
+		theCopyDone += mCopySpans[i].mSize;
+	if (theCopyDone != mJournal.mCopyDone)
+		return false;
+	
+	// sound data is written in one piece, after the headers.
+	if (theCopyDone > 0)
+	{
+		CWailSoundStream theWrittenData( mDestinationFile, mCopySpans[1].mToOffset, theCopyDone );
+		if (!CWailSoundClass::AreHashesSame( theWrittenData.GetContentHash(),
+											 mJournal.mWrittenHash ))
+		{
+			return false;
 		}
 	}
+	
+	return true;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 WriteJournal
+// ---------------------------------------------------------------------------------
+// writes a checkpoint in the journal: how far we got copying sound data, with a hash
+// of what was copied. the temp file is flushed first, so the journal never says more
+// was written than what's really on disk.
+
+void
+CShuttleWork::WriteJournal()
+{
+	CAsyncFileWriter::FlushFile( mDestinationFile->GetDataForkRefNum() );
+	
+	mJournal.mCurrentSpan = mCurrentSpan;
+	mJournal.mCurrentSpanDone = mCurrentSpanDone;
+	mJournal.mCopyDone = mCopyDone;
+	mJournal.mWrittenHash = mWrittenHash;
+	
+	mJournalFile->SetMarker( 0, streamFrom_Start );
+	mJournalFile->WriteBlock( &mJournal, sizeof(SJournal) );
+	CAsyncFileWriter::FlushFile( mJournalFile->GetDataForkRefNum() );
+	
+	mJournaledBytes = mCopyDone;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 IsRightSourceFile
+// ---------------------------------------------------------------------------------
+// returns true if the source file is the one our delta section was made against,
+// or if we're not a delta shuttle. only the file's header and class headers are
+// checked here; each sound is checked when it's used.
+
+Boolean
+CShuttleWork::IsRightSourceFile()
+{
+	if (!mHasDelta)
+		return true;
+	
+	SSoundHash theHash;
+	CWailSoundFileData::HashFileTables( *mSourceFile, theHash );
+	return CWailSoundClass::AreHashesSame( theHash, mDeltaHeader.mSourceHash );
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 FindDeltaEntry
+// ---------------------------------------------------------------------------------
+// returns the delta entry of the given sound, or nil if the sound is stored whole.
+// all indexes start at 0.
+
+const SShuttleDeltaEntry*
+CShuttleWork::FindDeltaEntry(
+	SInt16	inWhichSet,
+	SInt16	inWhichClass,
+	SInt16	inWhichSound ) const
+{
+	SInt32 numEntries = mDeltaEntries.GetCount();
+	for (SInt32 i = 1; i <= numEntries; i++)
+	{
+		const SShuttleDeltaEntry& theEntry = mDeltaEntries[i];
+		if ((theEntry.mSet == inWhichSet) &&
+			(theEntry.mClass == inWhichClass) &&
+			(theEntry.mSound == inWhichSound))
+		{
+			return &theEntry;
+		}
+	}
+	
+	return nil;
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 AddDeltaLengths
+// ---------------------------------------------------------------------------------
+// changes the lengths in the given class header (read from the patch file) to
+// the lengths its sounds will have once completed with the source file.
+
+void
+CShuttleWork::AddDeltaLengths(
+	SInt16				inWhichSet,
+	SInt16				inWhichClass,
+	SMthonSoundClass&	ioClass ) const
+{
+	if (mDeltaEntries.GetCount() == 0)
+		return;
+	
+	SInt32 theLengths[5];
+	CWailSoundClass::GetSoundLengths( ioClass, theLengths );
+	
+	Boolean isChanged = false;
+	for (SInt16 i = 0; i < ioClass.mNumSounds; i++)
+	{
+		const SShuttleDeltaEntry* theEntry = FindDeltaEntry( inWhichSet, inWhichClass, i );
+		if (theEntry != nil)
+		{
+			theLengths[i] += theEntry->mPrefixLength + theEntry->mSuffixLength;
+			isChanged = true;
+		}
+	}
+	
+	if (isChanged)
+	{
+		SInt32 theOffset = 0;
+		for (SInt16 j = 0; j < ioClass.mNumSounds; j++)
+		{
+			ioClass.mSoundOffset[j] = theOffset;
+			theOffset += theLengths[j];
+		}
+		ioClass.mFirstSoundLength = theLengths[0];
+		ioClass.mTotalLength = theOffset;
+	}
+}
+
+
+// ---------------------------------------------------------------------------------
+//		 InstallDeltaSound
+// ---------------------------------------------------------------------------------
+// plans the copy of a sound of a delta shuttle at the current offset of the
+// destination file: the start of the source's sound, the part found in the patch
+// file, then the end of the source's sound. throws if the source's sound isn't the
+// one the delta was made against.
+
+void
+CShuttleWork::InstallDeltaSound(
+	const SShuttleDeltaEntry&	inEntry,
+	SInt32						inPatchOffset,
+	SInt32						inPatchLength )
+{
+	// find the sound in the source file.
+	SMthonSoundClass theSourceHeader;
+	ReadSoundClass( mSourceFile, inEntry.mSet, inEntry.mClass, mNumClassesSource, theSourceHeader );
+	ThrowIf_( inEntry.mSound >= theSourceHeader.mNumSounds );
+	
+	SInt32 theSourceLengths[5];
+	CWailSoundClass::GetSoundLengths( theSourceHeader, theSourceLengths );
+	SInt32 theSourceOffset = theSourceHeader.mFirstSoundOffset +
+							 theSourceHeader.mSoundOffset[inEntry.mSound];
+	SInt32 theSourceLength = theSourceLengths[inEntry.mSound];
+	
+	// make sure it's the same sound.
+	{
+		CWailSoundStream theSourceSound( mSourceFile, theSourceOffset, theSourceLength );
+		if ((theSourceLength != inEntry.mSourceLength) ||
+			!CWailSoundClass::AreHashesSame( theSourceSound.GetContentHash(), inEntry.mSourceHash ))
+		{
+			Throw_( badFileFormat );
+		}
+	}
+	
+	// put the sound together.
+	AddCopySpan( mSourceFile, theSourceOffset, inEntry.mPrefixLength );
+	AddCopySpan( mPatchFile, inPatchOffset, inPatchLength );
+	AddCopySpan( mSourceFile, theSourceOffset + theSourceLength - inEntry.mSuffixLength,
+				 inEntry.mSuffixLength );
 }
 
 
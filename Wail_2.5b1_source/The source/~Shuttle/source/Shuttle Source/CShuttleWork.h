@@ -31,8 +31,10 @@
 #pragma once
 
 #include <LCommander.h>
+#include <TArray.h>
 
 #include "CWailSoundFileData.h"
+#include "WailShuttleConstants.h"
 
 #include "CWailProgressDialog.h"
 #include "CInFileStream.h"
@@ -47,29 +49,91 @@ class CShuttleWork : public LCommander
 		//Default Constructor
 							CShuttleWork(
 									const FSSpec&				inFile,
-									LCommander					*inSuper );
+									LCommander					*inSuper,
+									CShuttleWork				*inSharePatchWith = nil,
+									const FSSpec				*inPatchFile = nil );
 		//Destructor
 		virtual				~CShuttleWork();
 		
 	// Other functions
 	
 		virtual Boolean		DoWork();
+		Boolean				IsDone() const { return mIsDone; }
+		void				Abandon();
+		
+		void				InstallInSourceFile();
 		
 	protected:
 	// Protected functions
 	
 	// Initialization of the patch file
 	
-		void				CreatePatchFile();
+		void				CreatePatchFile(
+									const FSSpec				*inPatchFile );
+		Boolean				ReadTrailer(
+									SShuttleDataInfo&			outInfo );
+		void				ReadDeltaSection(
+									SInt32						inDeltaOffset );
 	
 	// Installation steps
 	
 		void				AskForDestinationFile();
+		static void			AddSuffixToFileName(
+									StrFileName					ioName,
+									ConstStringPtr				inSuffix );
 		SInt32				AskForInstallationMethod();
 		void				InstallHeader();
 		void				InstallClass(
 									SInt16						inWhichSet,
 									SInt16						inWhichClass );
+		void				AddCopySpan(
+									LStream						*inFromWhere,
+									SInt32						inOffset,
+									SInt32						inSize );
+		Boolean				CopySpans();
+	
+	// Journal of an install in the source file, so that it can be resumed if
+	// it's interrupted. the journal contains a single SJournal.
+	
+		struct SJournal
+		{
+			OSType			mIdent;
+			SInt32			mVersion;
+			SSoundHash		mSourceHash;		// what the install applies to.
+			SSoundHash		mPatchHash;
+			SInt16			mNumClasses;
+			SInt16			mReserved;
+			SInt32			mNumSpans;
+			SInt32			mCopyTotal;
+			
+			SInt32			mCurrentSpan;		// last checkpoint.
+			SInt32			mCurrentSpanDone;
+			SInt32			mCopyDone;
+			SSoundHash		mWrittenHash;		// hash of the mCopyDone bytes copied.
+		};
+		
+		Boolean				OpenJournal(
+									OSType						inCreator );
+		void				StartJournal();
+		Boolean				IsCheckpointValid(
+									const SJournal&				inJournal );
+		void				WriteJournal();
+	
+	// Delta shuttles
+	
+		Boolean				IsRightSourceFile();
+		const SShuttleDeltaEntry*	FindDeltaEntry(
+									SInt16						inWhichSet,
+									SInt16						inWhichClass,
+									SInt16						inWhichSound ) const;
+		void				AddDeltaLengths(
+									SInt16						inWhichSet,
+									SInt16						inWhichClass,
+									SMthonSoundClass&			ioClass ) const;
+		void				InstallDeltaSound(
+									const SShuttleDeltaEntry&	inEntry,
+									SInt32						inPatchOffset,
+									SInt32						inPatchLength );
 	
 	// Marathon-related
 		void				ReadSoundFileHeader(
@@ -107,7 +171,14 @@ class CShuttleWork : public LCommander
 		// Member Variables and Classes
 
 		LFileStream			*mSourceFile;
-		CInFileStream		*mPatchFile;
+		Boolean				mSourceChecked;
+		CInFileStream		*mPatchDataFile;	// the patch data as stored in our data fork.
+		LStream				*mPatchFile;		// same, or decompressing it if compressed.
+		Boolean				mOwnsPatchFile;		// false if shared with another work.
+		
+		Boolean				mHasDelta;
+		SShuttleDeltaHeader	mDeltaHeader;
+		TArray<SShuttleDeltaEntry>	mDeltaEntries;
 							
 		LFileStream			*mDestinationFile;
 		Boolean				mOverwriteSource;
@@ -119,10 +190,33 @@ class CShuttleWork : public LCommander
 		SInt16				mNumClassesSource;
 		SInt16				mNumClassesShuttle;
 		
-		SInt16				mCurrentSet;
-		SInt16				mCurrentClass;
-		SInt16				mCurrentSound;
 		SInt32				mCurrentOffset;
+		Boolean				mLayoutDone;
+		
+		// sound data to copy, once the destination file is laid out.
+		struct SCopySpan
+		{
+			LStream			*mFromWhere;
+			SInt32			mFromOffset;
+			SInt32			mToOffset;
+			SInt32			mSize;
+		};
+		
+		TArray<SCopySpan>	mCopySpans;
+		SInt32				mCopyTotal;			// bytes in all spans.
+		SInt32				mCopyDone;			// bytes copied so far.
+		SInt32				mCurrentSpan;		// 1-based.
+		SInt32				mCurrentSpanDone;	// bytes of it copied so far.
+		Ptr					mCopyBuffer;
+		SInt32				mCopyBufferSize;
+		
+		// journal of an install in the source file.
+		
+		LFileStream			*mJournalFile;
+		Boolean				mResuming;
+		SJournal			mJournal;
+		SSoundHash			mWrittenHash;		// hash of sound data copied so far.
+		SInt32				mJournaledBytes;	// mCopyDone at the last checkpoint.
 		
 		Boolean				mIsDone;
 	